@@ -0,0 +1,797 @@
+/* ==========================================================================
+   $File: AMG.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "AMG.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace AMG
+{
+    /// Max number of threads to be used by OpenMP
+    const uint MaxThreads = 30;
+
+    /// Coarsening stops once a level has at most this many unknowns
+    const uint MaxCoarseSize = 400;
+
+    /// The coarsest level is solved with a dense Cholesky
+    /// factorisation if it has at most this many unknowns, otherwise
+    /// (if the coarsening stalled) by CoarseSweeps symmetric
+    /// Gauss-Seidel sweeps
+    const uint MaxDirectSize = 1000;
+    const uint CoarseSweeps = 10;
+
+    /// Hard limit on the depth of the hierarchy
+    const uint MaxLevels = 25;
+
+    /// Coarsening stops if a level would keep more than this
+    /// fraction of the unknowns of the one above
+    const f64 MaxCoarseningRatio = 0.9;
+
+    /// Strength of connection threshold on the finest level, halved
+    /// on each coarser level (Vanek, Mandel & Brezina 1996)
+    const f64 StrengthThreshold = 0.08;
+
+    /// Number of power iterations used to estimate the spectral
+    /// radius of D^-1 A for the prolongation smoother
+    const uint PowerIterations = 20;
+
+    /// Marker for unknowns not (yet) in an aggregate, and columns
+    /// not in the current row
+    const uint Unassigned = ~0u;
+
+    /// Compressed sparse row matrix. The entries of a row need not be
+    /// sorted by column
+    struct SparseMatrix
+    {
+        uint numRows;
+        uint numCols;
+        std::vector<uint> rowStart;
+        std::vector<uint> cols;
+        std::vector<f64> values;
+    };
+
+    /// Operators of one level of the hierarchy. P interpolates from
+    /// the next coarser level to this one, and R = P^T restricts to it
+    struct Level
+    {
+        SparseMatrix A;
+        SparseMatrix P;
+        SparseMatrix R;
+        std::vector<f64> invDiag;
+    };
+
+    /// Vectors used on one level during a cycle
+    struct LevelWork
+    {
+        std::vector<f64> x;
+        std::vector<f64> b;
+        std::vector<f64> r;
+    };
+
+    static
+    SparseMatrix
+    Transpose(const SparseMatrix& m)
+    {
+        SparseMatrix t;
+        t.numRows = m.numCols;
+        t.numCols = m.numRows;
+        t.rowStart.assign(t.numRows + 1, 0);
+        for (const auto c : m.cols)
+        {
+            ++t.rowStart[c + 1];
+        }
+        for (uint i = 0; i < t.numRows; ++i)
+        {
+            t.rowStart[i + 1] += t.rowStart[i];
+        }
+
+        t.cols.resize(m.cols.size());
+        t.values.resize(m.values.size());
+        std::vector<uint> next(t.rowStart.begin(), t.rowStart.end() - 1);
+        for (uint i = 0; i < m.numRows; ++i)
+        {
+            for (uint k = m.rowStart[i]; k < m.rowStart[i + 1]; ++k)
+            {
+                const uint dest = next[m.cols[k]]++;
+                t.cols[dest] = i;
+                t.values[dest] = m.values[k];
+            }
+        }
+        return t;
+    }
+
+    /// Returns a b, row by row with a dense accumulator (Gustavson)
+    static
+    SparseMatrix
+    Multiply(const SparseMatrix& a, const SparseMatrix& b)
+    {
+        SparseMatrix result;
+        result.numRows = a.numRows;
+        result.numCols = b.numCols;
+        result.rowStart.reserve(a.numRows + 1);
+        result.rowStart.push_back(0);
+
+        // NOTE(Chris): Position of each column in result.cols while
+        // its row is being built, Unassigned otherwise
+        std::vector<uint> position(b.numCols, Unassigned);
+        for (uint i = 0; i < a.numRows; ++i)
+        {
+            const uint rowBegin = result.cols.size();
+            for (uint ka = a.rowStart[i]; ka < a.rowStart[i + 1]; ++ka)
+            {
+                const uint j = a.cols[ka];
+                const f64 aij = a.values[ka];
+                for (uint kb = b.rowStart[j]; kb < b.rowStart[j + 1]; ++kb)
+                {
+                    const uint col = b.cols[kb];
+                    if (position[col] == Unassigned)
+                    {
+                        position[col] = result.cols.size();
+                        result.cols.push_back(col);
+                        result.values.push_back(aij * b.values[kb]);
+                    }
+                    else
+                    {
+                        result.values[position[col]] += aij * b.values[kb];
+                    }
+                }
+            }
+
+            for (uint k = rowBegin; k < result.cols.size(); ++k)
+            {
+                position[result.cols[k]] = Unassigned;
+            }
+            result.rowStart.push_back(result.cols.size());
+        }
+        return result;
+    }
+
+    static
+    std::vector<f64>
+    Diagonal(const SparseMatrix& a)
+    {
+        std::vector<f64> diag(a.numRows, 0.0);
+        for (uint i = 0; i < a.numRows; ++i)
+        {
+            for (uint k = a.rowStart[i]; k < a.rowStart[i + 1]; ++k)
+            {
+                if (a.cols[k] == i)
+                    diag[i] += a.values[k];
+            }
+        }
+        return diag;
+    }
+
+    /// out = m in, or out += m in if add
+    static
+    void
+    SpMV(const SparseMatrix& m, const std::vector<f64>& in, std::vector<f64>* result,
+         const bool add)
+    {
+        JasUnpack(m, numRows, rowStart, cols, values);
+        auto& out = *result;
+#pragma omp parallel for default(none) shared(numRows, rowStart, cols, values, in, out, add)
+        for (uint i = 0; i < numRows; ++i)
+        {
+            f64 sum = add ? out[i] : 0.0;
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                sum += values[k] * in[cols[k]];
+            }
+            out[i] = sum;
+        }
+    }
+
+    /// r = b - a x
+    static
+    void
+    Residual(const SparseMatrix& a, const std::vector<f64>& x, const std::vector<f64>& b,
+             std::vector<f64>* result)
+    {
+        JasUnpack(a, numRows, rowStart, cols, values);
+        auto& r = *result;
+#pragma omp parallel for default(none) shared(numRows, rowStart, cols, values, x, b, r)
+        for (uint i = 0; i < numRows; ++i)
+        {
+            f64 sum = b[i];
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                sum -= values[k] * x[cols[k]];
+            }
+            r[i] = sum;
+        }
+    }
+
+    /// One Gauss-Seidel sweep on a x = b, in increasing row order or
+    /// in decreasing order if backward. The backward sweep is the
+    /// adjoint of the forward one, so pre-smoothing forward and
+    /// post-smoothing backward keeps the cycle symmetric
+    static
+    void
+    GaussSeidel(const SparseMatrix& a, const std::vector<f64>& invDiag,
+                const std::vector<f64>& b, std::vector<f64>* result, const bool backward)
+    {
+        JasUnpack(a, numRows, rowStart, cols, values);
+        auto& x = *result;
+        for (uint n = 0; n < numRows; ++n)
+        {
+            const uint i = backward ? numRows - 1 - n : n;
+            f64 residual = b[i];
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                residual -= values[k] * x[cols[k]];
+            }
+            x[i] += residual * invDiag[i];
+        }
+    }
+
+    /// Matrix of the unknowns of the graph, numbered interior first
+    /// then edge (as in the CellGraph). unknownCells is filled with
+    /// the grid index of each unknown
+    static
+    SparseMatrix
+    BuildFineMatrix(const Laplacian::CellGraph& graph, std::vector<uint>* unknownCells)
+    {
+        JasUnpack(graph, lineLength, numLines, interior, edge, edgeNeighbours);
+        const auto& fixed = graph.fixed;
+
+        auto& cells = *unknownCells;
+        cells.clear();
+        cells.reserve(graph.NumUnknowns());
+        cells.insert(cells.end(), interior.begin(), interior.end());
+        cells.insert(cells.end(), edge.begin(), edge.end());
+
+        std::vector<uint> unknownIndex(lineLength * numLines, Unassigned);
+        for (uint i = 0; i < cells.size(); ++i)
+        {
+            unknownIndex[cells[i]] = i;
+        }
+
+        SparseMatrix a;
+        a.numRows = cells.size();
+        a.numCols = cells.size();
+        a.rowStart.reserve(cells.size() + 1);
+        a.cols.reserve(5 * cells.size());
+        a.values.reserve(5 * cells.size());
+        a.rowStart.push_back(0);
+        for (uint i = 0; i < cells.size(); ++i)
+        {
+            const uint c = cells[i];
+            const Laplacian::Neighbours n = (i < interior.size())
+                ? Laplacian::Neighbours{{ c - 1, c + 1, c - lineLength, c + lineLength }}
+                : edgeNeighbours[i - interior.size()];
+
+            // NOTE(Chris): On very narrow zipped grids a neighbour can
+            // appear twice, or be the cell itself, so the entries are
+            // accumulated
+            const uint rowBegin = a.cols.size();
+            a.cols.push_back(i);
+            a.values.push_back(4.0);
+            for (const auto neighbour : n)
+            {
+                if (fixed[neighbour])
+                    continue;
+
+                const uint col = unknownIndex[neighbour];
+                uint k = rowBegin;
+                while (k < a.cols.size() && a.cols[k] != col)
+                    ++k;
+                if (k == a.cols.size())
+                {
+                    a.cols.push_back(col);
+                    a.values.push_back(0.0);
+                }
+                a.values[k] -= 1.0;
+            }
+            a.rowStart.push_back(a.cols.size());
+        }
+        return a;
+    }
+
+    /// Groups the unknowns of a into aggregates using the strong
+    /// connections |a_ij| >= threshold sqrt(a_ii a_jj), in the three
+    /// passes of Vanek, Mandel & Brezina: whole neighbourhoods first,
+    /// then the leftovers join an adjacent aggregate, then whatever
+    /// remains forms new aggregates. Returns the number of aggregates
+    static
+    uint
+    Aggregate(const SparseMatrix& a, const std::vector<f64>& diag, const f64 threshold,
+              std::vector<uint>* aggregateOut)
+    {
+        JasUnpack(a, numRows, rowStart, cols, values);
+        auto& aggregate = *aggregateOut;
+        aggregate.assign(numRows, Unassigned);
+
+        auto strong = [&](const uint i, const uint k)
+        {
+            const uint j = cols[k];
+            return j != i && values[k] != 0.0
+                && std::abs(values[k]) >= threshold * std::sqrt(std::abs(diag[i] * diag[j]));
+        };
+
+        uint numAggregates = 0;
+        for (uint i = 0; i < numRows; ++i)
+        {
+            if (aggregate[i] != Unassigned)
+                continue;
+
+            bool free = true;
+            for (uint k = rowStart[i]; k < rowStart[i + 1] && free; ++k)
+            {
+                if (strong(i, k) && aggregate[cols[k]] != Unassigned)
+                    free = false;
+            }
+            if (!free)
+                continue;
+
+            aggregate[i] = numAggregates;
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                if (strong(i, k))
+                    aggregate[cols[k]] = numAggregates;
+            }
+            ++numAggregates;
+        }
+
+        // NOTE(Chris): Only join the aggregates from the first pass,
+        // so they don't creep across the domain
+        const std::vector<uint> firstPass(aggregate);
+        for (uint i = 0; i < numRows; ++i)
+        {
+            if (aggregate[i] != Unassigned)
+                continue;
+
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                if (strong(i, k) && firstPass[cols[k]] != Unassigned)
+                {
+                    aggregate[i] = firstPass[cols[k]];
+                    break;
+                }
+            }
+        }
+
+        for (uint i = 0; i < numRows; ++i)
+        {
+            if (aggregate[i] != Unassigned)
+                continue;
+
+            aggregate[i] = numAggregates;
+            for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+            {
+                if (strong(i, k) && aggregate[cols[k]] == Unassigned)
+                    aggregate[cols[k]] = numAggregates;
+            }
+            ++numAggregates;
+        }
+
+        return numAggregates;
+    }
+
+    /// Estimates the spectral radius of D^-1 a by power iteration on
+    /// D^-1/2 a D^-1/2, which has the same eigenvalues
+    static
+    f64
+    EstimateRadius(const SparseMatrix& a, const std::vector<f64>& invDiag)
+    {
+        JasUnpack(a, numRows, rowStart, cols, values);
+
+        std::vector<f64> invSqrtDiag(numRows);
+        std::vector<f64> v(numRows);
+        std::vector<f64> w(numRows);
+        // NOTE(Chris): Any start that isn't smooth will do
+        f64 norm = 0.0;
+        for (uint i = 0; i < numRows; ++i)
+        {
+            invSqrtDiag[i] = std::sqrt(invDiag[i]);
+            v[i] = 1.0 + 0.5 * std::sin(7.0 * (f64)i);
+            norm += v[i] * v[i];
+        }
+
+        f64 rho = 0.0;
+        for (uint iter = 0; iter < PowerIterations && norm > 0.0; ++iter)
+        {
+            norm = 1.0 / std::sqrt(norm);
+            for (auto& value : v)
+            {
+                value *= norm;
+            }
+
+            rho = 0.0;
+            norm = 0.0;
+            for (uint i = 0; i < numRows; ++i)
+            {
+                f64 sum = 0.0;
+                for (uint k = rowStart[i]; k < rowStart[i + 1]; ++k)
+                {
+                    sum += values[k] * invSqrtDiag[cols[k]] * v[cols[k]];
+                }
+                w[i] = invSqrtDiag[i] * sum;
+                rho += v[i] * w[i];
+                norm += w[i] * w[i];
+            }
+            std::swap(v, w);
+        }
+        return rho;
+    }
+
+    /// Smoothed prolongation P = (I - w D^-1 a) T from the aggregates,
+    /// where the tentative T interpolates the constant (the near null
+    /// space of the Laplacian) exactly on each aggregate and w = 4 /
+    /// (3 rho(D^-1 a))
+    static
+    SparseMatrix
+    SmoothedProlongation(const SparseMatrix& a, const std::vector<f64>& invDiag,
+                         const std::vector<uint>& aggregate, const uint numAggregates)
+    {
+        std::vector<uint> aggregateSize(numAggregates, 0);
+        for (const auto agg : aggregate)
+        {
+            ++aggregateSize[agg];
+        }
+
+        SparseMatrix tentative;
+        tentative.numRows = a.numRows;
+        tentative.numCols = numAggregates;
+        tentative.rowStart.resize(a.numRows + 1);
+        tentative.cols = aggregate;
+        tentative.values.resize(a.numRows);
+        for (uint i = 0; i < a.numRows; ++i)
+        {
+            tentative.rowStart[i] = i;
+            tentative.values[i] = 1.0 / std::sqrt((f64)aggregateSize[aggregate[i]]);
+        }
+        tentative.rowStart[a.numRows] = a.numRows;
+
+        const f64 rho = EstimateRadius(a, invDiag);
+        const f64 omega = (rho > 0.0) ? 4.0 / (3.0 * rho) : 0.0;
+
+        // NOTE(Chris): Row i of a T always holds the column of the
+        // aggregate of i, as a_ii is non-zero
+        SparseMatrix p = Multiply(a, tentative);
+        for (uint i = 0; i < p.numRows; ++i)
+        {
+            for (uint k = p.rowStart[i]; k < p.rowStart[i + 1]; ++k)
+            {
+                p.values[k] *= -omega * invDiag[i];
+                if (p.cols[k] == aggregate[i])
+                    p.values[k] += tentative.values[i];
+            }
+        }
+        return p;
+    }
+
+    /// In place dense Cholesky factorisation of the row-major n x n
+    /// matrix m, leaving L in the lower triangle. Directions with a
+    /// (numerically) zero pivot are dropped by zeroing their column,
+    /// so a singular system gets a least-squares-like solution
+    static
+    void
+    DenseCholesky(std::vector<f64>* matrix, const uint n)
+    {
+        auto& m = *matrix;
+        for (uint j = 0; j < n; ++j)
+        {
+            const f64 original = m[j * n + j];
+            f64 pivot = original;
+            for (uint k = 0; k < j; ++k)
+            {
+                pivot -= m[j * n + k] * m[j * n + k];
+            }
+
+            const bool dropped = !(pivot > 1e-12 * std::abs(original));
+            const f64 lJJ = dropped ? 0.0 : std::sqrt(pivot);
+            m[j * n + j] = lJJ;
+            for (uint i = j + 1; i < n; ++i)
+            {
+                f64 sum = m[i * n + j];
+                for (uint k = 0; k < j; ++k)
+                {
+                    sum -= m[i * n + k] * m[j * n + k];
+                }
+                m[i * n + j] = dropped ? 0.0 : sum / lJJ;
+            }
+        }
+    }
+
+    /// Solves L L^T x = b for the factorisation from DenseCholesky
+    static
+    void
+    DenseCholeskySolve(const std::vector<f64>& l, const uint n,
+                       const std::vector<f64>& b, std::vector<f64>* result)
+    {
+        auto& x = *result;
+        for (uint i = 0; i < n; ++i)
+        {
+            f64 sum = b[i];
+            for (uint k = 0; k < i; ++k)
+            {
+                sum -= l[i * n + k] * x[k];
+            }
+            x[i] = (l[i * n + i] != 0.0) ? sum / l[i * n + i] : 0.0;
+        }
+        for (uint i = n; i-- > 0; )
+        {
+            f64 sum = x[i];
+            for (uint k = i + 1; k < n; ++k)
+            {
+                sum -= l[k * n + i] * x[k];
+            }
+            x[i] = (l[i * n + i] != 0.0) ? sum / l[i * n + i] : 0.0;
+        }
+    }
+
+    /// Smoothed aggregation hierarchy for the Laplace system on a
+    /// CellGraph. Applying it performs one V(1, 1)-cycle from a zero
+    /// initial guess, with forward Gauss-Seidel pre-smoothing and
+    /// backward post-smoothing
+    class SmoothedAggregation : public Precond::Preconditioner
+    {
+    public:
+        SmoothedAggregation(const Laplacian::CellGraph& graph)
+        {
+            TIME_FUNCTION();
+
+            levels.emplace_back();
+            levels[0].A = BuildFineMatrix(graph, &unknownCells);
+            levels[0].invDiag = Diagonal(levels[0].A);
+            for (auto& d : levels[0].invDiag)
+            {
+                d = 1.0 / d;
+            }
+
+            f64 threshold = StrengthThreshold;
+            std::vector<uint> aggregate;
+            while (levels.back().A.numRows > MaxCoarseSize && levels.size() < MaxLevels)
+            {
+                const auto& fine = levels.back();
+                const auto diag = Diagonal(fine.A);
+                const uint numAggregates = Aggregate(fine.A, diag, threshold, &aggregate);
+                if (numAggregates > MaxCoarseningRatio * fine.A.numRows)
+                {
+                    LOG("AMG coarsening stalled at %u unknowns", fine.A.numRows);
+                    break;
+                }
+
+                Level coarse;
+                SparseMatrix p = SmoothedProlongation(fine.A, fine.invDiag,
+                                                      aggregate, numAggregates);
+                SparseMatrix r = Transpose(p);
+                coarse.A = Multiply(r, Multiply(fine.A, p));
+                coarse.invDiag = Diagonal(coarse.A);
+                for (auto& d : coarse.invDiag)
+                {
+                    d = (d != 0.0) ? 1.0 / d : 0.0;
+                }
+
+                levels.back().P = std::move(p);
+                levels.back().R = std::move(r);
+                levels.push_back(std::move(coarse));
+                threshold *= 0.5;
+            }
+
+            const auto& coarsest = levels.back().A;
+            coarseSize = coarsest.numRows;
+            if (coarseSize <= MaxDirectSize)
+            {
+                coarseFactor.assign(coarseSize * coarseSize, 0.0);
+                for (uint i = 0; i < coarseSize; ++i)
+                {
+                    for (uint k = coarsest.rowStart[i]; k < coarsest.rowStart[i + 1]; ++k)
+                    {
+                        coarseFactor[i * coarseSize + coarsest.cols[k]] += coarsest.values[k];
+                    }
+                }
+                DenseCholesky(&coarseFactor, coarseSize);
+            }
+
+            work.resize(levels.size());
+            u64 totalNonZeros = 0;
+            for (uint l = 0; l < levels.size(); ++l)
+            {
+                const uint n = levels[l].A.numRows;
+                work[l].x.assign(n, 0.0);
+                work[l].b.assign(n, 0.0);
+                work[l].r.assign(n, 0.0);
+                totalNonZeros += levels[l].A.values.size();
+                LOG("AMG level %u: %u unknowns, %u non-zeros", l, n,
+                    (uint)levels[l].A.values.size());
+            }
+            LOG("AMG operator complexity %f",
+                levels[0].A.values.empty() ? 0.0
+                : (f64)totalNonZeros / (f64)levels[0].A.values.size());
+        }
+
+        void
+        Apply(const std::vector<f64>& r, std::vector<f64>* result) const override
+        {
+            auto& z = *result;
+            auto& fine = work[0];
+            for (uint i = 0; i < unknownCells.size(); ++i)
+            {
+                fine.b[i] = r[unknownCells[i]];
+            }
+
+            Cycle(0);
+
+            for (uint i = 0; i < unknownCells.size(); ++i)
+            {
+                z[unknownCells[i]] = fine.x[i];
+            }
+        }
+
+        const char*
+        Name() const override
+        {
+            return "AMG";
+        }
+
+    private:
+        /// Solves approximately for work[l].x from work[l].b
+        void
+        Cycle(const uint l) const
+        {
+            const auto& level = levels[l];
+            auto& w = work[l];
+            std::fill(w.x.begin(), w.x.end(), 0.0);
+
+            if (l + 1 == levels.size())
+            {
+                if (!coarseFactor.empty() || coarseSize == 0)
+                {
+                    DenseCholeskySolve(coarseFactor, coarseSize, w.b, &w.x);
+                    return;
+                }
+
+                for (uint sweep = 0; sweep < CoarseSweeps; ++sweep)
+                {
+                    GaussSeidel(level.A, level.invDiag, w.b, &w.x, false);
+                    GaussSeidel(level.A, level.invDiag, w.b, &w.x, true);
+                }
+                return;
+            }
+
+            GaussSeidel(level.A, level.invDiag, w.b, &w.x, false);
+            Residual(level.A, w.x, w.b, &w.r);
+            SpMV(level.R, w.r, &work[l + 1].b, false);
+
+            Cycle(l + 1);
+
+            SpMV(level.P, work[l + 1].x, &w.x, true);
+            GaussSeidel(level.A, level.invDiag, w.b, &w.x, true);
+        }
+
+        std::vector<uint> unknownCells;
+        std::vector<Level> levels;
+        uint coarseSize;
+        std::vector<f64> coarseFactor;
+        // NOTE(Chris): Scratch space, so applying the preconditioner
+        // doesn't allocate. This means it can't be applied from more
+        // than one thread at once
+        mutable std::vector<LevelWork> work;
+    };
+
+    std::unique_ptr<Precond::Preconditioner>
+    MakeAMGPreconditioner(const Laplacian::CellGraph& graph)
+    {
+        return make_unique<SmoothedAggregation>(graph);
+    }
+
+    bool
+    AMGSolver(Grid* grid, const f64 zeroTol, const u64 maxIter, bool parallel)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        std::vector<uint> cells(graph.interior);
+        cells.insert(cells.end(), graph.edge.begin(), graph.edge.end());
+
+        auto& voltages = grid->voltages;
+        const uint numCells = voltages.size();
+
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        // NOTE(Chris): As in ConjugateGradientSolver, the vectors are
+        // in the grid layout and 0 on the fixed cells, with the fixed
+        // points folded into the rhs, b = -A x_f
+        std::vector<f64> rhs(numCells, 0.0);
+        std::vector<f64> solution(numCells, 0.0);
+        std::vector<f64> residual(numCells, 0.0);
+        std::vector<f64> correction(numCells, 0.0);
+
+        for (const auto& fp : grid->fixedPoints)
+        {
+            solution[fp.first] = fp.second;
+        }
+        Laplacian::ApplyLaplacian(graph, solution, &rhs);
+        for (const auto& fp : grid->fixedPoints)
+        {
+            solution[fp.first] = 0.0;
+        }
+
+#pragma omp parallel for default(none) shared(cells, solution, voltages, rhs)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            solution[*c] = voltages[*c];
+            rhs[*c] = -rhs[*c];
+        }
+
+        const f64 rhsNorm = std::sqrt(Laplacian::Dot(cells, rhs, rhs));
+        if (rhsNorm == 0.0)
+        {
+            LOG("All fixed points are 0, so is the solution");
+            for (const auto c : cells)
+            {
+                voltages[c] = 0.0;
+            }
+            return true;
+        }
+
+        SmoothedAggregation amg(graph);
+        LOG("AMG V-cycles, num threads %u", parallel ? numThreads : 1);
+
+        f64 relResidual = 1.0;
+        u64 i = 0;
+        while (true)
+        {
+            Laplacian::ApplyLaplacian(graph, solution, &residual);
+            f64 rDotR = 0.0;
+#pragma omp parallel for default(none) shared(cells, residual, rhs) reduction(+:rDotR)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                residual[*c] = rhs[*c] - residual[*c];
+                rDotR += residual[*c] * residual[*c];
+            }
+
+            relResidual = std::sqrt(rDotR) / rhsNorm;
+            if (relResidual < zeroTol || i >= maxIter)
+                break;
+
+            ++i;
+            amg.Apply(residual, &correction);
+#pragma omp parallel for default(none) shared(cells, solution, correction)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                solution[*c] += correction[*c];
+            }
+        }
+
+#pragma omp parallel for default(none) shared(cells, solution, voltages)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            voltages[*c] = solution[*c];
+        }
+
+        if (relResidual < zeroTol)
+        {
+            LOG("Performed %u iterations, relative residual: %e", (unsigned)i, relResidual);
+        }
+        else
+        {
+            LOG("Overran max iteration counter (%u), relative residual: %e", (unsigned)maxIter, relResidual);
+        }
+
+        return relResidual < zeroTol;
+    }
+}
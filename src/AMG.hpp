@@ -0,0 +1,39 @@
+// -*- c++ -*-
+#if !defined(AMG_H)
+/* ==========================================================================
+   $File: AMG.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define AMG_H
+// Smoothed aggregation algebraic multigrid. The hierarchy is built
+// from the matrix of the non-fixed cells alone, so unlike the
+// geometric multigrid it doesn't lose electrodes that are only a
+// pixel or two thick on the coarse levels
+
+#include "GlobalDefines.hpp"
+#include "Laplacian.hpp"
+#include "Preconditioner.hpp"
+#include <memory>
+
+class Grid;
+
+namespace AMG
+{
+    /// Returns a preconditioner applying one AMG V-cycle (symmetric,
+    /// so suitable for CG) on the graph. The graph must outlive the
+    /// preconditioner
+    std::unique_ptr<Precond::Preconditioner>
+    MakeAMGPreconditioner(const Laplacian::CellGraph& graph);
+
+    /// Solves the Grid by repeated AMG V-cycles. Stops when the 2-norm
+    /// of the residual relative to that of the right hand side drops
+    /// below zeroTol, or after maxIter cycles. Returns true if it
+    /// converged
+    bool
+    AMGSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+              bool parallel = true);
+}
+#endif
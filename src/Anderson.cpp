@@ -0,0 +1,152 @@
+/* ==========================================================================
+   $File: Anderson.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Anderson.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <Eigen/Dense>
+
+namespace Anderson
+{
+    static
+    f64
+    Dot(const std::vector<f64>& a, const std::vector<f64>& b)
+    {
+        const uint n = a.size();
+        f64 result = 0.0;
+#pragma omp parallel for default(none) shared(a, b, n) reduction(+:result)
+        for (uint i = 0; i < n; ++i)
+        {
+            result += a[i] * b[i];
+        }
+        return result;
+    }
+
+    Accelerator::Accelerator(const std::vector<uint>& cells, const uint depth)
+        : cells(cells),
+          depth(depth > 0 ? depth : 1),
+          numStored(0),
+          head(0),
+          started(false),
+          x(cells.size(), 0.0),
+          f(cells.size(), 0.0),
+          g(cells.size(), 0.0),
+          prevNorm(0.0),
+          dF(this->depth, std::vector<f64>(cells.size(), 0.0)),
+          dG(this->depth, std::vector<f64>(cells.size(), 0.0))
+    {
+    }
+
+    void
+    Accelerator::Restart()
+    {
+        numStored = 0;
+        head = 0;
+    }
+
+    void
+    Accelerator::Extrapolate(std::vector<f64>* values)
+    {
+        f64* v = values->data();
+        const uint* idx = cells.data();
+        const uint n = cells.size();
+
+        if (!started)
+        {
+            for (uint i = 0; i < n; ++i)
+                x[i] = v[idx[i]];
+            started = true;
+            prevNorm = 0.0;
+            return;
+        }
+
+        // NOTE(Chris): The differences from the previous residual and
+        // image are written straight into the next history slot, then
+        // f and g are replaced by the new ones
+        const bool haveResidual = (prevNorm > 0.0);
+        f64* xs = x.data();
+        f64* fs = f.data();
+        f64* gs = g.data();
+        f64* dFNew = dF[head].data();
+        f64* dGNew = dG[head].data();
+        f64 norm = 0.0;
+#pragma omp parallel for default(none) shared(v, idx, n, xs, fs, gs, dFNew, dGNew) reduction(+:norm)
+        for (uint i = 0; i < n; ++i)
+        {
+            const f64 gi = v[idx[i]];
+            const f64 fi = gi - xs[i];
+            dGNew[i] = gi - gs[i];
+            dFNew[i] = fi - fs[i];
+            gs[i] = gi;
+            fs[i] = fi;
+            norm += fi * fi;
+        }
+        norm = std::sqrt(norm);
+
+        if (haveResidual && norm < prevNorm)
+        {
+            head = (head + 1) % depth;
+            numStored = std::min(numStored + 1, depth);
+        }
+        else if (haveResidual)
+        {
+            // NOTE(Chris): The residual grew, so the last extrapolation
+            // overshot. Continue from G(x) with a fresh history
+            LOG("Anderson residual grew (%e -> %e), restarting", prevNorm, norm);
+            Restart();
+        }
+        prevNorm = norm;
+
+        if (numStored == 0 || norm == 0.0)
+        {
+            for (uint i = 0; i < n; ++i)
+                xs[i] = gs[i];
+            return;
+        }
+
+        // NOTE(Chris): Find the combination of the stored residual
+        // differences closest to f, min |f - dF gamma|, through the
+        // normal equations. These are only depth x depth, so a pivoted
+        // QR is cheap and copes with nearly dependent columns
+        const uint m = numStored;
+        Eigen::MatrixXd gram(m, m);
+        Eigen::VectorXd rhs(m);
+        for (uint j = 0; j < m; ++j)
+        {
+            for (uint k = 0; k <= j; ++k)
+            {
+                gram(j, k) = gram(k, j) = Dot(dF[j], dF[k]);
+            }
+            rhs(j) = Dot(dF[j], f);
+        }
+        const Eigen::VectorXd gamma = gram.colPivHouseholderQr().solve(rhs);
+        if (!gamma.allFinite())
+        {
+            Restart();
+            for (uint i = 0; i < n; ++i)
+                xs[i] = gs[i];
+            return;
+        }
+
+        std::vector<const f64*> columns(m);
+        for (uint j = 0; j < m; ++j)
+            columns[j] = dG[j].data();
+        const f64* coeffs = gamma.data();
+
+        // NOTE(Chris): x = G(x) - dG gamma, and the solver continues
+        // from x
+#pragma omp parallel for default(none) shared(v, idx, n, xs, gs, columns, coeffs, m)
+        for (uint i = 0; i < n; ++i)
+        {
+            f64 val = gs[i];
+            for (uint j = 0; j < m; ++j)
+                val -= coeffs[j] * columns[j][i];
+            xs[i] = val;
+            v[idx[i]] = val;
+        }
+    }
+}
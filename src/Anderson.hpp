@@ -0,0 +1,65 @@
+// -*- c++ -*-
+#if !defined(ANDERSON_H)
+/* ==========================================================================
+   $File: Anderson.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define ANDERSON_H
+// Anderson acceleration of the stationary iterations. Once the first
+// transient has passed their error decays geometrically, dominated by
+// a few slow modes, so extrapolating from the last few iterates can
+// skip most of the remaining sweeps
+
+#include "GlobalDefines.hpp"
+#include <vector>
+
+namespace Anderson
+{
+    /// Default number of previous iterates the extrapolation is built
+    /// from. Each costs two copies of the unknowns
+    const uint DefaultDepth = 5;
+
+    /// Accelerates the fixed point iteration x <- G(x), where G is
+    /// whatever the solver does between two calls to Extrapolate (e.g.
+    /// 500 Jacobi sweeps). Only the given cells of the solution are
+    /// extrapolated, the rest (fixed cells, padding) are left alone
+    class Accelerator
+    {
+    public:
+        Accelerator(const std::vector<uint>& cells, const uint depth = DefaultDepth);
+
+        /// Called with the current iterate G(x) at each extrapolation
+        /// point, replaces the non-fixed cells of values with the
+        /// extrapolated iterate that the solver should continue from.
+        /// The first call only records the starting point
+        void
+        Extrapolate(std::vector<f64>* values);
+
+    private:
+        /// Drops the stored differences, used if the extrapolation
+        /// stops helping
+        void
+        Restart();
+
+        std::vector<uint> cells;
+        uint depth;
+        /// Number of stored differences, and the slot the next one is
+        /// written to
+        uint numStored;
+        uint head;
+        bool started;
+        /// Last extrapolated iterate x, its residual f = G(x) - x and
+        /// image G(x), compacted to the cells
+        std::vector<f64> x;
+        std::vector<f64> f;
+        std::vector<f64> g;
+        f64 prevNorm;
+        /// Differences of successive residuals and images
+        std::vector<std::vector<f64>> dF;
+        std::vector<std::vector<f64>> dG;
+    };
+}
+#endif
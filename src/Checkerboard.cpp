@@ -0,0 +1,151 @@
+/* ==========================================================================
+   $File: Checkerboard.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Checkerboard.hpp"
+#include "Grid.hpp"
+#include "Stencil.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Checkerboard
+{
+    void
+    BuildSplitGrid(const Laplacian::CellGraph& graph, SplitGrid* split)
+    {
+        JasUnpack(graph, lineLength, numLines, interior, edge, edgeNeighbours);
+
+        split->lineLength = lineLength;
+        split->numLines = numLines;
+        split->halfLength = (lineLength + 1) / 2;
+        split->values.assign(2 * numLines * split->halfLength, 0.0);
+        split->update.assign(split->values.size(), 0);
+
+        for (auto c : interior)
+            split->update[split->Index(c % lineLength, c / lineLength)] = 1;
+
+        const auto ToSplit = [split, lineLength] (uint c) -> uint
+            {
+                return split->Index(c % lineLength, c / lineLength);
+            };
+
+        for (uint colour = 0; colour < 2; ++colour)
+        {
+            split->edge[colour].clear();
+            split->edgeNeighbours[colour].clear();
+        }
+
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const uint colour = (edge[e] % lineLength + edge[e] / lineLength) % 2;
+            const auto& n = edgeNeighbours[e];
+            split->edge[colour].push_back(ToSplit(edge[e]));
+            split->edgeNeighbours[colour].push_back({{ ToSplit(n[0]), ToSplit(n[1]),
+                                                       ToSplit(n[2]), ToSplit(n[3]) }});
+        }
+    }
+
+    void
+    LoadFromGrid(const Grid& grid, SplitGrid* split)
+    {
+        JasUnpack(grid, voltages, lineLength, numLines);
+
+        for (uint y = 0; y < numLines; ++y)
+            for (uint x = 0; x < lineLength; ++x)
+                split->values[split->Index(x, y)] = voltages[y * lineLength + x];
+    }
+
+    void
+    StoreToGrid(const SplitGrid& split, Grid* grid)
+    {
+        JasUnpack((*grid), voltages, lineLength, numLines);
+
+        for (uint y = 0; y < numLines; ++y)
+            for (uint x = 0; x < lineLength; ++x)
+                voltages[y * lineLength + x] = split.values[split.Index(x, y)];
+    }
+
+    std::vector<uint>
+    Unknowns(const SplitGrid& split)
+    {
+        std::vector<uint> unknowns;
+        for (uint i = 0; i < split.update.size(); ++i)
+        {
+            if (split.update[i])
+                unknowns.push_back(i);
+        }
+        for (uint colour = 0; colour < 2; ++colour)
+            unknowns.insert(unknowns.end(), split.edge[colour].begin(), split.edge[colour].end());
+        return unknowns;
+    }
+
+    /// Over-relaxes the interior cells of one colour, rows in parallel
+    static
+    f64
+    RelaxRows(SplitGrid* split, const Colour colour, const f64 w, const bool computeErr)
+    {
+        JasUnpack((*split), numLines, halfLength);
+        f64* values = split->values.data();
+        const u8* update = split->update.data();
+        const SplitGrid& layout = *split;
+        const Colour other = (colour == Colour::Red) ? Colour::Black : Colour::Red;
+
+        f64 maxErr = 0.0;
+#pragma omp parallel for default(none) shared(values, update, layout, numLines, halfLength, colour, other, w, computeErr) reduction(max:maxErr)
+        for (uint y = 1; y < numLines - 1; ++y)
+        {
+            // NOTE(Chris): Cell x of this row is 2 * i + offset, so its
+            // right neighbour is entry i + offset of the row of the
+            // other colour, and its left neighbour the entry before
+            const uint offset = (y + (uint)colour) % 2;
+            const uint row = layout.RowStart(colour, y);
+            const f64* right = values + layout.RowStart(other, y) + offset;
+            const f64* left = right - 1;
+            const f64* up = values + layout.RowStart(other, y - 1);
+            const f64* down = values + layout.RowStart(other, y + 1);
+
+            const f64 err = Stencil::SplitRow(values + row, right, left, up, down, update + row,
+                                              0, halfLength, w, computeErr);
+            if (err > maxErr)
+                maxErr = err;
+        }
+        return maxErr;
+    }
+
+    f64
+    RelaxColour(SplitGrid* split, const Colour colour, const f64 w, const bool computeErr)
+    {
+        f64 maxErr = RelaxRows(split, colour, w, computeErr);
+
+        auto& values = split->values;
+        const auto& edge = split->edge[(uint)colour];
+        const auto& edgeNeighbours = split->edgeNeighbours[(uint)colour];
+
+        // NOTE(Chris): The zipped edges are handled serially, with an
+        // odd period two cells of the same colour can be neighbours
+        // across the zip
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const auto& n = edgeNeighbours[e];
+            const f64 prev = values[edge[e]];
+            const f64 phiI = 0.25 * (values[n[0]] + values[n[1]] + values[n[2]] + values[n[3]]);
+            const f64 newVal = (1.0 - w) * prev + w * phiI;
+            values[edge[e]] = newVal;
+
+            if (unlikely(computeErr))
+            {
+                const f64 absErr = std::abs((prev - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                {
+                    maxErr = absErr;
+                }
+            }
+        }
+
+        return maxErr;
+    }
+}
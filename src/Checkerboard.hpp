@@ -0,0 +1,96 @@
+// -*- c++ -*-
+#if !defined(CHECKERBOARD_H)
+/* ==========================================================================
+   $File: Checkerboard.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define CHECKERBOARD_H
+// Split storage of the grid for the red-black sweeps. The red and
+// black cells are kept in two compacted arrays, so the update of one
+// colour reads and writes contiguous memory, rather than every other
+// element of Grid::voltages
+
+#include "GlobalDefines.hpp"
+#include "Laplacian.hpp"
+#include <vector>
+
+class Grid;
+
+namespace Checkerboard
+{
+    /// The colours of the checkerboard, a cell (x, y) is red if x + y
+    /// is even
+    enum class Colour
+    {
+        Red = 0,
+        Black = 1
+    };
+
+    /// The grid stored with the colours split. Row y of a colour holds
+    /// the cells of that colour on line y in order, so cell (x, y) is
+    /// entry x / 2 of its row. The left and right neighbours of a cell
+    /// are then adjacent entries in the row of the other colour, and
+    /// the cells above and below are the same entry in the rows of the
+    /// other colour above and below. values holds all of the red rows
+    /// followed by all of the black rows
+    struct SplitGrid
+    {
+        uint lineLength;
+        uint numLines;
+        /// Entries per row of each colour, the last is padding on rows
+        /// with fewer cells of that colour
+        uint halfLength;
+        std::vector<f64> values;
+        /// Non-zero for the non-fixed cells away from the edge, per
+        /// entry of values
+        std::vector<u8> update;
+        /// Indices into values of the non-fixed (zipped) edge cells of
+        /// each colour, and their neighbours
+        std::vector<uint> edge[2];
+        std::vector<Laplacian::Neighbours> edgeNeighbours[2];
+
+        /// Index into values of the start of row y of a colour
+        inline uint
+        RowStart(const Colour colour, const uint y) const
+        {
+            return ((uint)colour * numLines + y) * halfLength;
+        }
+
+        /// Index into values of cell (x, y)
+        inline uint
+        Index(const uint x, const uint y) const
+        {
+            return RowStart((Colour)((x + y) % 2), y) + x / 2;
+        }
+    };
+
+    /// Lays out split from the cell graph, the values are all 0 until
+    /// loaded with LoadFromGrid
+    void
+    BuildSplitGrid(const Laplacian::CellGraph& graph, SplitGrid* split);
+
+    /// Copies the voltages of the grid into the split layout
+    void
+    LoadFromGrid(const Grid& grid, SplitGrid* split);
+
+    /// Copies the values of the split layout back into the grid's
+    /// voltages
+    void
+    StoreToGrid(const SplitGrid& split, Grid* grid);
+
+    /// Indices into values of the non-fixed cells, the padding and
+    /// fixed cells are never written by the sweeps
+    std::vector<uint>
+    Unknowns(const SplitGrid& split);
+
+    /// Over-relaxes the cells of one colour (rows in parallel with the
+    /// vectorised row kernels, then the zipped edge cells serially),
+    /// returns the max relative change if computeErr is set, otherwise
+    /// 0. With w = 1 this is the Gauss-Seidel update
+    f64
+    RelaxColour(SplitGrid* split, const Colour colour, const f64 w, const bool computeErr);
+}
+#endif
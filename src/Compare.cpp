@@ -7,13 +7,16 @@
 #include "Compare.hpp"
 #include "Grid.hpp"
 #include "GradientGrid.hpp"
+#include "Utility.hpp"
 
 #include <cmath>
+#include <algorithm>
 
 namespace Cmp
 {
     Jasnah::Option<Grid>
-    Difference(const Grid& gridA, const Grid& gridB, DifferenceType diffType)
+    Difference(const Grid& gridA, const Grid& gridB, DifferenceType diffType,
+               DifferenceNorms* norms)
     {
         if (gridA.lineLength != gridB.lineLength
             && gridA.numLines != gridB.numLines)
@@ -44,9 +47,47 @@ namespace Cmp
         } break;
         }
 
+        // NOTE(Chris): The fixed cells only show how well the image
+        // matches the geometry, not how accurate the solver is
+        DifferenceNorms n = {};
+        f64 sumSq = 0.0;
+        for (uint i = 0; i < result.voltages.size(); ++i)
+        {
+            if (gridA.fixedPoints.count(i) != 0 || gridB.fixedPoints.count(i) != 0)
+                continue;
+
+            const f64 diff = std::abs(result.voltages[i]);
+            n.maxAbs = std::max(n.maxAbs, diff);
+            sumSq += diff * diff;
+            ++n.numCells;
+        }
+        n.rms = (n.numCells > 0) ? std::sqrt(sumSq / n.numCells) : 0.0;
+
+        LOG("Difference over %u free cells: max %e, RMS %e", n.numCells, n.maxAbs, n.rms);
+        if (norms)
+            *norms = n;
+
         return result;
     }
 
+    void
+    ReportStencilGain(const DifferenceNorms& fivePoint, const DifferenceNorms& ninePoint)
+    {
+        const f64 maxGain = (ninePoint.maxAbs > 0.0) ? fivePoint.maxAbs / ninePoint.maxAbs : 0.0;
+        const f64 rmsGain = (ninePoint.rms > 0.0) ? fivePoint.rms / ninePoint.rms : 0.0;
+
+        LOG("9-point stencil accuracy gain: max difference %e -> %e (%.2fx), RMS %e -> %e (%.2fx)",
+            fivePoint.maxAbs, ninePoint.maxAbs, maxGain, fivePoint.rms, ninePoint.rms, rmsGain);
+        // NOTE(Chris): Halving h quarters the 5-point error, so a gain
+        // of g is worth sqrt(g) times the ScaleFactor (and g times the
+        // cells)
+        if (rmsGain > 0.0)
+        {
+            LOG("The 5-point stencil would need about %.2fx the ScaleFactor for the same RMS difference",
+                std::sqrt(rmsGain));
+        }
+    }
+
     Jasnah::Option<GradientGrid>
     Difference(const GradientGrid& gridA, const GradientGrid& gridB)
     {
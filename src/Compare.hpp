@@ -22,12 +22,32 @@ enum class DifferenceType
 
 namespace Cmp
 {
+    /// Size of the difference between two grids over the cells that
+    /// are fixed in neither of them
+    struct DifferenceNorms
+    {
+        f64 maxAbs;
+        f64 rms;
+        uint numCells;
+    };
+
     /// Returns a grid where each cell is the difference between the
     /// two grid provided. Returns None if the two grids are
-    /// incompatible. Currently the grids need to be the same size
+    /// incompatible. Currently the grids need to be the same size.
+    /// The norms of the difference are logged, and stored in norms if
+    /// it is non-null
     Jasnah::Option<Grid>
     Difference(const Grid& gridA, const Grid& gridB,
-               DifferenceType diffType = DifferenceType::Absolute);
+               DifferenceType diffType = DifferenceType::Absolute,
+               DifferenceNorms* norms = nullptr);
+
+    /// Logs how much smaller the difference from the analytical
+    /// solution is with the 9-point stencil than with the 5-point one
+    /// at the same resolution, and the increase in ScaleFactor the
+    /// 5-point stencil would need for the same RMS difference, given
+    /// that its error falls as h^2
+    void
+    ReportStencilGain(const DifferenceNorms& fivePoint, const DifferenceNorms& ninePoint);
 
     /// Does the same as above but for gradient grids, same
     /// limitations -- DifferenceType doesn't make sense here though
@@ -0,0 +1,169 @@
+/* ==========================================================================
+   $File: ConjugateGradient.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "ConjugateGradient.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "Preconditioner.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+
+namespace ConjugateGradient
+{
+    /// Max number of threads to be used by OpenMP
+    const uint MaxThreads = 30;
+
+    bool
+    ConjugateGradientSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                            const Cfg::Preconditioner preconditioner, bool parallel)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        std::vector<uint> cells(graph.interior);
+        cells.insert(cells.end(), graph.edge.begin(), graph.edge.end());
+
+        auto& voltages = grid->voltages;
+        const uint numCells = voltages.size();
+
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        // NOTE(Chris): The 9-point matrix is also symmetric positive
+        // definite, and the 5-point preconditioners remain valid
+        // (if less effective) for it
+        const Cfg::StencilType stencil = Laplacian::ActiveStencil();
+
+        // NOTE(Chris): All vectors are stored in the grid layout and
+        // are 0 on the fixed cells, so ApplyLaplacian applies the
+        // matrix of the unknowns alone. The fixed points enter through
+        // the rhs, b = -A x_f, where x_f only holds the fixed values
+        std::vector<f64> residual(numCells, 0.0);
+        std::vector<f64> solution(numCells, 0.0);
+        std::vector<f64> search(numCells, 0.0);
+        std::vector<f64> product(numCells, 0.0);
+
+        for (const auto& fp : grid->fixedPoints)
+        {
+            solution[fp.first] = fp.second;
+        }
+        Laplacian::ApplyLaplacian(graph, solution, &product, stencil);
+        for (const auto& fp : grid->fixedPoints)
+        {
+            solution[fp.first] = 0.0;
+        }
+
+        // Start from whatever is currently in the grid, so a warm
+        // start is used if one has been provided. r = b - A x
+#pragma omp parallel for default(none) shared(cells, solution, voltages, residual, product)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            solution[*c] = voltages[*c];
+            residual[*c] = -product[*c];
+        }
+
+        const f64 rhsNorm = std::sqrt(Laplacian::Dot(cells, residual, residual));
+        if (rhsNorm == 0.0)
+        {
+            LOG("All fixed points are 0, so is the solution");
+            for (const auto c : cells)
+            {
+                voltages[c] = 0.0;
+            }
+            return true;
+        }
+
+        Laplacian::ApplyLaplacian(graph, solution, &product, stencil);
+#pragma omp parallel for default(none) shared(cells, residual, product)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            residual[*c] -= product[*c];
+        }
+
+        // NOTE(Chris): Without a preconditioner z is just r
+        const auto precond = Precond::MakePreconditioner(preconditioner, graph);
+        std::vector<f64> precondResidual(precond ? numCells : 0, 0.0);
+        const auto& z = precond ? precondResidual : residual;
+        LOG("Conjugate gradient with %s preconditioner, %s stencil, num threads %u",
+            precond ? precond->Name() : "no", Laplacian::StencilName(stencil), parallel ? numThreads : 1);
+
+        if (precond)
+        {
+            precond->Apply(residual, &precondResidual);
+        }
+        search = z;
+
+        f64 rDotZ = Laplacian::Dot(cells, residual, z);
+        f64 relResidual = std::sqrt(Laplacian::Dot(cells, residual, residual)) / rhsNorm;
+        u64 i = 0;
+        while (relResidual >= zeroTol && i < maxIter)
+        {
+            ++i;
+            Laplacian::ApplyLaplacian(graph, search, &product, stencil);
+            const f64 alpha = rDotZ / Laplacian::Dot(cells, search, product);
+
+            f64 rDotR = 0.0;
+#pragma omp parallel for default(none) shared(cells, solution, residual, search, product, alpha) reduction(+:rDotR)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                solution[*c] += alpha * search[*c];
+                residual[*c] -= alpha * product[*c];
+                rDotR += residual[*c] * residual[*c];
+            }
+
+            relResidual = std::sqrt(rDotR) / rhsNorm;
+            if (relResidual < zeroTol)
+                break;
+
+            f64 newRDotZ = rDotR;
+            if (precond)
+            {
+                precond->Apply(residual, &precondResidual);
+                newRDotZ = Laplacian::Dot(cells, residual, z);
+            }
+            const f64 beta = newRDotZ / rDotZ;
+            rDotZ = newRDotZ;
+
+#pragma omp parallel for default(none) shared(cells, z, search, beta)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                search[*c] = z[*c] + beta * search[*c];
+            }
+        }
+
+#pragma omp parallel for default(none) shared(cells, solution, voltages)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            voltages[*c] = solution[*c];
+        }
+
+        if (relResidual < zeroTol)
+        {
+            LOG("Performed %u iterations, relative residual: %e", (unsigned)i, relResidual);
+        }
+        else
+        {
+            LOG("Overran max iteration counter (%u), relative residual: %e", (unsigned)maxIter, relResidual);
+        }
+
+        return relResidual < zeroTol;
+    }
+}
@@ -0,0 +1,30 @@
+// -*- c++ -*-
+#if !defined(CONJUGATEGRADIENT_H)
+/* ==========================================================================
+   $File: ConjugateGradient.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define CONJUGATEGRADIENT_H
+
+#include "GlobalDefines.hpp"
+#include "JSON.hpp"
+
+namespace ConjugateGradient
+{
+    /// Matrix-free conjugate gradient solve of the 5-point (or if
+    /// selected 9-point) Laplace system over the non-fixed cells (the
+    /// same cells FDM works on),
+    /// with the fixed points folded into the right hand side. Stops
+    /// when the 2-norm of the residual relative to that of the right
+    /// hand side drops below zeroTol, or after maxIter iterations.
+    /// The preconditioner is chosen from those in Preconditioner.hpp.
+    /// Returns true if the residual dropped below zeroTol
+    bool
+    ConjugateGradientSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                            const Cfg::Preconditioner preconditioner = Cfg::Preconditioner::None,
+                            bool parallel = true);
+}
+#endif
@@ -0,0 +1,192 @@
+/* ==========================================================================
+   $File: Convergence.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Convergence.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+
+namespace Convergence
+{
+    static Cfg::ConvergenceCriterion Selected = Cfg::ConvergenceCriterion::RelativeChange;
+    static bool ScaleByBoundary = false;
+
+    void
+    SelectCriterion(const Cfg::ConvergenceCriterion criterion, const bool scaleByBoundary)
+    {
+        Selected = criterion;
+        ScaleByBoundary = scaleByBoundary;
+    }
+
+    Cfg::ConvergenceCriterion
+    ActiveCriterion()
+    {
+        return Selected;
+    }
+
+    bool
+    ScalesByBoundary()
+    {
+        return ScaleByBoundary;
+    }
+
+    const char*
+    CriterionName(const Cfg::ConvergenceCriterion criterion)
+    {
+        switch (criterion)
+        {
+        case Cfg::ConvergenceCriterion::RelativeChange:
+            return "relative change";
+        case Cfg::ConvergenceCriterion::ResidualL2:
+            return "residual L2";
+        case Cfg::ConvergenceCriterion::ResidualLinf:
+            return "residual Linf";
+        }
+        return "unknown";
+    }
+
+    /// Sum of squares and max magnitude of the residual over the
+    /// non-fixed cells, in a single pass. If boundaryOnly is set only
+    /// the fixed neighbours of each cell contribute, which gives the
+    /// norm of the boundary data as seen by the equations
+    static
+    void
+    ResidualNorms(const Laplacian::CellGraph& graph, const std::vector<f64>& voltages,
+                  const Cfg::StencilType stencil, const bool boundaryOnly,
+                  f64* sumSqOut, f64* maxAbsOut)
+    {
+        JasUnpack(graph, lineLength, interior, edge, edgeNeighbours, fixed);
+        const auto& edgeDiagonals = graph.edgeDiagonals;
+        const f64* v = voltages.data();
+        const u8* isFixed = fixed.data();
+        const bool ninePoint = (stencil == Cfg::StencilType::NinePoint);
+
+        // NOTE(Chris): The contribution of a neighbour, all of them
+        // when measuring the residual, only the fixed ones otherwise
+        const auto value = [v, isFixed, boundaryOnly] (const uint c) -> f64
+        {
+            return (!boundaryOnly || isFixed[c]) ? v[c] : 0.0;
+        };
+
+        f64 sumSq = 0.0;
+        f64 maxAbs = 0.0;
+#pragma omp parallel for default(none) shared(interior, v, isFixed, lineLength, boundaryOnly, ninePoint, value) reduction(+:sumSq) reduction(max:maxAbs)
+        for (uint i = 0; i < interior.size(); ++i)
+        {
+            const uint c = interior[i];
+            f64 res;
+            if (ninePoint)
+            {
+                res = 0.05 * (4.0 * (value(c - 1) + value(c + 1) + value(c - lineLength) + value(c + lineLength))
+                              + value(c - lineLength - 1) + value(c - lineLength + 1)
+                              + value(c + lineLength - 1) + value(c + lineLength + 1));
+                if (!boundaryOnly)
+                    res -= v[c];
+            }
+            else if (likely(!boundaryOnly))
+            {
+                res = 0.25 * (v[c - 1] + v[c + 1] + v[c - lineLength] + v[c + lineLength]) - v[c];
+            }
+            else
+            {
+                res = 0.25 * ((isFixed[c - 1] ? v[c - 1] : 0.0)
+                              + (isFixed[c + 1] ? v[c + 1] : 0.0)
+                              + (isFixed[c - lineLength] ? v[c - lineLength] : 0.0)
+                              + (isFixed[c + lineLength] ? v[c + lineLength] : 0.0));
+            }
+
+            sumSq += res * res;
+            if (std::abs(res) > maxAbs)
+                maxAbs = std::abs(res);
+        }
+
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const auto& n = edgeNeighbours[e];
+            f64 res = 0.0;
+            for (uint k = 0; k < n.size(); ++k)
+            {
+                if (!boundaryOnly || isFixed[n[k]])
+                    res += v[n[k]];
+            }
+
+            if (ninePoint)
+            {
+                const auto& d = edgeDiagonals[e];
+                res *= 4.0;
+                for (uint k = 0; k < d.size(); ++k)
+                    res += value(d[k]);
+                res *= 0.05;
+            }
+            else
+            {
+                res *= 0.25;
+            }
+
+            if (!boundaryOnly)
+                res -= v[edge[e]];
+
+            sumSq += res * res;
+            if (std::abs(res) > maxAbs)
+                maxAbs = std::abs(res);
+        }
+
+        *sumSqOut = sumSq;
+        *maxAbsOut = maxAbs;
+    }
+
+    Monitor::Monitor(const Grid& grid)
+        : criterion(Selected),
+          stencil(Laplacian::ActiveStencil()),
+          scale(1.0)
+    {
+        if (criterion == Cfg::ConvergenceCriterion::RelativeChange)
+            return;
+
+        if (!Laplacian::BuildCellGraph(grid, &graph))
+        {
+            LOG("Unable to build cell graph for the residual, using relative change");
+            criterion = Cfg::ConvergenceCriterion::RelativeChange;
+            return;
+        }
+
+        LOG("Converging on the %s", CriterionName(criterion));
+        if (ScaleByBoundary)
+        {
+            f64 sumSq, maxAbs;
+            ResidualNorms(graph, grid.voltages, stencil, true, &sumSq, &maxAbs);
+            const f64 norm = (criterion == Cfg::ConvergenceCriterion::ResidualL2)
+                ? std::sqrt(sumSq) : maxAbs;
+            // NOTE(Chris): With all of the boundary at 0 the solution
+            // is 0, so fall back to the unscaled residual
+            if (norm > 0.0)
+            {
+                scale = norm;
+                LOG("Residual scaled by the boundary data norm %e", norm);
+            }
+        }
+    }
+
+    bool
+    Monitor::UsesResidual() const
+    {
+        return criterion != Cfg::ConvergenceCriterion::RelativeChange;
+    }
+
+    f64
+    Monitor::Measure(const std::vector<f64>& voltages, const f64 relChange) const
+    {
+        if (criterion == Cfg::ConvergenceCriterion::RelativeChange)
+            return relChange;
+
+        f64 sumSq, maxAbs;
+        ResidualNorms(graph, voltages, stencil, false, &sumSq, &maxAbs);
+        const f64 norm = (criterion == Cfg::ConvergenceCriterion::ResidualL2)
+            ? std::sqrt(sumSq) : maxAbs;
+        return norm / scale;
+    }
+}
@@ -0,0 +1,77 @@
+// -*- c++ -*-
+#if !defined(CONVERGENCE_H)
+/* ==========================================================================
+   $File: Convergence.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define CONVERGENCE_H
+// Stopping criteria for the relaxation solvers. By default they stop
+// when no cell changes by more than zeroTol (relative) in a sweep,
+// which is cheap, but slow convergence (e.g. SOR with w near 2) can
+// make the change small long before the solution is accurate. The
+// residual criteria instead measure how well the current voltages
+// satisfy the discrete equations
+
+#include "GlobalDefines.hpp"
+#include "JSON.hpp"
+#include "Laplacian.hpp"
+#include <vector>
+
+class Grid;
+
+namespace Convergence
+{
+    /// Selects the criterion used by every subsequent solve, and
+    /// whether the residual is scaled by the norm of the boundary
+    /// data. The default is Cfg::ConvergenceCriterion::RelativeChange
+    void
+    SelectCriterion(const Cfg::ConvergenceCriterion criterion, const bool scaleByBoundary);
+
+    /// The criterion in use
+    Cfg::ConvergenceCriterion
+    ActiveCriterion();
+
+    /// Whether the residual criteria are scaled by the boundary data
+    bool
+    ScalesByBoundary();
+
+    /// Human readable name of a criterion, for logging
+    const char*
+    CriterionName(const Cfg::ConvergenceCriterion criterion);
+
+    /// Applies the active criterion to a solver's convergence checks.
+    /// Constructed once per solve, so the cell graph and boundary norm
+    /// are only computed when a residual criterion is selected
+    class Monitor
+    {
+    public:
+        explicit Monitor(const Grid& grid);
+
+        /// True if Measure reads the voltages, i.e. the solver has to
+        /// bring Grid::voltages up to date before calling it
+        bool
+        UsesResidual() const;
+
+        /// The quantity to compare with zeroTol: relChange (the max
+        /// relative change of the last sweep) under RelativeChange,
+        /// otherwise the norm of the residual of the Jacobi form of
+        /// the equations, r = 1/4 (sum of neighbours) - v, over the
+        /// non-fixed cells (for the 9-point stencil the Jacobi value is
+        /// its weighted average of the 8 neighbours instead)
+        f64
+        Measure(const std::vector<f64>& voltages, const f64 relChange) const;
+
+    private:
+        Cfg::ConvergenceCriterion criterion;
+        /// The stencil active when the monitor was constructed
+        Cfg::StencilType stencil;
+        Laplacian::CellGraph graph;
+        /// Norm of the residual's contribution from the fixed cells
+        /// (the same norm as the criterion), or 1 if not scaling
+        f64 scale;
+    };
+}
+#endif
@@ -43,7 +43,11 @@ namespace Lethani {
                          streamLock_(nullptr),
 						 logfileGood_(true)
 	{
-		logfile_ = fopen(Version::DefaultLog, "w");
+		// NOTE(Chris): Processes we start ourselves (e.g. the
+		// multi-process workers) are pointed elsewhere, so they don't
+		// truncate our log
+		const char* path = getenv(Version::LogPathEnv);
+		logfile_ = fopen(path ? path : Version::DefaultLog, "w");
 		if (logfile_ == nullptr)
 		{
 			printf("Logfile creation failed\n");
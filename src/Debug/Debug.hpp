@@ -58,7 +58,8 @@ namespace Lethani
     {
 
     public:
-        /// Arg-less constructor, logs to default file
+        /// Arg-less constructor, logs to default file (or the one named
+        /// by the Version::LogPathEnv environment variable)
         Logfile();
         /// Construct with specified filename
         Logfile(const char* filename);
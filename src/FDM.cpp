@@ -5,11 +5,14 @@
    $License: MIT: http://opensource.org/licenses/MIT $
    ========================================================================== */
 #include "FDM.hpp"
+#include "Anderson.hpp"
 #include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "Stencil.hpp"
+#include "SweepEngine.hpp"
 #include "Utility.hpp"
 
 #include <cmath>
-#include <atomic>
 #include <algorithm>
 
 // #include <xmmintrin.h>
@@ -27,974 +30,484 @@ namespace FDM
     /// Obviously this only applies to the parallel functions
     const uint MaxThreads = 30;
 
-    /// Holds the 3 vectors of points to be zipped to pass to the
-    /// functions that handle zipping
-    struct PreprocessedGridZips
-    {
-        typedef std::vector<std::pair<uint, uint> >  VecZip;
-        PreprocessedGridZips(VecZip&& h, VecZip&& v, VecZip&& hv)
-            : hZip(std::move(h)),
-              vZip(std::move(v)),
-              hvZip(std::move(hv))
-        {}
-        PreprocessedGridZips() = delete;
-        const VecZip hZip;
-        const VecZip vZip;
-        const VecZip hvZip;
-    };
+    using Sweep::StopParams;
 
-    /// Data type to hold the two stop conditions (we stop on
-    /// whichever comes first)
-    struct StopParams
-    {
-        const f64 zeroTol;
-        const u64 maxIter;
-        StopParams(f64 _zeroTol, u64 _maxIter) : zeroTol(_zeroTol), maxIter(_maxIter) {}
-    };
+    /// The Jacobi sweep over the lists of non-fixed cells, for the
+    /// dispatch table
+    template <typename Threads, typename Points, typename Zip, typename Err>
+    using JacobiSweep = Sweep::Simultaneous<Threads, Sweep::Jacobi, Points, Zip, Err>;
 
-    /// Multi-threaded implementation of the finite difference method
-    /// not taking into account the outer-most row/column (thus these
-    /// points will need to be fixed and zipping is not enabled). It
-    /// is recommended to use the disptach function to call this
-    /// function after verifying its appropriateness
+    /// Jacobi iteration over the list of non-fixed cells, gathering
+    /// the neighbours of each, then the zipped edge cells. The sweep
+    /// for the combination of stencil, threading and zips is picked
+    /// from the dispatch table once, and the error check interval is predicted
+    /// from the decay of the error (unless accelerating, as the
+    /// extrapolation needs the same number of sweeps between checks)
     static
-    void
-    FDMParaNoZip(Grid* grid, const std::vector<uint>& coordRange, const StopParams& stop)
+    bool
+    FDMCells(Grid* grid, const Laplacian::CellGraph& graph, const StopParams& stop, bool parallel,
+             bool anderson)
     {
-        // NOTE(Chris): Multi-threaded variant
-
-        // NOTE(Chris): We never write to the fixed points, so we don't
-        // need to re-set them (as long as they were set properly in the
-        // incoming grid using AddFixedPoint)
-
-        JasUnpack((*grid), voltages, numLines, lineLength);
-
-        // Create the previous voltage array from the current array
-        decltype(grid->voltages) prevVoltages(voltages);
-
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
-
-        // Hand-waving 10k iterations per thread as minimum to not be dominated by context switches etc.
-        const uint numWorkChunks = (prevVoltages.size() / 10000 > 0) ? prevVoltages.size() / 10000 : 1;
-        const uint numThreads = (prevVoltages.size() / omp_get_max_threads() >= 10000)
-            ? (omp_get_max_threads() > MaxThreads ? MaxThreads : omp_get_max_threads())
+        JasUnpack((*grid), voltages);
+
+        const uint numCells = voltages.size();
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
             : numWorkChunks;
-        omp_set_num_threads(numThreads);
-        // remaining points that don't divide between the threads
-        const uint rem = prevVoltages.size() % numThreads;
-        // size of work chunk for each thread
-        const uint blockSize = (prevVoltages.size() - rem) / numThreads;
-        LOG("Num threads %u, remainders %u", numThreads, rem);
-
-        // Atomic value for concurrent multi-threaded access
-        std::atomic<f64> maxErr(0.0);
-
-        // Main loop - start with 1 so as not to take slow path on first iter
-        for (u64 i = 1; i <= stop.maxIter; ++i)
-        {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            std::swap(prevVoltages, voltages);
-            // const ref to avoid damage again
-            const decltype(grid->voltages)& pVoltage = prevVoltages;
-
-            // Loop over threads (split per thread and complete work chunk)
-#pragma omp parallel for default(none) shared(errorChunk, coordRange, lineLength, voltages, maxErr, i, pVoltage)
-            for (uint thread = 0; thread < numThreads; ++thread)
-            {
-                // chunk start and end
-                const auto start = coordRange.begin() + thread * blockSize;
-                const auto end = (start + blockSize > coordRange.end()) ? coordRange.end() : start + blockSize;
-                // Unlikely means the branch predictor will always go the
-                // other way, it will have to backtrack on the very rare
-                // cases that this comes up (1 in errorChunk times). This
-                // is a penalty of < 200 cycles on those rare occasions
-                if (unlikely(i % errorChunk ==0))
-                {
-                    // Atomic comparisons are slow compared to normal
-                    // scalars, so declare a thread-local maxErr and then
-                    // just update the main one at the end
-                    f64 threadMaxErr = 0.0;
-                    maxErr = 0.0;
-
-                    // Loop over the non-fixed points in the threaded region
-                    for (auto coord = start; coord < end; ++coord)
-                    {
-                        // Apply finite difference method and calculate error
-                        const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                        voltages[*coord] = newVal;
-                        const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
-
-                        if (absErr > threadMaxErr)
-                        {
-                            threadMaxErr = absErr;
-                        }
-                    }
-
-                    // Update global error
-                    if (threadMaxErr > maxErr)
-                    {
-                        maxErr = threadMaxErr;
-                    }
-                }
-                else // normal path
-                {
-                    // Loop over the non-fixed points and apply the FDM only
-                    for (auto coord = start; coord < end; ++coord)
-                    {
-                        const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                        voltages[*coord] = newVal;
-                    }
-                }
-            }
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        const bool zip = !graph.edge.empty();
+        const Cfg::StencilType stencil = Laplacian::ActiveStencil();
+        const auto sweep = Sweep::Dispatch<JacobiSweep>::Select(parallel, zip, false, stencil);
+        const auto sweepErr = Sweep::Dispatch<JacobiSweep>::Select(parallel, zip, true, stencil);
+        LOG("Jacobi over the cell lists, %s stencil, %s, num threads %u", Laplacian::StencilName(stencil),
+            zip ? "zipped" : "no zips", parallel ? numThreads : 1);
+
+        const Sweep::Cells cells(graph);
+
+        // NOTE(Chris): We will just double buffer these 2 vectors to
+        // avoid reallocations new<->old, the newest is always in the grid
+        std::vector<f64> prevVoltages(voltages);
+
+        const auto accel = Sweep::MakeAccelerator(anderson, Sweep::Unknowns(graph), &voltages);
+        return Sweep::Run([&prevVoltages, &voltages, &cells, sweep, sweepErr] (bool computeErr)
+                          {
+                              std::swap(prevVoltages, voltages);
+                              return (computeErr ? sweepErr : sweep)(prevVoltages.data(), voltages.data(),
+                                                                     cells, 1.0);
+                          },
+                          [&voltages] () -> const std::vector<f64>&
+                          {
+                              return voltages;
+                          }, stop, accel ? Sweep::Checks::Fixed : Sweep::Checks::Predicted,
+                          Sweep::Accelerate(accel.get(), &voltages));
+    }
 
-            // Handle the remaining non-fixed cells of the array that
-            // were not handled by the threaded section - almost the
-            // same as immediately above
-            const auto remBegin = coordRange.begin() + (numThreads) * blockSize;
-            const auto remEnd = coordRange.end();
-            if (unlikely(i % errorChunk == 0)) // several differences in this branch
-            {
-                f64 localMaxErr = 0.0;
-                const auto remBegin = coordRange.begin() + (numThreads) * blockSize;
-                const auto remEnd = coordRange.end();
-                for (auto coord = remBegin; coord < remEnd; ++coord)
-                {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                    const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
 
-                    if (absErr > localMaxErr)
-                        localMaxErr = absErr;
-                }
+    /// Side of the square core of a tile for the temporally blocked
+    /// method, the two tile buffers (with the halo) fit in a typical
+    /// 256kB L2
+    const uint TemporalTileSize = 96;
 
-                if (localMaxErr > maxErr)
-                {
-                    maxErr = localMaxErr;
-                }
+    /// Number of Jacobi iterations a tile is advanced by between
+    /// visits, also the width of its halo. The redundant work on the
+    /// halo grows with this, so keep it small compared to the tile
+    const uint TemporalSteps = 10;
 
-                // If we have converged, then break by leaving the function
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %e", (unsigned)i, maxErr.load());
-                    return;
-                }
+    /// The position of a tile for the temporally blocked method, and
+    /// the cells it gathers. The fixed cells are never written, so we
+    /// store the runs of non-fixed cells along each row
+    struct TileLayout
+    {
+        uint x0;
+        uint y0;
+        uint coreWidth;
+        uint coreHeight;
+        /// Grid column of each local column, -1 if outside the grid
+        std::vector<int> columns;
+        /// Grid line of each local row, -1 if outside the grid
+        std::vector<int> lines;
+        /// [start, end) of the runs of non-fixed cells in each row
+        std::vector<std::pair<uint, uint> > runs;
+        /// Index of the first run of each row, (height + 1 entries)
+        std::vector<uint> rowRuns;
+
+        uint Width() const { return coreWidth + 2 * TemporalSteps; }
+        uint Height() const { return coreHeight + 2 * TemporalSteps; }
+    };
 
-                // Else set new target if possible. If we plot the error
-                // per iteration we not that it remains fixed at 1.0 until
-                // all cells have been filled, after this point it drops
-                // roughly as k*i^{-2} where k is a constant and i is the
-                // number of iterations. => err_i * i^2 = err_j * j^2. So
-                // when err_j is zeroTol, and err_i has been calculated we
-                // can find an approximate value for j
-                if (maxErr < 1.0)
-                {
-                    // If this is calculated near the beginning it
-                    // tends to overshoot, go to a quarter to refine
-                    // the counter (we use a modulo anyway so it will
-                    // still stop at the prediction). We're now using
-                    // 5%, there was some major overshoot...
-
-                    // NOTE(Chris): Long double should be at least
-                    // 80-bits and should help avoid underflow in
-                    // these calculations (could hopefully be
-                    // 128-bits)
-                    long double err = maxErr;
-                    long double sqI = i * i;
-                    long double tol = stop.zeroTol;
-                    errorChunk = 0.05 * std::sqrt(maxErr * sqI / tol);
-
-                    // errorChunk = 0.05 * sqrt(maxErr * (f64)Square(i) / stop.zeroTol);
-                    LOG("New target index divisor %u", errorChunk);
-                    // LOG("Relative change after %u iterations %f", (unsigned)i, maxErr.load());
-                }
-            }
-            else
+    /// Splits the grid into tiles and computes their layouts. Indices
+    /// outside the grid wrap around the zips, and otherwise are treated
+    /// as fixed at 0, as the outer edges without a zip are entirely
+    /// fixed so these can only affect other fixed cells
+    static
+    std::vector<TileLayout>
+    BuildTileLayouts(const Grid& grid, const std::vector<u8>& fixed)
+    {
+        JasUnpack(grid, lineLength, numLines, horizZip, verticZip);
+        const int halo = TemporalSteps;
+        auto wrap = [](int i, int n, bool zip) -> int
+        {
+            if (i >= 0 && i < n)
+                return i;
+            if (!zip)
+                return -1;
+            i %= n;
+            return (i < 0) ? i + n : i;
+        };
+
+        const uint tilesX = (lineLength + TemporalTileSize - 1) / TemporalTileSize;
+        const uint tilesY = (numLines + TemporalTileSize - 1) / TemporalTileSize;
+        std::vector<TileLayout> tiles(tilesX * tilesY);
+        for (uint t = 0; t < tiles.size(); ++t)
+        {
+            auto& tile = tiles[t];
+            tile.x0 = (t % tilesX) * TemporalTileSize;
+            tile.y0 = (t / tilesX) * TemporalTileSize;
+            tile.coreWidth = std::min(TemporalTileSize, lineLength - tile.x0);
+            tile.coreHeight = std::min(TemporalTileSize, numLines - tile.y0);
+            const uint width = tile.Width();
+            const uint height = tile.Height();
+
+            for (uint lx = 0; lx < width; ++lx)
+                tile.columns.push_back(wrap((int)tile.x0 - halo + (int)lx, lineLength, verticZip));
+            for (uint ly = 0; ly < height; ++ly)
+                tile.lines.push_back(wrap((int)tile.y0 - halo + (int)ly, numLines, horizZip));
+
+            for (uint ly = 0; ly < height; ++ly)
             {
-                for (auto coord = remBegin; coord < remEnd; ++coord)
-                {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
+                tile.rowRuns.push_back(tile.runs.size());
+                const int y = tile.lines[ly];
+                bool inRun = false;
+                for (uint lx = 0; lx < width; ++lx)
+                {
+                    const int x = tile.columns[lx];
+                    const bool free = (y >= 0 && x >= 0 && !fixed[y * lineLength + x]);
+                    if (free && !inRun)
+                        tile.runs.push_back(std::make_pair(lx, width));
+                    else if (!free && inRun)
+                        tile.runs.back().second = lx;
+                    inRun = free;
                 }
             }
+            tile.rowRuns.push_back(tile.runs.size());
         }
-        LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr.load());
+        return tiles;
     }
 
-    /// Multi-threaded implementation of the finite difference method
-    /// that takes into account that some of the points on the outer
-    /// rows may need to be zipped. The dispatch function can determine this
+    /// Copies a tile with its halo into both local buffers
     static
     void
-    FDMParaZip(Grid* grid, const std::vector<uint>& coordRange,
-               const StopParams& stop, const PreprocessedGridZips& zips)
+    GatherTile(const std::vector<f64>& src, const uint lineLength, const TileLayout& tile,
+               f64* a, f64* b)
     {
-        // NOTE(Chris): Multi-threaded variant
-
-        // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
-        // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
-        //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
-        // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
-
-        // NOTE(Chris): We never write to the fixed points, so we don't
-        // need to re-set them (as long as they were set properly in the
-        // incoming grid using AddFixedPoint)
-
-        JasUnpack((*grid), voltages, numLines, lineLength);
-        JasUnpack(zips, hZip, vZip, hvZip);
-
-        // Create the previous voltage array from the current array
-        decltype(grid->voltages) prevVoltages(voltages);
-
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
+        JasUnpack(tile, columns, lines);
+        const uint width = tile.Width();
+        const uint height = tile.Height();
 
-        // Hand-waving 10k iterations per thread as minimum to not be dominated by context switches etc.
-        const uint numWorkChunks = (prevVoltages.size() / 10000 > 0) ? prevVoltages.size() / 10000 : 1;
-        const uint numThreads = (prevVoltages.size() / omp_get_max_threads() >= 10000)
-            ? (omp_get_max_threads() > MaxThreads ? MaxThreads : omp_get_max_threads())
-            : numWorkChunks;
-        omp_set_num_threads(numThreads);
-        // remaining points that don't divide between the threads
-        const uint rem = prevVoltages.size() % numThreads;
-        // size of work chunk for each thread
-        const uint blockSize = (prevVoltages.size() - rem) / numThreads;
-        LOG("Num threads %u, remainders %u", numThreads, rem);
-
-        // Atomic value for concurrent multi-threaded access
-        std::atomic<f64> maxErr(0.0);
-
-        // Main loop - start with 1 so as not to take slow path on first iter
-        for (u64 i = 1; i <= stop.maxIter; ++i)
+        for (uint ly = 0; ly < height; ++ly)
         {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            std::swap(prevVoltages, voltages);
-            // const ref to avoid damage again
-            const decltype(grid->voltages)& pVoltage = prevVoltages;
-
-            // Used to wrap zip access
-            const auto WrapGridAccessNewVal =
-                [&pVoltage, lineLength, numLines] (const std::pair<uint,uint>& pt) -> f64
-                {
-                    const uint id1 = pt.second * lineLength + (((int)pt.first - 1) < 0
-                                                               ? lineLength - 1
-                                                               : pt.first - 1);
-
-                    const uint id2 = pt.second * lineLength + (pt.first + 1 >= lineLength
-                                                               ? 0
-                                                               : pt.first + 1);
-                    const uint id3 = (((int)pt.second - 1) < 0
-                                      ? numLines - 1
-                                      : pt.second - 1) * lineLength + pt.first;
-
-                    const uint id4 = (pt.second + 1 >= numLines
-                                      ? 0
-                                      : pt.second + 1) * lineLength + pt.first;
-
-                    const f64 newVal = 0.25*(pVoltage[id1] + pVoltage[id2]
-                                             + pVoltage[id3] + pVoltage[id4]);
-                    return newVal;
-                };
-
-            // Loop over threads (split per thread and complete work chunk)
-#pragma omp parallel for default(none) shared(errorChunk, coordRange, lineLength, voltages, maxErr, i, pVoltage)
-            for (uint thread = 0; thread < numThreads; ++thread)
+            f64* row = a + ly * width;
+            const int y = lines[ly];
+            if (y < 0)
             {
-                // chunk start and end
-                const auto start = coordRange.begin() + thread * blockSize;
-                const auto end = (start + blockSize > coordRange.end()) ? coordRange.end() : start + blockSize;
-                // Unlikely means the branch predictor will always go the
-                // other way, it will have to backtrack on the very rare
-                // cases that this comes up (1 in errorChunk times). This
-                // is a penalty of < 200 cycles on those rare occasions
-                if (unlikely(i % errorChunk ==0))
-                {
-                    // Atomic comparisons are slow compared to normal
-                    // scalars, so declare a thread-local maxErr and then
-                    // just update the main one at the end
-                    f64 threadMaxErr = 0.0;
-                    maxErr = 0.0;
-
-                    // Loop over the non-fixed points in the threaded region
-                    for (auto coord = start; coord < end; ++coord)
-                    {
-                        // Apply finite difference method and calculate error
-                        const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                        voltages[*coord] = newVal;
-                        const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
-
-                        if (absErr > threadMaxErr)
-                        {
-                            threadMaxErr = absErr;
-                        }
-                    }
-
-                    // Update global error
-                    if (threadMaxErr > maxErr)
-                    {
-                        maxErr = threadMaxErr;
-                    }
-                }
-                else // normal path
-                {
-                    // Loop over the non-fixed points and apply the FDM only
-                    for (auto coord = start; coord < end; ++coord)
-                    {
-                        const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                        voltages[*coord] = newVal;
-                    }
-                }
-            }
-
-            // Handle the remaining non-fixed cells of the array that were
-            // not handled by the threaded section - otherwise almost the
-            // same as immediately above, but also reassigns the fixed
-            // points
-            const auto remBegin = coordRange.begin() + (numThreads) * blockSize;
-            const auto remEnd = coordRange.end();
-            if (unlikely(i % errorChunk == 0)) // several differences in this branch
-            {
-                f64 localMaxErr = 0.0;
-                const auto remBegin = coordRange.begin() + (numThreads) * blockSize;
-                const auto remEnd = coordRange.end();
-                for (auto coord = remBegin; coord < remEnd; ++coord)
-                {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                    const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
-
-                    if (absErr > localMaxErr)
-                        localMaxErr = absErr;
-                }
-
-                for (const auto& coord : hZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > localMaxErr)
-                    {
-                        localMaxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : vZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > localMaxErr)
-                    {
-                        localMaxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > localMaxErr)
-                    {
-                        localMaxErr = absErr;
-                    }
-                }
-
-                if (localMaxErr > maxErr)
-                {
-                    maxErr = localMaxErr;
-                }
-
-                // If we have converged, then break by leaving the function
-                // TODO(Chris): Time logging
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %e", (unsigned)i, maxErr.load());
-                    return;
-                }
-
-                // Else set new target if possible. If we plot the error
-                // per iteration we not that it remains fixed at 1.0 until
-                // all cells have been filled, after this point it drops
-                // roughly as k*i^{-2} where k is a constant and i is the
-                // number of iterations. => err_i * i^2 = err_j * j^2. So
-                // when err_j is zeroTol, and err_i has been calculated we
-                // can find an approximate value for j
-                if (maxErr < 1.0)
-                {
-                    // If this is calculated near the beginning it tends
-                    // to overshoot, go to a quarter to refine the counter
-                    // (we use a modulo anyway so it will still stop at
-                    // the prediction)
-
-                    long double err = maxErr;
-                    long double sqI = i * i;
-                    long double tol = stop.zeroTol;
-                    errorChunk = 0.05 * std::sqrt(maxErr * sqI / tol);
-
-                    LOG("New target index divisor %u", errorChunk);
-                }
+                std::fill(row, row + width, 0.0);
+                continue;
             }
-            else
-            {
-                for (auto coord = remBegin; coord < remEnd; ++coord)
-                {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                }
-
-                for (const auto& coord : hZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
 
-                for (const auto& coord : vZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-            }
+            const f64* line = src.data() + y * lineLength;
+            for (uint lx = 0; lx < width; ++lx)
+                row[lx] = (columns[lx] < 0) ? 0.0 : line[columns[lx]];
         }
-        LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr.load());
+        std::copy(a, a + width * height, b);
     }
 
-    /// Single threaded finite difference implementation that ignores
-    /// the outer row/column of points where points may need to be
-    /// fixed. Thus, these all need to be fixed points. If handled by
-    /// the dispatch function then this is all handled automagically
+    /// Performs steps Jacobi iterations on a gathered tile, each step
+    /// shrinking the valid region by a cell on each side, so after
+    /// TemporalSteps steps only the core is valid (trapezoid
+    /// tiling). Returns the buffer holding the final values, and sets
+    /// maxErr to the max relative change over the core in the final
+    /// step if computeErr is set
     static
-    void
-    FDMSingleNoZip(Grid* grid, const std::vector<uint>& coordRange, const StopParams& stop)
+    const f64*
+    AdvanceTile(const TileLayout& tile, f64* a, f64* b, const uint steps,
+                const bool computeErr, f64* maxErr)
     {
-        // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
-        // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
-        //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
-        // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
-
-        JasUnpack((*grid), voltages, lineLength);
-
-        // Create the previous voltage array from the current array
-        decltype(grid->voltages) prevVoltages(voltages);
-
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
-
-        f64 maxErr = 0.0;
-
-        // Main loop - start from 1 so as not to calculate error on first iteration
-        for (u64 i = 1; i <= stop.maxIter; ++i)
+        JasUnpack(tile, coreWidth, coreHeight, runs, rowRuns);
+        const uint width = tile.Width();
+        const uint height = tile.Height();
+        const uint halo = TemporalSteps;
+        f64* cur = a;
+        f64* next = b;
+        for (uint t = 1; t <= steps; ++t)
         {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            std::swap(prevVoltages, voltages);
-            // const ref to avoid damage again
-            const decltype(grid->voltages)& pVoltage = prevVoltages;
-
-            // Unlikely means the branch predictor will always go the
-            // other way, it will have to backtrack on the very rare
-            // cases that this comes up (1 in errorChunk times). This
-            // is a penalty of < 200 cycles on those rare occasions
-            if (unlikely(i % errorChunk == 0))
+            for (uint y = t; y < height - t; ++y)
             {
-                // Atomic comparisons are slow compared to normal
-                // scalars, so declare a thread-local maxErr and then
-                // just update the main one at the end
-                f64 threadMaxErr = 0.0;
-                maxErr = 0.0;
-
-                // Loop over the non-fixed points
-                for (auto coord = coordRange.begin(); coord < coordRange.end(); ++coord)
-                {
-                    // Apply finite difference method and calculate error
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                    const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
-
-                    if (absErr > threadMaxErr)
-                    {
-                        threadMaxErr = absErr;
-                    }
-                }
-
-                // Update global error
-                if (threadMaxErr > maxErr)
-                {
-                    maxErr = threadMaxErr;
-                }
-
-                // If we have converged, then break by leaving the function
-                // TODO(Chris): Time logging
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %f", (unsigned)i, maxErr);
-                    return;
-                }
-
-                // Else set new target if possible. If we plot the error
-                // per iteration we not that it remains fixed at 1.0 until
-                // all cells have been filled, after this point it drops
-                // roughly as k*i^{-2} where k is a constant and i is the
-                // number of iterations. => err_i * i^2 = err_j * j^2. So
-                // when err_j is zeroTol, and err_i has been calculated we
-                // can find an approximate value for j
-                if (maxErr < 1.0)
-                {
-                    // If this is calculated near the beginning it tends
-                    // to overshoot, go to a quarter to refine the counter
-                    // (we use a modulo anyway so it will still stop at
-                    // the prediction)
-                    long double err = maxErr;
-                    long double sqI = i * i;
-                    long double tol = stop.zeroTol;
-                    errorChunk = 0.05 * std::sqrt(maxErr * sqI / tol);
-
-                    LOG("New target index divisor %u", errorChunk);
+                const f64* row = cur + y * width;
+                f64* out = next + y * width;
+                for (uint r = rowRuns[y]; r < rowRuns[y + 1]; ++r)
+                {
+                    const uint start = std::max(runs[r].first, t);
+                    const uint end = std::min(runs[r].second, width - t);
+#ifdef USE_SIMD
+                    Stencil::JacobiRow(row, out, nullptr, width, start, end, false);
+#else
+                    const f64* up = row - width;
+                    const f64* down = row + width;
+                    for (uint x = start; x < end; ++x)
+                        out[x] = 0.25 * (row[x + 1] + row[x - 1] + up[x] + down[x]);
+#endif
                 }
             }
-            else // normal path
+            std::swap(cur, next);
+        }
+
+        if (unlikely(computeErr))
+        {
+            // NOTE(Chris): next now holds the penultimate step
+            f64 err = 0.0;
+            for (uint y = halo; y < halo + coreHeight; ++y)
             {
-                // Loop over the non-fixed points and apply the FDM only
-                for (auto coord = coordRange.begin(); coord < coordRange.end(); ++coord)
+                for (uint x = halo; x < halo + coreWidth; ++x)
                 {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
+                    const f64 newVal = cur[y * width + x];
+                    const f64 absErr = std::abs((next[y * width + x] - newVal) / newVal);
+                    if (absErr > err && absErr == absErr)
+                        err = absErr;
                 }
             }
+            *maxErr = err;
         }
-        LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr);
+        return cur;
     }
 
-    /// Single threaded finite difference method that takes into
-    /// account that some points need to be zipped
+    /// Advances every tile of src by steps Jacobi iterations into dst,
+    /// tiles are independent so they are processed in parallel, each
+    /// thread with its own tile buffers. Returns the max relative
+    /// change over the final step if computeErr is set, otherwise 0
     static
-    void
-    FDMSingleZip(Grid* grid, const std::vector<uint>& coordRange,
-                 const StopParams& stop, const PreprocessedGridZips& zips)
+    f64
+    TemporalBlockedSweep(const std::vector<f64>& src, std::vector<f64>* dst,
+                         const std::vector<TileLayout>& tiles, const uint lineLength,
+                         const uint steps, const bool computeErr)
     {
-        // NOTE(Chris): Single Threaded variant
-
-        // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
-        // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
-        //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
-        // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
-
-        JasUnpack((*grid), voltages, numLines, lineLength);
-        JasUnpack(zips, hZip, vZip, hvZip);
-
-        // Create the previous voltage array from the current array
-        decltype(grid->voltages) prevVoltages(voltages);
-
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
+        const uint numTiles = tiles.size();
+        auto& out = *dst;
 
         f64 maxErr = 0.0;
-
-        // Main loop - start from 1 so as not to calculate error on first iteration
-        for (u64 i = 1; i <= stop.maxIter; ++i)
+#pragma omp parallel default(none) shared(src, out, tiles, lineLength, steps, computeErr, numTiles) reduction(max:maxErr)
         {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            std::swap(prevVoltages, voltages);
-            // const ref to avoid damage again
-            const decltype(grid->voltages)& pVoltage = prevVoltages;
+            const uint maxWidth = TemporalTileSize + 2 * TemporalSteps;
+            std::vector<f64> a(maxWidth * maxWidth);
+            std::vector<f64> b(maxWidth * maxWidth);
 
-            // Used to wrap zip access
-            auto WrapGridAccessNewVal = [&pVoltage, numLines, lineLength] (const std::pair<uint,uint>& pt) -> f64
-                {
-                    const uint id1 = pt.second * lineLength + ((int)pt.first - 1 < 0
-                                                                     ? lineLength - 1
-                                                                     : pt.first - 1);
-
-                    const uint id2 = pt.second * lineLength + (pt.first + 1 >= lineLength
-                                                                     ? 0
-                                                                     : pt.first + 1);
-                    const uint id3 = ((int)pt.second - 1 < 0
-                                      ? numLines - 1
-                                      : pt.second - 1) * lineLength + pt.first;
-
-                    const uint id4 = (pt.second + 1 >= numLines
-                                      ? 0
-                                      : pt.second + 1) * lineLength + pt.first;
-
-                    const f64 newVal = 0.25*(pVoltage[id1] + pVoltage[id2]
-                                             + pVoltage[id3] + pVoltage[id4]);
-                    return newVal;
-                };
-
-            // Unlikely means the branch predictor will always go the
-            // other way, it will have to backtrack on the very rare
-            // cases that this comes up (1 in errorChunk times). This
-            // is a penalty of < 200 cycles on those rare occasions
-            if (unlikely(i % errorChunk == 0))
+#pragma omp for schedule(static)
+            for (uint t = 0; t < numTiles; ++t)
             {
-                // Atomic comparisons are slow compared to normal
-                // scalars, so declare a thread-local maxErr and then
-                // just update the main one at the end
-                f64 threadMaxErr = 0.0;
-                maxErr = 0.0;
-
-                // Loop over the non-fixed points
-                for (auto coord = coordRange.begin(); coord < coordRange.end(); ++coord)
-                {
-                    // Apply finite difference method and calculate error
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                    const f64 absErr = std::abs((pVoltage[*coord] - newVal)/newVal);
-
-                    if (absErr > threadMaxErr)
-                    {
-                        threadMaxErr = absErr;
-                    }
-                }
+                const auto& tile = tiles[t];
+                GatherTile(src, lineLength, tile, a.data(), b.data());
 
-                for (const auto& coord : hZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > threadMaxErr)
-                    {
-                        threadMaxErr = absErr;
-                    }
-                }
+                f64 tileErr = 0.0;
+                const f64* result = AdvanceTile(tile, a.data(), b.data(), steps, computeErr, &tileErr);
+                if (tileErr > maxErr)
+                    maxErr = tileErr;
 
-                for (const auto& coord : vZip)
+                const uint width = tile.Width();
+                for (uint y = 0; y < tile.coreHeight; ++y)
                 {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > threadMaxErr)
-                    {
-                        threadMaxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((pVoltage[coord.second * lineLength + coord.first] - newVal)/newVal);
-
-                    if (absErr > threadMaxErr)
-                    {
-                        threadMaxErr = absErr;
-                    }
-                }
-
-                // Update global error
-                if (threadMaxErr > maxErr)
-                {
-                    maxErr = threadMaxErr;
-                }
-
-                // If we have converged, then break by leaving the function
-                // TODO(Chris): Time logging
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %f", (unsigned)i, maxErr);
-                    return;
-                }
-
-                // Else set new target if possible. If we plot the error
-                // per iteration we not that it remains fixed at 1.0 until
-                // all cells have been filled, after this point it drops
-                // roughly as k*i^{-2} where k is a constant and i is the
-                // number of iterations. => err_i * i^2 = err_j * j^2. So
-                // when err_j is zeroTol, and err_i has been calculated we
-                // can find an approximate value for j
-                if (maxErr < 1.0)
-                {
-                    // If this is calculated near the beginning it tends
-                    // to overshoot, go to a quarter to refine the counter
-                    // (we use a modulo anyway so it will still stop at
-                    // the prediction)
-
-                    long double err = maxErr;
-                    long double sqI = i * i;
-                    long double tol = stop.zeroTol;
-                    errorChunk = 0.05 * std::sqrt(maxErr * sqI / tol);
-
-                    LOG("New target index divisor %u", errorChunk);
-                }
-            }
-            else // normal path
-            {
-                // Loop over the non-fixed points and apply the FDM only
-                for (auto coord = coordRange.begin(); coord < coordRange.end(); ++coord)
-                {
-                    const f64 newVal = 0.25 * (pVoltage[(*coord) + 1] + pVoltage[(*coord) - 1] + pVoltage[(*coord) - lineLength] + pVoltage[(*coord) + lineLength]);
-                    voltages[*coord] = newVal;
-                }
-
-                for (const auto& coord : hZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-
-                for (const auto& coord : vZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
+                    const f64* row = result + (y + TemporalSteps) * width + TemporalSteps;
+                    std::copy(row, row + tile.coreWidth, out.begin() + (tile.y0 + y) * lineLength + tile.x0);
                 }
             }
         }
-        LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr);
+        return maxErr;
     }
 
-    /// Types of possible problems with Zip definition
-    enum class ZipDefinitionProblem
-    {
-        Horizontal,
-        Vertical,
-        Both,
-        None
-    };
-
-    /// Checks the validity of the grid WRT the zip settings and
-    /// returns the problem with it (if there is one)
+    /// Temporally blocked Jacobi iteration. Rather than streaming the
+    /// whole grid through memory once per iteration, each cache-sized
+    /// tile is gathered with a halo and advanced TemporalSteps
+    /// iterations before being written back, so the grid is streamed
+    /// once per TemporalSteps iterations at the cost of some redundant
+    /// work on the halos. The iterates are exactly those of the plain
+    /// Jacobi method, and all zip combinations are supported. The error
+    /// is checked every 500 iterations, and with anderson set the
+    /// iterate is then extrapolated from the previous ones
     static
-    ZipDefinitionProblem
-    CheckGridZips(const Grid& grid)
+    bool
+    FDMTemporalBlocked(Grid* grid, const StopParams& stop, bool parallel, bool anderson)
     {
-        JasUnpack(grid, verticZip, horizZip, numLines, lineLength, fixedPoints);
-
-        if (!horizZip || !verticZip)
-        {
-                if (fixedPoints.count(0) == 0
-                    || fixedPoints.count(lineLength - 1) == 0
-                    || fixedPoints.count((numLines - 1) * lineLength) == 0
-                    || fixedPoints.count((numLines - 1) * lineLength + lineLength - 1) == 0)
-                {
-                    LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-                    return ZipDefinitionProblem::Both;
-                }
-        }
+        JasUnpack((*grid), voltages, lineLength, fixedPoints);
+
+        std::vector<u8> fixed(voltages.size(), 0);
+        for (const auto& pt : fixedPoints)
+            fixed[pt.first] = 1;
+        const std::vector<TileLayout> tiles = BuildTileLayouts(*grid, fixed);
+
+        const uint numCells = voltages.size();
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+        LOG("Temporally blocked Jacobi, tile %u, %u steps per visit, num threads %u",
+            TemporalTileSize, TemporalSteps, parallel ? numThreads : 1);
 
-        if (!verticZip)
+        std::unique_ptr<Anderson::Accelerator> accel;
+        if (anderson)
         {
-            // Check first and final column for empty pixels (corners require more specific check)
-            for (uint y = 1; y < numLines - 1; ++y)
-            {
-                if (fixedPoints.count(y * lineLength) == 0
-                    || fixedPoints.count(y * lineLength + lineLength - 1) == 0)
-                {
-                    LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-                    return ZipDefinitionProblem::Vertical;
-                }
-            }
+            Laplacian::CellGraph graph;
+            if (!Laplacian::BuildCellGraph(*grid, &graph))
+                return false;
+            accel = Sweep::MakeAccelerator(true, Sweep::Unknowns(graph), &voltages);
         }
 
-        if (!horizZip)
-        {
-            // Check first and final row for empty pixels (corners require more specific check)
-            for (uint x = 1; x < lineLength - 1; ++x)
-            {
-                if (fixedPoints.count(x) == 0
-                    || fixedPoints.count((numLines - 1) * lineLength + x) == 0)
-                {
-                    LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-                    return ZipDefinitionProblem::Horizontal;
-                }
-            }
-        }
-        return ZipDefinitionProblem::None;
+        // NOTE(Chris): Each call advances TemporalSteps iterations, 500
+        // is a multiple of this, so the error is always checked on the
+        // last step of a block
+        std::vector<f64> prevVoltages(voltages);
+        return Sweep::Run([&prevVoltages, &voltages, &tiles, lineLength] (bool computeErr)
+                          {
+                              std::swap(prevVoltages, voltages);
+                              return TemporalBlockedSweep(prevVoltages, &voltages, tiles, lineLength,
+                                                          TemporalSteps, computeErr);
+                          },
+                          [&voltages] () -> const std::vector<f64>&
+                          {
+                              return voltages;
+                          }, stop, Sweep::Checks::Fixed,
+                          Sweep::Accelerate(accel.get(), &voltages), TemporalSteps);
     }
 
-    /// Prepares vectors of the zipped points (the ones which require
-    /// special overlap treatment), and returns a struct of these 3
-    /// vectors
+#ifdef USE_SIMD
+    /// Performs one Jacobi iteration from src into dst, the interior
+    /// rows in parallel with the vectorised row kernels, followed by
+    /// the zipped edge cells. Returns the max relative change if
+    /// computeErr is set, otherwise 0
     static
-    PreprocessedGridZips
-    PreprocessGridZips(const Grid& grid)
+    f64
+    RowSweep(const std::vector<f64>& src, std::vector<f64>* dst,
+             const Laplacian::CellGraph& graph, const std::vector<u8>& update,
+             const bool computeErr)
     {
-        std::vector<std::pair<uint, uint> > horizZipPoints;
-        std::vector<std::pair<uint, uint> > verticZipPoints;
-        std::vector<std::pair<uint, uint> > horizAndVerticZipPoints;
+        JasUnpack(graph, lineLength, numLines, edge, edgeNeighbours);
+        const f64* in = src.data();
+        f64* out = dst->data();
+        const u8* mask = update.data();
 
-        JasUnpack(grid, verticZip, horizZip, lineLength, numLines, fixedPoints);
-        if (horizZip)
+        f64 maxErr = 0.0;
+#pragma omp parallel for default(none) shared(in, out, mask, lineLength, numLines, computeErr) reduction(max:maxErr)
+        for (uint y = 1; y < numLines - 1; ++y)
         {
-            horizZipPoints.reserve(2 * lineLength);
-            for (uint x = 1; x < lineLength - 1; ++x)
-            {
-                if (fixedPoints.count(x) == 0)
-                {
-                    horizZipPoints.push_back(std::make_pair(x, 0));
-                }
-
-                if (fixedPoints.count((numLines - 1) * lineLength + x) == 0)
-                {
-                    horizZipPoints.push_back(std::make_pair(x, numLines - 1));
-                }
-            }
+            const uint row = y * lineLength;
+            const f64 err = Stencil::JacobiRow(in + row, out + row, mask + row, lineLength,
+                                               1, lineLength - 1, computeErr);
+            if (err > maxErr)
+                maxErr = err;
         }
-        // Sort automatically compares first, then second types for pairs
-        std::sort(horizZipPoints.begin(), horizZipPoints.end());
 
-        if (verticZip)
+        for (uint e = 0; e < edge.size(); ++e)
         {
-            verticZipPoints.reserve(2*numLines);
-            for (uint y = 1; y < numLines - 1; ++y)
-            {
-                if (fixedPoints.count(y * lineLength) == 0)
-                {
-                    verticZipPoints.push_back(std::make_pair(0, y));
-                }
-                if (fixedPoints.count(y * lineLength + lineLength - 1) == 0)
-                {
-                    verticZipPoints.push_back(std::make_pair(lineLength - 1, y));
-                }
-            }
-        }
-        std::sort(verticZipPoints.begin(), verticZipPoints.end());
+            const auto& n = edgeNeighbours[e];
+            const f64 newVal = 0.25 * (in[n[0]] + in[n[1]] + in[n[2]] + in[n[3]]);
+            out[edge[e]] = newVal;
 
-        if (horizZip && verticZip)
-        {
-            horizAndVerticZipPoints.reserve(4);
-            if (fixedPoints.count(0) == 0)
+            if (unlikely(computeErr))
             {
-                horizAndVerticZipPoints.push_back(std::make_pair(0,0));
-            }
-            if (fixedPoints.count(lineLength - 1) == 0)
-            {
-                horizAndVerticZipPoints.push_back(std::make_pair(lineLength, 0));
-            }
-            if (fixedPoints.count((numLines - 1) * lineLength) == 0)
-            {
-                horizAndVerticZipPoints.push_back(std::make_pair(0, numLines - 1));
-            }
-            if (fixedPoints.count((numLines - 1) * lineLength + lineLength - 1) == 0)
-            {
-                horizAndVerticZipPoints.push_back(std::make_pair(lineLength - 1, numLines - 1));
+                const f64 absErr = std::abs((in[edge[e]] - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                    maxErr = absErr;
             }
         }
-        std::sort(horizAndVerticZipPoints.begin(), horizAndVerticZipPoints.end());
+        return maxErr;
+    }
 
-        return PreprocessedGridZips(std::move(horizZipPoints),
-                                    std::move(verticZipPoints),
-                                    std::move(horizAndVerticZipPoints));
+    /// Jacobi iteration sweeping the grid a row at a time with the
+    /// vectorised kernels (masking out the fixed cells), rather than
+    /// gathering through the list of non-fixed cells. The iterates are
+    /// the same as the other methods, and all zip combinations are
+    /// supported. With anderson set the iterate is extrapolated from
+    /// the previous ones at each error check
+    static
+    bool
+    FDMRows(Grid* grid, const StopParams& stop, bool parallel, bool anderson)
+    {
+        JasUnpack((*grid), voltages);
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        std::vector<u8> update(voltages.size(), 0);
+        for (auto c : graph.interior)
+            update[c] = 1;
+
+        const uint numCells = voltages.size();
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+        LOG("Jacobi row sweeps using %s kernels, num threads %u",
+            Stencil::InstructionSetName(Stencil::ActiveInstructionSet()), parallel ? numThreads : 1);
+
+        const auto accel = Sweep::MakeAccelerator(anderson, Sweep::Unknowns(graph), &voltages);
+
+        std::vector<f64> prevVoltages(voltages);
+        return Sweep::Run([&prevVoltages, &voltages, &graph, &update] (bool computeErr)
+                          {
+                              std::swap(prevVoltages, voltages);
+                              return RowSweep(prevVoltages, &voltages, graph, update, computeErr);
+                          },
+                          [&voltages] () -> const std::vector<f64>&
+                          {
+                              return voltages;
+                          }, stop, Sweep::Checks::Fixed,
+                          Sweep::Accelerate(accel.get(), &voltages));
     }
+#endif
 
     /// The dispatch function for finite difference method. Checks the
     /// validity of the grid WRT zip parameters and then dispatches it
-    /// to 1 of 4 worked functions, depending on whether it has zips,
-    /// and whether we are running parallel code or not
-    void
+    /// to the row sweeps (with USE_SIMD and a vector instruction set),
+    /// the temporally blocked method, or the sweep over the cell
+    /// lists, which picks its kernel for the zips and threading from a
+    /// dispatch table
+    bool
     FDMSolver(Grid* grid, const f64 zeroTol,
-                           const u64 maxIter, bool parallel)
+                           const u64 maxIter, bool parallel, bool temporalBlocking,
+                           bool anderson)
     {
         TIME_FUNCTION();
         // NOTE(Chris): This function dispatches the calculation to
-        // the most appropriate function (zips or not, parallel or
-        // not), after having preprocessed the grid to check its
-        // validity
-
-        // NOTE(Chris): The only way I can think of to improve this from
-        // here is SIMD. But that also poses certain problems, we'd need
-        // to iterate over all cells (for memory alignedness), rather than
-        // just the non-fixed cells, then we would need to reassign the
-        // fixed cells (would blow the cache), even with AVX we probably
-        // wouldn't get more than a 2.5x gain unless I'm missing something
-        // algorithmically
-
-        JasUnpack((*grid), horizZip, verticZip, numLines, lineLength, fixedPoints);
-
-        // NOTE(Chris): We choose to trade off some memory for computation
-        // speed inside the loop
-        std::vector<uint> coordRange; // non fixed points
-        coordRange.reserve(numLines*lineLength);
-
-        // Ignore outer boundary (handled by zips)
-        for (uint y = 1; y < numLines - 1; ++y)
-            for (uint x = 1; x < lineLength - 1; ++x)
-            {
-                if (fixedPoints.count(y * lineLength + x) == 0)
-                {
-                    coordRange.push_back(y * lineLength + x);
-                }
-            }
-
-        switch (CheckGridZips(*grid))
-        {
-        case ZipDefinitionProblem::Both:
-        {
-            LOG("Check both zip definitions");
-            return;
-        } break;
-
-        case ZipDefinitionProblem::Horizontal:
+        // the most appropriate function, after having preprocessed
+        // the grid to check its validity
+
+        // NOTE(Chris): With USE_SIMD and a vector instruction set the
+        // default path iterates over whole rows (for the vector loads), rather than just the
+        // non-fixed cells, and blends the fixed cells back in. This
+        // costs some wasted lanes where the grid is mostly fixed
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        // NOTE(Chris): The temporally blocked and row sweeps are
+        // 5-point only, so the 9-point stencil always uses the cell
+        // lists
+        if (Laplacian::ActiveStencil() == Cfg::StencilType::NinePoint)
         {
-            LOG("Check horizontal zip definition");
-            return;
-        } break;
-
-        case ZipDefinitionProblem::Vertical:
-        {
-            LOG("Check vertical zip definition");
-            return;
-        } break;
+            if (temporalBlocking)
+                LOG("Temporal blocking only supports the 5-point stencil, ignoring it");
+            return FDMCells(grid, graph, StopParams(*grid, zeroTol, maxIter),
+                            parallel && omp_get_max_threads() > 1, anderson);
+        }
 
-        default:
+        if (temporalBlocking)
         {
-
-        } break;
+            return FDMTemporalBlocked(grid, StopParams(*grid, zeroTol, maxIter), parallel, anderson);
         }
 
         // If we can't get more threads then run the simpler non-parallel version;
         if (omp_get_max_threads() == 1)
             parallel = false;
 
-        if (!verticZip && !horizZip)
+#ifdef USE_SIMD
+        // NOTE(Chris): As in red-black, the row sweeps only pay off
+        // with the vector kernels, the scalar row kernel visits every
+        // cell of the row
+        if (Stencil::ActiveInstructionSet() != Stencil::InstructionSet::Scalar)
         {
-            if (parallel)
-            {
-                FDMParaNoZip(grid, coordRange, StopParams(zeroTol, maxIter));
-            }
-            else
-            {
-                FDMSingleNoZip(grid, coordRange, StopParams(zeroTol, maxIter));
-            }
-            return;
+            return FDMRows(grid, StopParams(*grid, zeroTol, maxIter), parallel, anderson);
         }
+#endif
 
-        auto zips = PreprocessGridZips(*grid);
-
-        if (parallel)
-        {
-            FDMParaZip(grid, coordRange, StopParams(zeroTol, maxIter), zips);
-        }
-        else
-        {
-            FDMSingleZip(grid, coordRange, StopParams(zeroTol, maxIter), zips);
-        }
+        return FDMCells(grid, graph, StopParams(*grid, zeroTol, maxIter), parallel, anderson);
     }
 }
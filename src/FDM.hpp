@@ -18,8 +18,16 @@ namespace FDM
     /// Solves the Grid using a finite difference method, set parallel
     /// to false to run single threaded, the zeroTol and maxIter
     /// parameters control the convergence breaking on whichever comes first.
-    void
+    /// If temporalBlocking is set each cache-sized tile is advanced
+    /// several iterations per pass over the grid, which gives the same
+    /// iterates for much less memory traffic on large grids. If
+    /// anderson is set the iterate is extrapolated from the last few
+    /// at each error check (see Anderson.hpp). Temporal blocking is
+    /// ignored with the 9-point stencil selected. Returns true if the
+    /// solution converged before maxIter
+    bool
     FDMSolver(Grid* grid, const f64 zeroTol,
-              const u64 maxIter, bool parallel = true);
+              const u64 maxIter, bool parallel = true,
+              bool temporalBlocking = false, bool anderson = false);
 }
 #endif
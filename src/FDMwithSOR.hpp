@@ -1,17 +1,22 @@
-
 #if !defined(FDMSOR_H)
 
 #define FDMSOR_H
-// Finite difference method implementations
+// Successive over-relaxation
 
 #include "GlobalDefines.hpp"
 
 class Grid;
 namespace SOR
 {
-    // an ammended version of SolveGridLaplacianZero that uses succesive over relaxation
-    void
+    /// Red-black ordered successive over-relaxation, using the
+    /// optimal over-relaxation factor derived from an estimate of the
+    /// Jacobi spectral radius. Supports all zip combinations. With the
+    /// 9-point stencil selected the cells are ordered in four colours.
+    /// If anderson is set the iterate is extrapolated from the last few
+    /// at each error check (see Anderson.hpp). Returns true if the
+    /// solution converged before maxIter
+    bool
     SORSolver(Grid* grid, const f64 zeroTol,
-              const u64 maxIter, bool parallel = false);
+              const u64 maxIter, bool parallel = true, bool anderson = false);
 }
 #endif
@@ -0,0 +1,183 @@
+/* ==========================================================================
+   $File: FFT.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "FFT.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FFT
+{
+    Plan::Plan(const uint length)
+        : length_(length),
+          pow2_(IsPow2(length))
+    {
+        // NOTE(Chris): Bluestein needs a linear convolution of length
+        // 2n - 1 to fit without wrapping
+        convLength_ = 1;
+        const uint minLength = pow2_ ? length : 2 * length - 1;
+        while (convLength_ < minLength)
+            convLength_ *= 2;
+
+        // NOTE(Chris): Twiddles for each stage are stored contiguously
+        // (exp(-i pi k / half) for k < half, at offset half - 1) so the
+        // inner loop of the butterflies reads them in order
+        twiddles_.resize(convLength_ > 1 ? convLength_ - 1 : 0);
+        for (uint half = 1; half < convLength_; half *= 2)
+        {
+            for (uint k = 0; k < half; ++k)
+            {
+                const f64 angle = -M_PI * (f64)k / (f64)half;
+                twiddles_[half - 1 + k] = Complex(std::cos(angle), std::sin(angle));
+            }
+        }
+
+        bitReverse_.resize(convLength_);
+        uint bits = 0;
+        while ((1u << bits) < convLength_)
+            ++bits;
+        for (uint i = 0; i < convLength_; ++i)
+        {
+            uint rev = 0;
+            for (uint b = 0; b < bits; ++b)
+                rev |= ((i >> b) & 1) << (bits - 1 - b);
+            bitReverse_[i] = rev;
+        }
+
+        if (pow2_)
+            return;
+
+        // NOTE(Chris): j^2 is reduced mod 2n before the trig, as the
+        // angle otherwise loses precision for large j
+        chirp_.resize(length_);
+        for (uint j = 0; j < length_; ++j)
+        {
+            const u64 jSq = ((u64)j * (u64)j) % (2 * (u64)length_);
+            const f64 angle = -M_PI * (f64)jSq / (f64)length_;
+            chirp_[j] = Complex(std::cos(angle), std::sin(angle));
+        }
+
+        kernelTransform_.assign(convLength_, Complex(0.0, 0.0));
+        kernelTransform_[0] = std::conj(chirp_[0]);
+        for (uint j = 1; j < length_; ++j)
+        {
+            kernelTransform_[j] = std::conj(chirp_[j]);
+            kernelTransform_[convLength_ - j] = std::conj(chirp_[j]);
+        }
+        Radix2(kernelTransform_.data(), false);
+    }
+
+    void
+    Plan::Radix2(Complex* data, const bool inverse) const
+    {
+        // NOTE(Chris): A length 1 transform is the identity, and the
+        // first stage below would read past the end of it
+        const uint n = convLength_;
+        if (n < 2)
+            return;
+
+        for (uint i = 0; i < n; ++i)
+        {
+            if (i < bitReverse_[i])
+                std::swap(data[i], data[bitReverse_[i]]);
+        }
+
+        // NOTE(Chris): std::complex is guaranteed to be laid out as
+        // re, im pairs. The arithmetic is written out by hand, as the
+        // std::complex operator* has to check for infs and NaNs,
+        // which stops it from being vectorised
+        f64* d = reinterpret_cast<f64*>(data);
+        const f64* tw = reinterpret_cast<const f64*>(twiddles_.data());
+        const f64 sign = inverse ? -1.0 : 1.0;
+
+        // NOTE(Chris): The first stage has only trivial twiddles
+        for (uint start = 0; start < 2 * n; start += 4)
+        {
+            const f64 ar = d[start];
+            const f64 ai = d[start + 1];
+            const f64 br = d[start + 2];
+            const f64 bi = d[start + 3];
+            d[start] = ar + br;
+            d[start + 1] = ai + bi;
+            d[start + 2] = ar - br;
+            d[start + 3] = ai - bi;
+        }
+
+        for (uint half = 2; half < n; half *= 2)
+        {
+            const f64* w = tw + 2 * (half - 1);
+            for (uint start = 0; start < n; start += 2 * half)
+            {
+                f64* a = d + 2 * start;
+                f64* b = d + 2 * (start + half);
+                for (uint k = 0; k < half; ++k)
+                {
+                    const f64 wr = w[2 * k];
+                    const f64 wi = sign * w[2 * k + 1];
+                    const f64 br = wr * b[2 * k] - wi * b[2 * k + 1];
+                    const f64 bi = wr * b[2 * k + 1] + wi * b[2 * k];
+                    const f64 ar = a[2 * k];
+                    const f64 ai = a[2 * k + 1];
+                    a[2 * k] = ar + br;
+                    a[2 * k + 1] = ai + bi;
+                    b[2 * k] = ar - br;
+                    b[2 * k + 1] = ai - bi;
+                }
+            }
+        }
+    }
+
+    /// out = a * b for n complex values, written out by hand for the
+    /// same reason as in Radix2
+    static
+    void
+    MultiplyComplex(const Complex* aIn, const Complex* bIn, Complex* outC,
+                    const uint n, const f64 scale)
+    {
+        const f64* a = reinterpret_cast<const f64*>(aIn);
+        const f64* b = reinterpret_cast<const f64*>(bIn);
+        f64* out = reinterpret_cast<f64*>(outC);
+        for (uint i = 0; i < n; ++i)
+        {
+            const f64 re = a[2 * i] * b[2 * i] - a[2 * i + 1] * b[2 * i + 1];
+            const f64 im = a[2 * i] * b[2 * i + 1] + a[2 * i + 1] * b[2 * i];
+            out[2 * i] = scale * re;
+            out[2 * i + 1] = scale * im;
+        }
+    }
+
+    void
+    Plan::Forward(Complex* data, Complex* scratch) const
+    {
+        if (pow2_)
+        {
+            Radix2(data, false);
+            return;
+        }
+
+        // X_k = chirp_k sum_j (x_j chirp_j) conj(chirp_{k-j})
+        MultiplyComplex(data, chirp_.data(), scratch, length_, 1.0);
+        std::fill(scratch + length_, scratch + convLength_, Complex(0.0, 0.0));
+
+        Radix2(scratch, false);
+        MultiplyComplex(scratch, kernelTransform_.data(), scratch, convLength_, 1.0);
+        Radix2(scratch, true);
+
+        MultiplyComplex(scratch, chirp_.data(), data, length_, 1.0 / (f64)convLength_);
+    }
+
+    void
+    Plan::Inverse(Complex* data, Complex* scratch) const
+    {
+        // NOTE(Chris): conj(F(conj(x))) is the unscaled inverse
+        for (uint j = 0; j < length_; ++j)
+            data[j] = std::conj(data[j]);
+        Forward(data, scratch);
+        for (uint j = 0; j < length_; ++j)
+            data[j] = std::conj(data[j]);
+    }
+}
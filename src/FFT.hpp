@@ -0,0 +1,68 @@
+// -*- c++ -*-
+#if !defined(FFT_H)
+/* ==========================================================================
+   $File: FFT.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define FFT_H
+// Self-contained complex FFT, so that we don't need an external
+// library
+
+#include "GlobalDefines.hpp"
+
+#include <complex>
+#include <vector>
+
+namespace FFT
+{
+    typedef std::complex<f64> Complex;
+
+    /// Precomputed discrete Fourier transform of a fixed length.
+    /// Powers of 2 use an iterative radix-2 transform, other lengths
+    /// are turned into a power of 2 convolution with Bluestein's
+    /// algorithm. A plan is immutable once built, so it can be shared
+    /// between threads, each providing its own scratch space
+    class Plan
+    {
+    public:
+        Plan(const uint length);
+
+        uint
+        Length() const { return length_; }
+
+        /// Number of Complex values of scratch space Forward and
+        /// Inverse need
+        uint
+        ScratchSize() const { return pow2_ ? 0 : convLength_; }
+
+        /// In place X_k = sum_j x_j exp(-2 pi i jk / n)
+        void
+        Forward(Complex* data, Complex* scratch) const;
+
+        /// In place x_j = sum_k X_k exp(2 pi i jk / n), note: unscaled,
+        /// i.e. Inverse(Forward(x)) = n x
+        void
+        Inverse(Complex* data, Complex* scratch) const;
+
+    private:
+        /// In place radix-2 transform of length convLength_, with
+        /// exp(+-2 pi i / m) depending on inverse
+        void
+        Radix2(Complex* data, const bool inverse) const;
+
+        uint length_;
+        bool pow2_;
+        /// Length of the radix-2 transforms
+        uint convLength_;
+        std::vector<Complex> twiddles_;
+        std::vector<uint> bitReverse_;
+        /// Bluestein chirp exp(-pi i j^2 / n) and the transform of
+        /// its (conjugated, wrapped) convolution kernel
+        std::vector<Complex> chirp_;
+        std::vector<Complex> kernelTransform_;
+    };
+}
+#endif
@@ -0,0 +1,598 @@
+/* ==========================================================================
+   $File: FastPoisson.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "FastPoisson.hpp"
+#include "FFT.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FastPoisson
+{
+    /// Max number of threads to be used by OpenMP
+    const uint MaxThreads = 30;
+
+    /// Number of neighbouring columns each thread solves together in
+    /// the tridiagonal stage, so that the sweeps over y stay
+    /// contiguous in memory
+    const uint ColumnBlock = 64;
+
+    typedef FFT::Complex Complex;
+
+    /// Precomputed fast solver for A u = f on an nx x ny rectangle,
+    /// where A is the 5-point Laplacian with 4 on the diagonal, and
+    /// each direction is either periodic or has u = 0 just outside
+    /// it. Each row is transformed into the eigenvectors of the x
+    /// part of A (sines or Fourier modes), leaving an independent
+    /// tridiagonal (or cyclic tridiagonal) system in y per mode
+    struct RectangleSolver
+    {
+        uint nx;
+        uint ny;
+        bool periodicX;
+        bool periodicY;
+        /// Length nx + 1 for sines, nx for Fourier
+        FFT::Plan plan;
+        /// sin(pi j / (nx + 1)) for the sine transforms
+        std::vector<f64> sinTable;
+        /// Eigenvalue of the x part of A for each coefficient of a row
+        std::vector<f64> lambdaX;
+        /// Inverse pivots of the elimination down each column (ny x nx)
+        std::vector<f64> invPivot;
+        /// Sherman-Morrison correction vector and denominator of the
+        /// cyclic systems (periodicY only)
+        std::vector<f64> cyclicZ;
+        std::vector<f64> cyclicDenom;
+
+        RectangleSolver(const uint _nx, const uint _ny, const bool _periodicX, const bool _periodicY)
+            : nx(_nx),
+              ny(_ny),
+              periodicX(_periodicX),
+              periodicY(_periodicY),
+              plan(_periodicX ? _nx : _nx + 1)
+        {}
+
+        /// Both directions periodic, A then has the constant vector
+        /// in its null space
+        bool
+        Singular() const { return periodicX && periodicY; }
+    };
+
+    /// Fills in the eigenvalues and factorisations of the solver
+    static
+    void
+    PrepareRectangleSolver(RectangleSolver* s)
+    {
+        JasUnpack((*s), nx, ny, periodicX, periodicY);
+
+        // NOTE(Chris): Periodic rows are stored as half-complex
+        // spectra: Re X_0, Re X_1, Im X_1, Re X_2, Im X_2, ... (and
+        // Re X_n/2 last for even n), the real and imaginary parts of a
+        // mode share its eigenvalue
+        if (!periodicX)
+        {
+            s->sinTable.resize(nx + 1);
+            for (uint j = 0; j <= nx; ++j)
+                s->sinTable[j] = std::sin(M_PI * (f64)j / (f64)(nx + 1));
+        }
+
+        s->lambdaX.resize(nx);
+        for (uint i = 0; i < nx; ++i)
+        {
+            if (periodicX)
+            {
+                const uint k = (i + 1) / 2;
+                s->lambdaX[i] = 2.0 - 2.0 * std::cos(2.0 * M_PI * (f64)k / (f64)nx);
+            }
+            else
+            {
+                s->lambdaX[i] = 2.0 - 2.0 * std::cos(M_PI * (f64)(i + 1) / (f64)(nx + 1));
+            }
+        }
+
+        // NOTE(Chris): Each column solves -u_y-1 + d u_y - u_y+1 = f_y
+        // with d = 2 + lambdaX. The cyclic case follows the
+        // Sherman-Morrison approach of Numerical Recipes' cyclic, with
+        // gamma = -d and both corners -1
+        s->invPivot.resize(nx * ny);
+        if (periodicY)
+        {
+            s->cyclicZ.resize(nx * ny);
+            s->cyclicDenom.resize(nx);
+        }
+
+        for (uint i = 0; i < nx; ++i)
+        {
+            const f64 d = 2.0 + s->lambdaX[i];
+            if (!periodicY)
+            {
+                f64 pivot = d;
+                s->invPivot[i] = 1.0 / pivot;
+                for (uint y = 1; y < ny; ++y)
+                {
+                    pivot = d - 1.0 / pivot;
+                    s->invPivot[y * nx + i] = 1.0 / pivot;
+                }
+                continue;
+            }
+
+            f64 pivot = 2.0 * d;
+            s->invPivot[i] = 1.0 / pivot;
+            for (uint y = 1; y < ny; ++y)
+            {
+                pivot = ((y == ny - 1) ? d + 1.0 / d : d) - 1.0 / pivot;
+                s->invPivot[y * nx + i] = 1.0 / pivot;
+            }
+
+            // Solve the modified system for u = (-d, 0, ..., 0, -1)
+            auto& z = s->cyclicZ;
+            for (uint y = 0; y < ny; ++y)
+                z[y * nx + i] = 0.0;
+            z[i] = -d;
+            z[(ny - 1) * nx + i] = -1.0;
+            for (uint y = 1; y < ny; ++y)
+                z[y * nx + i] += z[(y - 1) * nx + i] * s->invPivot[(y - 1) * nx + i];
+            z[(ny - 1) * nx + i] *= s->invPivot[(ny - 1) * nx + i];
+            for (int y = ny - 2; y >= 0; --y)
+                z[y * nx + i] = (z[y * nx + i] + z[(y + 1) * nx + i]) * s->invPivot[y * nx + i];
+
+            const f64 denom = 1.0 + z[i] + z[(ny - 1) * nx + i] / d;
+            // NOTE(Chris): The constant mode of a singular solver is
+            // handled separately, keep the division harmless
+            s->cyclicDenom[i] = (s->Singular() && i == 0) ? 1.0 : denom;
+        }
+    }
+
+    /// Transforms rows of f (in pairs, packed into the real and
+    /// imaginary parts of one complex transform) into, or back out
+    /// of, the eigenvectors of the x part of A
+    static
+    void
+    TransformRows(const RectangleSolver& s, std::vector<f64>* data, const bool inverse)
+    {
+        JasUnpack(s, nx, ny, periodicX, plan, sinTable);
+        auto& f = *data;
+        const uint numPairs = (ny + 1) / 2;
+
+#pragma omp parallel default(none) shared(f, nx, ny, periodicX, plan, sinTable, numPairs, inverse)
+        {
+            std::vector<Complex> z(plan.Length());
+            std::vector<Complex> scratch(plan.ScratchSize());
+            std::vector<f64> zeroRow(nx, 0.0);
+
+#pragma omp for
+            for (uint pair = 0; pair < numPairs; ++pair)
+            {
+                f64* r1 = &f[2 * pair * nx];
+                // NOTE(Chris): An odd final row is paired with a dummy
+                f64* r2 = (2 * pair + 1 < ny) ? &f[(2 * pair + 1) * nx] : zeroRow.data();
+
+                if (!periodicX)
+                {
+                    // NOTE(Chris): DST-I of length N - 1 from a DFT of
+                    // length N (N = nx + 1) of
+                    // y_j = sin(pi j/N) (f_j + f_N-j) + (f_j - f_N-j)/2
+                    // which gives F_2k = -Im Y_k, F_1 = Re Y_0 / 2 and
+                    // F_2k+1 = F_2k-1 + Re Y_k. The DST-I is its own
+                    // inverse up to a factor of 2/N
+                    const uint n = plan.Length();
+                    z[0] = Complex(0.0, 0.0);
+                    for (uint j = 1; j < n; ++j)
+                    {
+                        // f_j is stored at j - 1
+                        const Complex fj(r1[j - 1], r2[j - 1]);
+                        const Complex fnj(r1[n - j - 1], r2[n - j - 1]);
+                        z[j] = sinTable[j] * (fj + fnj) + 0.5 * (fj - fnj);
+                    }
+                    plan.Forward(z.data(), scratch.data());
+
+                    const f64 scale = inverse ? 2.0 / (f64)n : 1.0;
+                    f64 odd1 = 0.0;
+                    f64 odd2 = 0.0;
+                    for (uint k = 0; 2 * k < n; ++k)
+                    {
+                        const Complex a = z[k];
+                        const Complex b = std::conj(z[(n - k) % n]);
+                        const Complex y1 = 0.5 * (a + b);
+                        const Complex y2 = Complex(0.0, -0.5) * (a - b);
+                        if (k == 0)
+                        {
+                            odd1 = 0.5 * y1.real();
+                            odd2 = 0.5 * y2.real();
+                        }
+                        else
+                        {
+                            r1[2 * k - 1] = -y1.imag() * scale;
+                            r2[2 * k - 1] = -y2.imag() * scale;
+                            odd1 += y1.real();
+                            odd2 += y2.real();
+                        }
+                        if (2 * k + 1 < n)
+                        {
+                            r1[2 * k] = odd1 * scale;
+                            r2[2 * k] = odd2 * scale;
+                        }
+                    }
+                }
+                else if (!inverse)
+                {
+                    for (uint j = 0; j < nx; ++j)
+                        z[j] = Complex(r1[j], r2[j]);
+                    plan.Forward(z.data(), scratch.data());
+
+                    // Separate the two real spectra and store them as
+                    // half-complex
+                    for (uint k = 0; 2 * k <= nx; ++k)
+                    {
+                        const Complex a = z[k];
+                        const Complex b = std::conj(z[(nx - k) % nx]);
+                        const Complex x1 = 0.5 * (a + b);
+                        const Complex x2 = Complex(0.0, -0.5) * (a - b);
+                        if (k == 0)
+                        {
+                            r1[0] = x1.real();
+                            r2[0] = x2.real();
+                        }
+                        else if (2 * k == nx)
+                        {
+                            r1[nx - 1] = x1.real();
+                            r2[nx - 1] = x2.real();
+                        }
+                        else
+                        {
+                            r1[2 * k - 1] = x1.real();
+                            r1[2 * k] = x1.imag();
+                            r2[2 * k - 1] = x2.real();
+                            r2[2 * k] = x2.imag();
+                        }
+                    }
+                }
+                else
+                {
+                    // Rebuild the full spectra by conjugate symmetry
+                    for (uint k = 0; 2 * k <= nx; ++k)
+                    {
+                        Complex x1;
+                        Complex x2;
+                        if (k == 0)
+                        {
+                            x1 = Complex(r1[0], 0.0);
+                            x2 = Complex(r2[0], 0.0);
+                        }
+                        else if (2 * k == nx)
+                        {
+                            x1 = Complex(r1[nx - 1], 0.0);
+                            x2 = Complex(r2[nx - 1], 0.0);
+                        }
+                        else
+                        {
+                            x1 = Complex(r1[2 * k - 1], r1[2 * k]);
+                            x2 = Complex(r2[2 * k - 1], r2[2 * k]);
+                        }
+                        z[k] = x1 + Complex(0.0, 1.0) * x2;
+                        if (k != 0 && 2 * k != nx)
+                            z[nx - k] = std::conj(x1) + Complex(0.0, 1.0) * std::conj(x2);
+                    }
+                    plan.Inverse(z.data(), scratch.data());
+
+                    const f64 scale = 1.0 / (f64)nx;
+                    for (uint j = 0; j < nx; ++j)
+                    {
+                        r1[j] = z[j].real() * scale;
+                        r2[j] = z[j].imag() * scale;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Solves the 1D periodic Laplacian for the constant mode of a
+    /// singular solver, returning the zero mean solution for the zero
+    /// mean part of the column
+    static
+    void
+    SolveSingularColumn(const RectangleSolver& s, std::vector<f64>* data)
+    {
+        JasUnpack(s, nx, ny);
+        auto& f = *data;
+
+        f64 mean = 0.0;
+        for (uint y = 0; y < ny; ++y)
+            mean += f[y * nx];
+        mean /= (f64)ny;
+
+        // NOTE(Chris): March u_y+1 = 2 u_y - u_y-1 - f_y from u_0 = u_1
+        // = 0, then add the linear term that closes the period
+        std::vector<f64> u(ny + 1, 0.0);
+        for (uint y = 1; y < ny; ++y)
+            u[y + 1] = 2.0 * u[y] - u[y - 1] - (f[y * nx] - mean);
+        const f64 slope = -u[ny] / (f64)ny;
+
+        f64 uMean = 0.0;
+        for (uint y = 0; y < ny; ++y)
+        {
+            u[y] += slope * (f64)y;
+            uMean += u[y];
+        }
+        uMean /= (f64)ny;
+
+        for (uint y = 0; y < ny; ++y)
+            f[y * nx] = u[y] - uMean;
+    }
+
+    /// Solves the tridiagonal system in y of every coefficient
+    static
+    void
+    SolveColumns(const RectangleSolver& s, std::vector<f64>* data)
+    {
+        JasUnpack(s, nx, ny, periodicY, invPivot);
+        JasUnpack(s, cyclicZ, cyclicDenom, lambdaX);
+        auto& f = *data;
+        const uint numBlocks = (nx + ColumnBlock - 1) / ColumnBlock;
+
+#pragma omp parallel for default(none) shared(f, nx, ny, periodicY, invPivot, cyclicZ, cyclicDenom, lambdaX, numBlocks)
+        for (uint block = 0; block < numBlocks; ++block)
+        {
+            const uint start = block * ColumnBlock;
+            const uint end = std::min(nx, start + ColumnBlock);
+
+            for (uint y = 1; y < ny; ++y)
+                for (uint i = start; i < end; ++i)
+                    f[y * nx + i] += f[(y - 1) * nx + i] * invPivot[(y - 1) * nx + i];
+
+            for (uint i = start; i < end; ++i)
+                f[(ny - 1) * nx + i] *= invPivot[(ny - 1) * nx + i];
+
+            for (int y = ny - 2; y >= 0; --y)
+                for (uint i = start; i < end; ++i)
+                    f[y * nx + i] = (f[y * nx + i] + f[(y + 1) * nx + i]) * invPivot[y * nx + i];
+
+            if (periodicY)
+            {
+                for (uint i = start; i < end; ++i)
+                {
+                    const f64 d = 2.0 + lambdaX[i];
+                    const f64 fact = (f[i] + f[(ny - 1) * nx + i] / d) / cyclicDenom[i];
+                    for (uint y = 0; y < ny; ++y)
+                        f[y * nx + i] -= fact * cyclicZ[y * nx + i];
+                }
+            }
+        }
+    }
+
+    /// Solves A u = f in place. If the solver is singular, the zero
+    /// mean solution for the zero mean part of f is returned
+    static
+    void
+    SolveRectangle(const RectangleSolver& s, std::vector<f64>* f)
+    {
+        TransformRows(s, f, false);
+
+        if (s.Singular())
+        {
+            // NOTE(Chris): Column 0 is the constant mode in x, its
+            // cyclic system is singular
+            std::vector<f64> constantMode(s.ny);
+            for (uint y = 0; y < s.ny; ++y)
+                constantMode[y] = (*f)[y * s.nx];
+            SolveColumns(s, f);
+            for (uint y = 0; y < s.ny; ++y)
+                (*f)[y * s.nx] = constantMode[y];
+            SolveSingularColumn(s, f);
+        }
+        else
+        {
+            SolveColumns(s, f);
+        }
+
+        TransformRows(s, f, true);
+    }
+
+    bool
+    FastPoissonSolver(Grid* grid, const f64 zeroTol, const u64 maxIter, bool parallel)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        JasUnpack((*grid), voltages, lineLength, numLines, horizZip, verticZip);
+        const auto& fixed = graph.fixed;
+
+        const uint numWorkChunks = (voltages.size() / 20000 > 0) ? (voltages.size() / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        // NOTE(Chris): The rectangle we solve on is the whole grid in a
+        // zipped direction, and the grid without its (fixed) outer
+        // rows/columns otherwise, these then act as the boundary values
+        const uint x0 = verticZip ? 0 : 1;
+        const uint y0 = horizZip ? 0 : 1;
+        const uint nx = verticZip ? lineLength : lineLength - 2;
+        const uint ny = horizZip ? numLines : numLines - 2;
+        const uint numBase = nx * ny;
+
+        RectangleSolver solver(nx, ny, verticZip, horizZip);
+        PrepareRectangleSolver(&solver);
+
+        // Boundary values move to the rhs of the cells next to them
+        std::vector<f64> solution(numBase, 0.0);
+        if (!verticZip)
+        {
+            for (uint by = 0; by < ny; ++by)
+            {
+                solution[by * nx] += voltages[(y0 + by) * lineLength];
+                solution[by * nx + nx - 1] += voltages[(y0 + by) * lineLength + lineLength - 1];
+            }
+        }
+        if (!horizZip)
+        {
+            for (uint bx = 0; bx < nx; ++bx)
+            {
+                solution[bx] += voltages[x0 + bx];
+                solution[(ny - 1) * nx + bx] += voltages[(numLines - 1) * lineLength + x0 + bx];
+            }
+        }
+
+        // NOTE(Chris): Only the fixed cells that touch a non-fixed cell
+        // need to hold their value, the ones surrounded by other fixed
+        // cells never enter the equations of the unknowns, so can be
+        // left free in the rectangle
+        std::vector<uint> charges;
+        std::vector<f64> chargeVoltage;
+        for (uint by = 0; by < ny; ++by)
+            for (uint bx = 0; bx < nx; ++bx)
+            {
+                const uint x = x0 + bx;
+                const uint y = y0 + by;
+                const uint index = y * lineLength + x;
+                if (!fixed[index])
+                    continue;
+
+                const auto n = Laplacian::WrappedNeighbours(x, y, lineLength, numLines);
+                if (!fixed[n[0]] || !fixed[n[1]] || !fixed[n[2]] || !fixed[n[3]])
+                {
+                    charges.push_back(by * nx + bx);
+                    chargeVoltage.push_back(voltages[index]);
+                }
+            }
+        const uint numCharges = charges.size();
+
+        LOG("Fast Poisson on %u x %u (%s in x, %s in y), %u capacitance points, num threads %u",
+            nx, ny, verticZip ? "periodic" : "fixed", horizZip ? "periodic" : "fixed",
+            numCharges, parallel ? numThreads : 1);
+
+        SolveRectangle(solver, &solution);
+
+        // NOTE(Chris): u = u_b + G P^T sigma, where G is the rectangle
+        // solve, P picks out the capacitance points and sigma is the
+        // charge placed on them. Requiring P u = g gives the
+        // capacitance system C sigma = g - P u_b with C = P G P^T, which
+        // is SPD so CG applies. We never need sigma itself, only the
+        // change in u that each search direction produces. For the
+        // singular (doubly periodic) case u also has a free constant,
+        // and the charges must sum to 0, so the residuals are kept
+        // zero mean and the constant is fitted at the end
+        const bool singular = solver.Singular();
+        const auto RemoveMean = [singular] (std::vector<f64>* v)
+            {
+                if (!singular || v->empty())
+                    return;
+                f64 mean = 0.0;
+                for (const auto x : *v)
+                    mean += x;
+                mean /= (f64)v->size();
+                for (auto& x : *v)
+                    x -= mean;
+            };
+        const auto DotCharges = [] (const std::vector<f64>& a, const std::vector<f64>& b) -> f64
+            {
+                f64 result = 0.0;
+                for (uint i = 0; i < a.size(); ++i)
+                    result += a[i] * b[i];
+                return result;
+            };
+
+        std::vector<f64> residual(numCharges);
+        for (uint i = 0; i < numCharges; ++i)
+            residual[i] = chargeVoltage[i] - solution[charges[i]];
+        RemoveMean(&residual);
+
+        // NOTE(Chris): With no capacitance points to correct the
+        // rectangle solve is already the solution
+        bool converged = true;
+        const f64 rhsNorm = std::sqrt(DotCharges(residual, residual));
+        if (numCharges > 0 && rhsNorm > 0.0)
+        {
+            std::vector<f64> search(residual);
+            std::vector<f64> product(numCharges);
+            std::vector<f64> field(numBase);
+            f64 rDotR = Square(rhsNorm);
+
+            u64 iter = 1;
+            for (; iter <= maxIter; ++iter)
+            {
+                std::fill(field.begin(), field.end(), 0.0);
+                for (uint i = 0; i < numCharges; ++i)
+                    field[charges[i]] = search[i];
+                SolveRectangle(solver, &field);
+
+                for (uint i = 0; i < numCharges; ++i)
+                    product[i] = field[charges[i]];
+                RemoveMean(&product);
+
+                const f64 alpha = rDotR / DotCharges(search, product);
+
+#pragma omp parallel for default(none) shared(solution, field, alpha, numBase)
+                for (uint b = 0; b < numBase; ++b)
+                    solution[b] += alpha * field[b];
+
+                for (uint i = 0; i < numCharges; ++i)
+                    residual[i] -= alpha * product[i];
+
+                const f64 newRDotR = DotCharges(residual, residual);
+                if (std::sqrt(newRDotR) < zeroTol * rhsNorm)
+                {
+                    rDotR = newRDotR;
+                    break;
+                }
+
+                const f64 beta = newRDotR / rDotR;
+                rDotR = newRDotR;
+                for (uint i = 0; i < numCharges; ++i)
+                    search[i] = residual[i] + beta * search[i];
+            }
+
+            converged = (iter <= maxIter);
+            if (!converged)
+            {
+                LOG("Overran max iteration counter (%u), relative residual %e",
+                    (unsigned)maxIter, std::sqrt(rDotR) / rhsNorm);
+            }
+            else
+            {
+                LOG("Performed %u iterations, relative residual %e",
+                    (unsigned)iter, std::sqrt(rDotR) / rhsNorm);
+            }
+        }
+
+        if (singular)
+        {
+            f64 offset = 0.0;
+            for (uint i = 0; i < numCharges; ++i)
+                offset += chargeVoltage[i] - solution[charges[i]];
+            offset /= (f64)std::max(numCharges, 1u);
+            for (auto& u : solution)
+                u += offset;
+        }
+
+        for (uint by = 0; by < ny; ++by)
+            for (uint bx = 0; bx < nx; ++bx)
+            {
+                const uint index = (y0 + by) * lineLength + x0 + bx;
+                if (!fixed[index])
+                {
+                    voltages[index] = solution[by * nx + bx];
+                }
+            }
+
+        return converged;
+    }
+}
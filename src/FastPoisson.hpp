@@ -0,0 +1,30 @@
+// -*- c++ -*-
+#if !defined(FASTPOISSON_H)
+/* ==========================================================================
+   $File: FastPoisson.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define FASTPOISSON_H
+
+#include "GlobalDefines.hpp"
+
+class Grid;
+
+namespace FastPoisson
+{
+    /// Solves the Grid with a fast Poisson solver on the whole
+    /// rectangle (sine transforms in a fixed direction, Fourier
+    /// transforms in a zipped one), enforcing the fixed points inside
+    /// the rectangle with a capacitance matrix method. The capacitance
+    /// system is solved by conjugate gradients, each iteration costing
+    /// one fast solve. Stops when the 2-norm of the error in the fixed
+    /// points relative to its initial value drops below zeroTol, or
+    /// after maxIter iterations. Returns true if it converged
+    bool
+    FastPoissonSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                      bool parallel = true);
+}
+#endif
@@ -0,0 +1,120 @@
+/* ==========================================================================
+   $File: FieldFile.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "FieldFile.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace FieldFile
+{
+    bool
+    WriteField(const Grid& grid, const char* path)
+    {
+        JasUnpack(grid, voltages, lineLength, numLines, horizZip, verticZip);
+
+        FILE* out = fopen(path, "wb");
+        if (!out)
+        {
+            LOG("Unable to open %s to write field", path);
+            return false;
+        }
+
+        Header header;
+        memset(&header, 0, sizeof(header));
+        std::copy(FieldMagic, FieldMagic + sizeof(FieldMagic), header.magic);
+        header.lineLength = lineLength;
+        header.numLines = numLines;
+        header.horizZip = (u8)horizZip;
+        header.verticZip = (u8)verticZip;
+
+        const bool ok = fwrite(&header, sizeof(header), 1, out) == 1
+            && fwrite(voltages.data(), sizeof(f64), voltages.size(), out) == voltages.size();
+        fclose(out);
+
+        if (!ok)
+        {
+            LOG("Failed to write field to %s", path);
+            remove(path);
+        }
+        return ok;
+    }
+
+    Jasnah::Option<Field>
+    ReadField(const char* path)
+    {
+        FILE* in = fopen(path, "rb");
+        if (!in)
+        {
+            LOG("Unable to open field file %s", path);
+            return Jasnah::None;
+        }
+
+        Header header;
+        if (fread(&header, sizeof(header), 1, in) != 1
+            || !std::equal(header.magic, header.magic + sizeof(header.magic), FieldMagic))
+        {
+            LOG("%s is not a field file", path);
+            fclose(in);
+            return Jasnah::None;
+        }
+
+        // NOTE(Chris): Check the header against the size of the file
+        // before allocating, as a corrupt header could ask for
+        // anything. The division avoids overflowing on a huge one
+        const u64 numCells = (u64)header.lineLength * header.numLines;
+        struct stat info;
+        if (fstat(fileno(in), &info) != 0 || (u64)info.st_size < sizeof(header)
+            || ((u64)info.st_size - sizeof(header)) % sizeof(f64) != 0
+            || ((u64)info.st_size - sizeof(header)) / sizeof(f64) != numCells)
+        {
+            LOG("Field file %s doesn't match its header", path);
+            fclose(in);
+            return Jasnah::None;
+        }
+
+        Jasnah::Option<Field> field(Jasnah::ConstructInPlace);
+        field->lineLength = header.lineLength;
+        field->numLines = header.numLines;
+        field->horizZip = header.horizZip;
+        field->verticZip = header.verticZip;
+        field->voltages.resize(numCells);
+
+        const bool ok = fread(field->voltages.data(), sizeof(f64), field->voltages.size(), in)
+            == field->voltages.size();
+        fclose(in);
+
+        if (!ok || field->voltages.empty())
+        {
+            LOG("Field file %s is truncated", path);
+            return Jasnah::None;
+        }
+        return field;
+    }
+
+    bool
+    WarmStart(const char* path, Grid* grid)
+    {
+        auto field = ReadField(path);
+        if (!field)
+            return false;
+
+        if (field->horizZip != grid->horizZip || field->verticZip != grid->verticZip)
+        {
+            LOG("Warm start field %s was solved with different zips", path);
+        }
+
+        // NOTE(Chris): At the same resolution the bilinear resample
+        // samples exactly on the source pixels, so this is a copy
+        grid->ResampleVoltages(field->voltages, field->lineLength, field->numLines);
+        LOG("Warm starting from %s (%u x %u)", path, field->lineLength, field->numLines);
+        return true;
+    }
+}
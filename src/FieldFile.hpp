@@ -0,0 +1,65 @@
+// -*- c++ -*-
+#if !defined(FIELDFILE_H)
+/* ==========================================================================
+   $File: FieldFile.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define FIELDFILE_H
+// Binary files holding a solved voltage field, so that a solution can
+// be reused as the starting point of another solve
+
+#include "GlobalDefines.hpp"
+#include "Jasnah.hpp"
+#include <vector>
+
+class Grid;
+
+namespace FieldFile
+{
+    /// Identifies the field files
+    const char FieldMagic[8] = {'G', 'R', 'I', 'D', 'F', 'L', 'D', '1'};
+
+    /// Start of a field file. The lineLength * numLines voltages follow
+    /// immediately, row by row, as native f64. The header is padded to
+    /// 64 bytes so they are aligned if the file is mapped into memory
+    struct Header
+    {
+        char magic[8];
+        u32 lineLength;
+        u32 numLines;
+        u8 horizZip;
+        u8 verticZip;
+        u8 padding[46];
+    };
+    static_assert(sizeof(Header) == 64, "FieldFile::Header must be 64 bytes");
+
+    /// A voltage field read from a file
+    struct Field
+    {
+        uint lineLength;
+        uint numLines;
+        bool horizZip;
+        bool verticZip;
+        std::vector<f64> voltages;
+    };
+
+    /// Writes the grid's voltages to path, returns true on success
+    bool
+    WriteField(const Grid& grid, const char* path);
+
+    /// Reads a field written by WriteField, returns None (after
+    /// logging the problem) if the file is missing or malformed
+    Jasnah::Option<Field>
+    ReadField(const char* path);
+
+    /// Replaces the grid's voltages with the field saved at path,
+    /// resampled bilinearly if it was solved at another resolution,
+    /// with the grid's fixed points reapplied on top. Returns false
+    /// and leaves the grid alone if the file can't be read
+    bool
+    WarmStart(const char* path, Grid* grid);
+}
+#endif
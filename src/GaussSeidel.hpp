@@ -9,9 +9,12 @@
 class Grid;
 namespace GaussSeidel
 {
-    // an ammended version of SolveGridLaplacianZero that uses GaussSeidel
-    void
+    // an ammended version of SolveGridLaplacianZero that uses GaussSeidel,
+    // returns true if the solution converged. If anderson is set the
+    // iterate is extrapolated from the last few at each error check
+    // (see Anderson.hpp)
+    bool
     GaussSeidelSolver(Grid* grid, const f64 zeroTol,
-                      const u64 maxIter, bool parallel = true);
+                      const u64 maxIter, bool parallel = true, bool anderson = false);
 }
 #endif
@@ -57,7 +57,10 @@ namespace Version
 {
     constexpr const char* ProgramName = "Gridle";
     constexpr const char* DefaultLog = "Gridle.log";
+    /// Environment variable overriding the path of the default log
+    constexpr const char* LogPathEnv = "GRIDLE_LOG";
     constexpr const char* VersionNumber = "0.0.1";
+    constexpr const char* OmegaCache = "Gridle.omega";
 }
 
 /// Necessary for logging timed functions
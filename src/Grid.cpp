@@ -11,6 +11,7 @@
 #include "Utility.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 
 bool
@@ -265,6 +266,59 @@ Grid::LoadFromImage(const char* imagePath,
     return true;
 }
 
+void
+Grid::ResampleVoltages(const std::vector<f64>& src,
+                       const uint srcLineLength, const uint srcNumLines)
+{
+    if (srcLineLength * srcNumLines != src.size() || src.empty())
+    {
+        LOG("Source field size doesn't match its dimensions, ignoring");
+        return;
+    }
+
+    // NOTE(Chris): Maps the centre of pixel i of a line of length
+    // dest onto the coordinates of a line of length source, and finds
+    // the two samples to interpolate between. Zipped directions wrap
+    // around, the others are clamped to the edge
+    const auto Sample = [](const uint i, const uint dest, const uint source,
+                           const bool wrap, uint* lo, uint* hi, f64* t)
+        {
+            f64 coord = ((f64)i + 0.5) * (f64)source / (f64)dest - 0.5;
+            if (!wrap)
+            {
+                coord = std::min(std::max(coord, 0.0), (f64)(source - 1));
+            }
+            const f64 base = std::floor(coord);
+            *t = coord - base;
+            const int loIdx = (int)base;
+            *lo = (loIdx < 0) ? source - 1 : loIdx;
+            *hi = (loIdx + 1 >= (int)source) ? (wrap ? 0 : source - 1) : loIdx + 1;
+        };
+
+    for (uint y = 0; y < numLines; ++y)
+    {
+        uint y0, y1;
+        f64 ty;
+        Sample(y, numLines, srcNumLines, horizZip, &y0, &y1, &ty);
+
+        for (uint x = 0; x < lineLength; ++x)
+        {
+            uint x0, x1;
+            f64 tx;
+            Sample(x, lineLength, srcLineLength, verticZip, &x0, &x1, &tx);
+
+            const f64 top = (1.0 - tx) * src[y0 * srcLineLength + x0] + tx * src[y0 * srcLineLength + x1];
+            const f64 bottom = (1.0 - tx) * src[y1 * srcLineLength + x0] + tx * src[y1 * srcLineLength + x1];
+            voltages[y * lineLength + x] = (1.0 - ty) * top + ty * bottom;
+        }
+    }
+
+    for (const auto& fp : fixedPoints)
+    {
+        voltages[fp.first] = fp.second;
+    }
+}
+
 /// Sets the two boundary plates for the basic box
 void
 Grid::InitialiseBasicGrid(const f64 plusWall, const f64 minusWall)
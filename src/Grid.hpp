@@ -177,6 +177,14 @@ public:
                   const std::unordered_map<u32, Constraint>& colorMapping,
                   uint scaleFactor = 1);
 
+    /// Fills voltages by bilinear interpolation of src (a field of
+    /// srcLineLength x srcNumLines covering the same domain, sampled
+    /// at pixel centres) and then reapplies the fixed points. Used to
+    /// provide a starting guess from a solution at another scale
+    void
+    ResampleVoltages(const std::vector<f64>& src,
+                     const uint srcLineLength, const uint srcNumLines);
+
     /// Sets the two boundary plates for the basic box
     void
     InitialiseBasicGrid(const f64 plusWall, const f64 minusWall);
@@ -289,6 +289,36 @@ ParseConfig(std::vector<char>* buf, const char* path)
             result.imagePath = iter->value.GetString();
         } break;
 
+        case StringHash("WarmStart"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("WarmStart must be a path (string)");
+                return Jasnah::None;
+            }
+            result.warmStart = std::string(iter->value.GetString());
+        } break;
+
+        case StringHash("SaveField"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("SaveField must be a path (string)");
+                return Jasnah::None;
+            }
+            result.saveField = std::string(iter->value.GetString());
+        } break;
+
+        case StringHash("CacheDirectory"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("CacheDirectory must be a path (string)");
+                return Jasnah::None;
+            }
+            result.cacheDirectory = std::string(iter->value.GetString());
+        } break;
+
         case StringHash("ScaleFactor"):
         {
             if (!iter->value.IsUint())
@@ -385,6 +415,207 @@ ParseConfig(std::vector<char>* buf, const char* path)
             result.verticZip = iter->value.GetBool();
         } break;
 
+        case StringHash("Preconditioner"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("Preconditioner must be a string");
+                return Jasnah::None;
+            }
+
+            switch (StringHash(iter->value.GetString()))
+            {
+            case StringHash("None"):
+            {
+                result.preconditioner = Cfg::Preconditioner::None;
+            } break;
+
+            case StringHash("SSOR"):
+            {
+                result.preconditioner = Cfg::Preconditioner::SSOR;
+            } break;
+
+            case StringHash("IC0"):
+            {
+                result.preconditioner = Cfg::Preconditioner::IncompleteCholesky;
+            } break;
+
+            case StringHash("RedBlack"):
+            {
+                result.preconditioner = Cfg::Preconditioner::RedBlack;
+            } break;
+
+            case StringHash("AMG"):
+            {
+                result.preconditioner = Cfg::Preconditioner::AlgebraicMultigrid;
+            } break;
+
+            default:
+            {
+                LOG("Unknown Preconditioner, using default");
+            }
+            }
+        } break;
+
+        case StringHash("Convergence"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("Convergence must be a string");
+                return Jasnah::None;
+            }
+
+            switch (StringHash(iter->value.GetString()))
+            {
+            case StringHash("RelativeChange"):
+            {
+                result.convergence = Cfg::ConvergenceCriterion::RelativeChange;
+            } break;
+
+            case StringHash("ResidualL2"):
+            {
+                result.convergence = Cfg::ConvergenceCriterion::ResidualL2;
+            } break;
+
+            case StringHash("ResidualLinf"):
+            {
+                result.convergence = Cfg::ConvergenceCriterion::ResidualLinf;
+            } break;
+
+            default:
+            {
+                LOG("Unknown Convergence criterion, using default");
+            }
+            }
+        } break;
+
+        case StringHash("Stencil"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("Stencil must be a string");
+                return Jasnah::None;
+            }
+
+            switch (StringHash(iter->value.GetString()))
+            {
+            case StringHash("FivePoint"):
+            {
+                result.stencil = Cfg::StencilType::FivePoint;
+            } break;
+
+            case StringHash("NinePoint"):
+            {
+                result.stencil = Cfg::StencilType::NinePoint;
+            } break;
+
+            default:
+            {
+                LOG("Unknown Stencil, using default");
+            }
+            }
+        } break;
+
+        case StringHash("CompareStencils"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("CompareStencils member must be a bool type");
+                return Jasnah::None;
+            }
+            result.compareStencils = iter->value.GetBool();
+        } break;
+
+        case StringHash("ScaleResidualByBoundary"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("ScaleResidualByBoundary member must be a bool type");
+                return Jasnah::None;
+            }
+            result.scaleResidual = iter->value.GetBool();
+        } break;
+
+        case StringHash("CacheFactorisation"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("CacheFactorisation member must be a bool type");
+                return Jasnah::None;
+            }
+            result.cacheFactorisation = iter->value.GetBool();
+        } break;
+
+        case StringHash("ChebyshevAcceleration"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("ChebyshevAcceleration member must be a bool type");
+                return Jasnah::None;
+            }
+            result.chebyshev = iter->value.GetBool();
+        } break;
+
+        case StringHash("AndersonAcceleration"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("AndersonAcceleration member must be a bool type");
+                return Jasnah::None;
+            }
+            result.anderson = iter->value.GetBool();
+        } break;
+
+        case StringHash("TiledSweep"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("TiledSweep member must be a bool type");
+                return Jasnah::None;
+            }
+            result.tiledSweep = iter->value.GetBool();
+        } break;
+
+        case StringHash("TileWidth"):
+        {
+            if (!iter->value.IsUint() || iter->value.GetUint() == 0)
+            {
+                LOG("TileWidth must be a positive integer");
+                return Jasnah::None;
+            }
+            result.tileWidth = iter->value.GetUint();
+        } break;
+
+        case StringHash("TemporalBlocking"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("TemporalBlocking member must be a bool type");
+                return Jasnah::None;
+            }
+            result.temporalBlocking = iter->value.GetBool();
+        } break;
+
+        case StringHash("NumProcesses"):
+        {
+            if (!iter->value.IsUint() || iter->value.GetUint() == 0)
+            {
+                LOG("NumProcesses must be a positive integer");
+                return Jasnah::None;
+            }
+            result.numProcesses = iter->value.GetUint();
+        } break;
+
+        case StringHash("NestedIteration"):
+        {
+            if (!iter->value.IsBool())
+            {
+                LOG("NestedIteration member must be a bool type");
+                return Jasnah::None;
+            }
+            result.nestedIteration = iter->value.GetBool();
+        } break;
+
         case StringHash("AnalyticInnerRadius"):
         {
             if (!iter->value.IsNumber())
@@ -445,6 +676,46 @@ ParseConfig(std::vector<char>* buf, const char* path)
                 result.mode = Cfg::CalculationMode::RedBlack;
             } break;
 
+            case StringHash("Multigrid"):
+            {
+                result.mode = Cfg::CalculationMode::Multigrid;
+            } break;
+
+            case StringHash("CG"):
+            {
+                result.mode = Cfg::CalculationMode::ConjugateGradient;
+            } break;
+
+            case StringHash("SOR"):
+            {
+                result.mode = Cfg::CalculationMode::SOR;
+            } break;
+
+            case StringHash("FastPoisson"):
+            {
+                result.mode = Cfg::CalculationMode::FastPoisson;
+            } break;
+
+            case StringHash("AMG"):
+            {
+                result.mode = Cfg::CalculationMode::AlgebraicMultigrid;
+            } break;
+
+            case StringHash("Schwarz"):
+            {
+                result.mode = Cfg::CalculationMode::Schwarz;
+            } break;
+
+            case StringHash("MultiProcess"):
+            {
+                result.mode = Cfg::CalculationMode::MultiProcess;
+            } break;
+
+            case StringHash("MixedPrecision"):
+            {
+                result.mode = Cfg::CalculationMode::MixedPrecision;
+            } break;
+
             default:
             {
                 LOG("Unknown CalculationMode, using default");
@@ -452,6 +723,33 @@ ParseConfig(std::vector<char>* buf, const char* path)
             }
         } break;
 
+        case StringHash("MultigridCycle"):
+        {
+            if (!iter->value.IsString())
+            {
+                LOG("MultigridCycle must be a string (\"V\" or \"W\")");
+                return Jasnah::None;
+            }
+
+            switch (StringHash(iter->value.GetString()))
+            {
+            case StringHash("V"):
+            {
+                result.mgCycle = Cfg::MultigridCycle::V;
+            } break;
+
+            case StringHash("W"):
+            {
+                result.mgCycle = Cfg::MultigridCycle::W;
+            } break;
+
+            default:
+            {
+                LOG("Unknown MultigridCycle, using default");
+            }
+            }
+        } break;
+
         default:
             LOG("Unknown key \"%s\", ignoring", iter->name.GetString());
         }
@@ -23,6 +23,50 @@ namespace Cfg
         MatrixInversion,
         RedBlack,
         GaussSeidel,
+        Multigrid,
+        ConjugateGradient,
+        SOR,
+        FastPoisson,
+        AlgebraicMultigrid,
+        Schwarz,
+        MultiProcess,
+        MixedPrecision,
+    };
+
+    /// Shape of the multigrid cycle, i.e. how many times each coarse
+    /// level is visited per visit to the level above
+    enum class MultigridCycle
+    {
+        V,
+        W
+    };
+
+    /// Preconditioner for the Krylov solvers
+    enum class Preconditioner
+    {
+        None,
+        SSOR,
+        IncompleteCholesky,
+        RedBlack,
+        AlgebraicMultigrid
+    };
+
+    /// Quantity the relaxation solvers compare with ZeroTol to decide
+    /// they have converged
+    enum class ConvergenceCriterion
+    {
+        RelativeChange,
+        ResidualL2,
+        ResidualLinf
+    };
+
+    /// Discretisation of the Laplacian used by the solvers
+    enum class StencilType
+    {
+        /// The usual second order 5-point stencil
+        FivePoint,
+        /// The compact fourth order 9-point (Mehrstellen) stencil
+        NinePoint
     };
 
     /// Mode the program is operating. The entire program is
@@ -33,7 +77,8 @@ namespace Cfg
         CompareProblem0,
         CompareProblem1,
         CompareTwo,
-        Preprocess
+        Preprocess,
+        Superposition
     };
 
     /// Holds the data parsed from a JSON config file, much of it is
@@ -53,6 +98,23 @@ namespace Cfg
         Jasnah::Option<f64> analyticOuter;
         Jasnah::Option<f64> analyticVoltage;
         Jasnah::Option<CalculationMode> mode;
+        Jasnah::Option<MultigridCycle> mgCycle;
+        Jasnah::Option<bool> nestedIteration;
+        Jasnah::Option<Preconditioner> preconditioner;
+        Jasnah::Option<bool> cacheFactorisation;
+        Jasnah::Option<bool> chebyshev;
+        Jasnah::Option<uint> numProcesses;
+        Jasnah::Option<bool> temporalBlocking;
+        Jasnah::Option<bool> tiledSweep;
+        Jasnah::Option<uint> tileWidth;
+        Jasnah::Option<ConvergenceCriterion> convergence;
+        Jasnah::Option<bool> scaleResidual;
+        Jasnah::Option<StencilType> stencil;
+        Jasnah::Option<bool> compareStencils;
+        Jasnah::Option<bool> anderson;
+        Jasnah::Option<std::string> warmStart;
+        Jasnah::Option<std::string> saveField;
+        Jasnah::Option<std::string> cacheDirectory;
     };
 
     /// This is the data we output when asked to preprocess an image
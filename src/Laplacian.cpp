@@ -0,0 +1,291 @@
+/* ==========================================================================
+   $File: Laplacian.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Laplacian.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+namespace Laplacian
+{
+    static Cfg::StencilType Selected = Cfg::StencilType::FivePoint;
+
+    void
+    SelectStencil(const Cfg::StencilType stencil)
+    {
+        Selected = stencil;
+    }
+
+    Cfg::StencilType
+    ActiveStencil()
+    {
+        return Selected;
+    }
+
+    const char*
+    StencilName(const Cfg::StencilType stencil)
+    {
+        switch (stencil)
+        {
+        case Cfg::StencilType::FivePoint:
+            return "5-point";
+        case Cfg::StencilType::NinePoint:
+            return "9-point";
+        }
+        return "unknown";
+    }
+
+    ZipDefinitionProblem
+    CheckGridZips(const Grid& grid)
+    {
+        JasUnpack(grid, verticZip, horizZip, numLines, lineLength, fixedPoints);
+
+        if (!horizZip || !verticZip)
+        {
+            if (fixedPoints.count(0) == 0
+                || fixedPoints.count(lineLength - 1) == 0
+                || fixedPoints.count((numLines - 1) * lineLength) == 0
+                || fixedPoints.count((numLines - 1) * lineLength + lineLength - 1) == 0)
+            {
+                LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
+                return ZipDefinitionProblem::Both;
+            }
+        }
+
+        if (!verticZip)
+        {
+            // Check first and final column for empty pixels (corners require more specific check)
+            for (uint y = 1; y < numLines - 1; ++y)
+            {
+                if (fixedPoints.count(y * lineLength) == 0
+                    || fixedPoints.count(y * lineLength + lineLength - 1) == 0)
+                {
+                    LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
+                    return ZipDefinitionProblem::Vertical;
+                }
+            }
+        }
+
+        if (!horizZip)
+        {
+            // Check first and final row for empty pixels (corners require more specific check)
+            for (uint x = 1; x < lineLength - 1; ++x)
+            {
+                if (fixedPoints.count(x) == 0
+                    || fixedPoints.count((numLines - 1) * lineLength + x) == 0)
+                {
+                    LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
+                    return ZipDefinitionProblem::Horizontal;
+                }
+            }
+        }
+        return ZipDefinitionProblem::None;
+    }
+
+    Neighbours
+    WrappedNeighbours(const uint x, const uint y,
+                      const uint lineLength, const uint numLines)
+    {
+        const uint left = (x == 0) ? lineLength - 1 : x - 1;
+        const uint right = (x + 1 >= lineLength) ? 0 : x + 1;
+        const uint up = (y == 0) ? numLines - 1 : y - 1;
+        const uint down = (y + 1 >= numLines) ? 0 : y + 1;
+
+        return Neighbours{{ y * lineLength + left,
+                            y * lineLength + right,
+                            up * lineLength + x,
+                            down * lineLength + x }};
+    }
+
+    Neighbours
+    WrappedDiagonals(const uint x, const uint y,
+                     const uint lineLength, const uint numLines)
+    {
+        const uint left = (x == 0) ? lineLength - 1 : x - 1;
+        const uint right = (x + 1 >= lineLength) ? 0 : x + 1;
+        const uint up = (y == 0) ? numLines - 1 : y - 1;
+        const uint down = (y + 1 >= numLines) ? 0 : y + 1;
+
+        return Neighbours{{ up * lineLength + left,
+                            up * lineLength + right,
+                            down * lineLength + left,
+                            down * lineLength + right }};
+    }
+
+    bool
+    BuildCellGraph(const Grid& grid, CellGraph* graph)
+    {
+        JasUnpack(grid, lineLength, numLines, fixedPoints);
+
+        if (lineLength < 3 || numLines < 3)
+        {
+            LOG("Grid too small to solve (%u x %u)", lineLength, numLines);
+            return false;
+        }
+
+        switch (CheckGridZips(grid))
+        {
+        case ZipDefinitionProblem::Both:
+        {
+            LOG("Check both zip definitions");
+            return false;
+        } break;
+
+        case ZipDefinitionProblem::Horizontal:
+        {
+            LOG("Check horizontal zip definition");
+            return false;
+        } break;
+
+        case ZipDefinitionProblem::Vertical:
+        {
+            LOG("Check vertical zip definition");
+            return false;
+        } break;
+
+        default:
+        {
+        } break;
+        }
+
+        graph->lineLength = lineLength;
+        graph->numLines = numLines;
+
+        // NOTE(Chris): A flat mask is much cheaper to query than the
+        // hash map for every cell
+        graph->fixed.assign(lineLength * numLines, 0);
+        for (const auto& fp : fixedPoints)
+        {
+            graph->fixed[fp.first] = 1;
+        }
+        const auto& fixed = graph->fixed;
+
+        graph->interior.clear();
+        graph->interior.reserve(lineLength * numLines);
+        for (uint y = 1; y < numLines - 1; ++y)
+            for (uint x = 1; x < lineLength - 1; ++x)
+            {
+                if (!fixed[y * lineLength + x])
+                {
+                    graph->interior.push_back(y * lineLength + x);
+                }
+            }
+
+        // NOTE(Chris): Any edge cell that is not fixed must be zipped
+        // (CheckGridZips has verified this), so walk the edge in
+        // index order and wrap its neighbours
+        graph->edge.clear();
+        graph->edgeNeighbours.clear();
+        graph->edgeDiagonals.clear();
+        for (uint y = 0; y < numLines; ++y)
+        {
+            const bool edgeRow = (y == 0 || y == numLines - 1);
+            for (uint x = 0; x < lineLength; x += (edgeRow ? 1 : lineLength - 1))
+            {
+                const uint index = y * lineLength + x;
+                if (!fixed[index])
+                {
+                    graph->edge.push_back(index);
+                    graph->edgeNeighbours.push_back(WrappedNeighbours(x, y, lineLength, numLines));
+                    graph->edgeDiagonals.push_back(WrappedDiagonals(x, y, lineLength, numLines));
+                }
+            }
+        }
+
+        return true;
+    }
+
+    u64
+    GeometryKey(const Grid& grid, const CellGraph& graph)
+    {
+        const u32 dims[2] = { graph.lineLength, graph.numLines };
+        const u8 zips[2] = { (u8)grid.horizZip, (u8)grid.verticZip };
+        u64 key = Hash64(dims, sizeof(dims));
+        key = Hash64(zips, sizeof(zips), key);
+        return Hash64(graph.fixed.data(), graph.fixed.size(), key);
+    }
+
+    void
+    ApplyLaplacian(const CellGraph& graph, const std::vector<f64>& in,
+                   std::vector<f64>* o, const Cfg::StencilType stencil)
+    {
+        JasUnpack(graph, lineLength, interior, edge, edgeNeighbours, edgeDiagonals);
+        auto& out = *o;
+
+        if (stencil == Cfg::StencilType::NinePoint)
+        {
+            // NOTE(Chris): -6h^2 lap(phi) = 20 phi - 4 (edge neighbours)
+            // - (diagonal neighbours), divided through by 5
+#pragma omp parallel for default(none) shared(interior, in, out, lineLength)
+            for (auto c = interior.begin(); c < interior.end(); ++c)
+            {
+                out[*c] = 4.0 * in[*c]
+                    - 0.2 * (4.0 * (in[*c + 1] + in[*c - 1] + in[*c - lineLength] + in[*c + lineLength])
+                             + in[*c - lineLength - 1] + in[*c - lineLength + 1]
+                             + in[*c + lineLength - 1] + in[*c + lineLength + 1]);
+            }
+
+            for (uint e = 0; e < edge.size(); ++e)
+            {
+                const auto& n = edgeNeighbours[e];
+                const auto& d = edgeDiagonals[e];
+                out[edge[e]] = 4.0 * in[edge[e]]
+                    - 0.2 * (4.0 * (in[n[0]] + in[n[1]] + in[n[2]] + in[n[3]])
+                             + in[d[0]] + in[d[1]] + in[d[2]] + in[d[3]]);
+            }
+            return;
+        }
+
+#pragma omp parallel for default(none) shared(interior, in, out, lineLength)
+        for (auto c = interior.begin(); c < interior.end(); ++c)
+        {
+            out[*c] = 4.0 * in[*c] - in[*c + 1] - in[*c - 1]
+                - in[*c - lineLength] - in[*c + lineLength];
+        }
+
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const auto& n = edgeNeighbours[e];
+            out[edge[e]] = 4.0 * in[edge[e]] - in[n[0]] - in[n[1]] - in[n[2]] - in[n[3]];
+        }
+    }
+
+    f64
+    Dot(const std::vector<uint>& cells, const std::vector<f64>& a,
+        const std::vector<f64>& b)
+    {
+        f64 result = 0.0;
+#pragma omp parallel for default(none) shared(cells, a, b) reduction(+:result)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            result += a[*c] * b[*c];
+        }
+        return result;
+    }
+
+    void
+    SplitRedBlack(const std::vector<uint>& cells, const uint lineLength,
+                  std::vector<uint>* red, std::vector<uint>* black)
+    {
+        red->clear();
+        black->clear();
+        red->reserve(cells.size() / 2 + 1);
+        black->reserve(cells.size() / 2 + 1);
+
+        for (const auto c : cells)
+        {
+            const uint x = c % lineLength;
+            const uint y = c / lineLength;
+            if ((x + y) % 2 == 0)
+            {
+                red->push_back(c);
+            }
+            else
+            {
+                black->push_back(c);
+            }
+        }
+    }
+}
@@ -0,0 +1,130 @@
+// -*- c++ -*-
+#if !defined(LAPLACIAN_H)
+/* ==========================================================================
+   $File: Laplacian.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define LAPLACIAN_H
+// Shared description of the discrete Laplace problem on a Grid, used
+// by the solvers that need more than a simple sweep over the cells
+
+#include "GlobalDefines.hpp"
+#include "JSON.hpp"
+#include <array>
+#include <vector>
+
+class Grid;
+
+namespace Laplacian
+{
+    /// Types of possible problems with Zip definition
+    enum class ZipDefinitionProblem
+    {
+        Horizontal,
+        Vertical,
+        Both,
+        None
+    };
+
+    /// Checks the validity of the grid WRT the zip settings and
+    /// returns the problem with it (if there is one)
+    ZipDefinitionProblem
+    CheckGridZips(const Grid& grid);
+
+    /// Selects the stencil used by every subsequent solve that
+    /// supports a choice. The default is Cfg::StencilType::FivePoint
+    void
+    SelectStencil(const Cfg::StencilType stencil);
+
+    /// The stencil in use
+    Cfg::StencilType
+    ActiveStencil();
+
+    /// Human readable name of a stencil, for logging
+    const char*
+    StencilName(const Cfg::StencilType stencil);
+
+    /// Neighbour indices of a cell in the order left, right, up,
+    /// down, or for the diagonal neighbours up-left, up-right,
+    /// down-left, down-right
+    typedef std::array<uint, 4> Neighbours;
+
+    /// Returns the indices of the 4 neighbours of (x, y), wrapping
+    /// around the edges of the grid. Only meaningful for cells whose
+    /// edge is zipped
+    Neighbours
+    WrappedNeighbours(const uint x, const uint y,
+                      const uint lineLength, const uint numLines);
+
+    /// As WrappedNeighbours, but for the 4 diagonal neighbours
+    Neighbours
+    WrappedDiagonals(const uint x, const uint y,
+                     const uint lineLength, const uint numLines);
+
+    /// The non-fixed cells of a grid. Interior cells have their
+    /// neighbours at the usual +-1, +-lineLength offsets, whereas the
+    /// edge cells only exist due to zips and have their (wrapped)
+    /// neighbours stored explicitly. The unknowns of the linear
+    /// system are numbered interior first, then edge
+    struct CellGraph
+    {
+        uint lineLength;
+        uint numLines;
+        /// Grid indices of the non-fixed cells away from the edge
+        std::vector<uint> interior;
+        /// Grid indices of the non-fixed (zipped) edge cells
+        std::vector<uint> edge;
+        /// Neighbours of each entry in edge
+        std::vector<Neighbours> edgeNeighbours;
+        /// Diagonal neighbours of each entry in edge, for the 9-point
+        /// stencil
+        std::vector<Neighbours> edgeDiagonals;
+        /// Non-zero for every fixed cell of the grid
+        std::vector<u8> fixed;
+
+        /// Number of unknowns in the system
+        inline uint
+        NumUnknowns() const
+        {
+            return interior.size() + edge.size();
+        }
+    };
+
+    /// Fills graph from the grid. Returns false (after logging the
+    /// problem) if the grid's zips are badly described
+    bool
+    BuildCellGraph(const Grid& grid, CellGraph* graph);
+
+    /// Hash of everything the system matrix depends on: the grid
+    /// size, the zips and the positions of the fixed points, but not
+    /// their values
+    u64
+    GeometryKey(const Grid& grid, const CellGraph& graph);
+
+    /// out = A in on the non-fixed cells, where A is the 5-point
+    /// Laplacian scaled by -h^2 (4 on the diagonal), or the 9-point
+    /// Laplacian scaled by -6h^2/5, which also has 4 on the
+    /// diagonal. Fixed cells of in act as boundary values, so in
+    /// should be 0 on them to apply the matrix of the unknowns
+    /// alone. Fixed cells of out are untouched
+    void
+    ApplyLaplacian(const CellGraph& graph, const std::vector<f64>& in,
+                   std::vector<f64>* out,
+                   const Cfg::StencilType stencil = Cfg::StencilType::FivePoint);
+
+    /// Dot product of a and b over the given cells
+    f64
+    Dot(const std::vector<uint>& cells, const std::vector<f64>& a,
+        const std::vector<f64>& b);
+
+    /// Splits the cells into the two colours of a checkerboard
+    /// ((x + y) even is red), so that no two cells of the same colour
+    /// are neighbours in the grid interior
+    void
+    SplitRedBlack(const std::vector<uint>& cells, const uint lineLength,
+                  std::vector<uint>* red, std::vector<uint>* black);
+}
+#endif
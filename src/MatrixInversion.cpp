@@ -9,100 +9,418 @@
 
 #include "MatrixInversion.hpp"
 #include "Grid.hpp"
+#include "Laplacian.hpp"
 #include "Utility.hpp"
 
 #include "GlobalDefines.hpp"
 
 
-#include <cmath>
-#include <atomic>
 #include <algorithm>
-#include <Eigen/Dense>
+#include <cstdio>
+#include <deque>
+#include <vector>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseLU>
+#include <Eigen/OrderingMethods>
 
 namespace MatrixInversion
 {
+    typedef Eigen::SparseMatrix<f64> SparseMat;
+
+    /// Value used in unknownIndex for the fixed cells
+    const int FixedCell = -1;
+
+    /// A factorisation P A P^T = L D L^T of the system for one
+    /// geometry. The geometry is stored in full so that a hash
+    /// collision on the key can't hand us the wrong factorisation
+    struct Factorisation
+    {
+        u64 key;
+        uint lineLength;
+        uint numLines;
+        bool horizZip;
+        bool verticZip;
+        std::vector<u8> fixed;
+        SparseMat L;
+        Eigen::VectorXd D;
+        Eigen::VectorXi perm;
+    };
+
+    /// Number of factorisations kept in memory, they can be large
+    const uint MaxCachedFactorisations = 2;
+
+    /// Identifies the cache files
+    const char FactorisationMagic[8] = {'G', 'R', 'I', 'D', 'F', 'A', 'C', 'T'};
+
+    /// Factorisations computed during this run (e.g. over a batch of
+    /// configs), most recent last
+    static
+    std::deque<Factorisation>&
+    FactorisationCache()
+    {
+        static std::deque<Factorisation> cache;
+        return cache;
+    }
+
+    static
+    bool
+    FactorisationMatches(const Factorisation& factor, const u64 key,
+                         const Grid& grid, const Laplacian::CellGraph& graph)
+    {
+        return factor.key == key
+            && factor.lineLength == graph.lineLength
+            && factor.numLines == graph.numLines
+            && factor.horizZip == grid.horizZip
+            && factor.verticZip == grid.verticZip
+            && factor.fixed == graph.fixed;
+    }
+
+    /// Writes the factorisation to path, returns true on success
+    static
+    bool
+    WriteFactorisation(const char* path, const Factorisation& factor)
+    {
+        FILE* out = fopen(path, "wb");
+        if (!out)
+        {
+            LOG("Unable to open %s to write factorisation", path);
+            return false;
+        }
+
+        const i32 n = factor.D.size();
+        const i32 nnz = factor.L.nonZeros();
+        const u8 zips[2] = { (u8)factor.horizZip, (u8)factor.verticZip };
+
+        bool ok = fwrite(FactorisationMagic, sizeof(FactorisationMagic), 1, out) == 1
+            && fwrite(&factor.key, sizeof(factor.key), 1, out) == 1
+            && fwrite(&factor.lineLength, sizeof(factor.lineLength), 1, out) == 1
+            && fwrite(&factor.numLines, sizeof(factor.numLines), 1, out) == 1
+            && fwrite(zips, sizeof(zips), 1, out) == 1
+            && fwrite(factor.fixed.data(), 1, factor.fixed.size(), out) == factor.fixed.size()
+            && fwrite(&n, sizeof(n), 1, out) == 1
+            && fwrite(&nnz, sizeof(nnz), 1, out) == 1
+            && fwrite(factor.perm.data(), sizeof(i32), n, out) == (size_t)n
+            && fwrite(factor.D.data(), sizeof(f64), n, out) == (size_t)n
+            && fwrite(factor.L.outerIndexPtr(), sizeof(i32), n + 1, out) == (size_t)n + 1
+            && fwrite(factor.L.innerIndexPtr(), sizeof(i32), nnz, out) == (size_t)nnz
+            && fwrite(factor.L.valuePtr(), sizeof(f64), nnz, out) == (size_t)nnz;
+        fclose(out);
+
+        if (!ok)
+        {
+            LOG("Failed to write factorisation to %s", path);
+            remove(path);
+        }
+        return ok;
+    }
+
+    /// Reads a factorisation written by WriteFactorisation, returns
+    /// false if the file is missing, unreadable, or for a geometry
+    /// with a different key (we stop reading as soon as we know)
+    static
+    bool
+    ReadFactorisation(const char* path, const u64 key, Factorisation* factor)
+    {
+        FILE* in = fopen(path, "rb");
+        if (!in)
+            return false;
+
+        const auto Read = [in] (void* dest, const size_t bytes) -> bool
+            {
+                return fread(dest, 1, bytes, in) == bytes;
+            };
+
+        char magic[sizeof(FactorisationMagic)];
+        u8 zips[2];
+        i32 n = 0;
+        i32 nnz = 0;
+        bool ok = Read(magic, sizeof(magic))
+            && std::equal(magic, magic + sizeof(magic), FactorisationMagic)
+            && Read(&factor->key, sizeof(factor->key));
+
+        if (ok && factor->key != key)
+        {
+            LOG("Factorisation in %s is for a different geometry", path);
+            fclose(in);
+            return false;
+        }
+
+        ok = ok
+            && Read(&factor->lineLength, sizeof(factor->lineLength))
+            && Read(&factor->numLines, sizeof(factor->numLines))
+            && Read(zips, sizeof(zips));
+
+        if (ok)
+        {
+            factor->horizZip = zips[0];
+            factor->verticZip = zips[1];
+            factor->fixed.resize(factor->lineLength * factor->numLines);
+            ok = Read(factor->fixed.data(), factor->fixed.size())
+                && Read(&n, sizeof(n))
+                && Read(&nnz, sizeof(nnz))
+                && n >= 0 && nnz >= 0;
+        }
+
+        if (ok)
+        {
+            factor->perm.resize(n);
+            factor->D.resize(n);
+            factor->L.resize(n, n);
+            factor->L.resizeNonZeros(nnz);
+            ok = Read(factor->perm.data(), n * sizeof(i32))
+                && Read(factor->D.data(), n * sizeof(f64))
+                && Read(factor->L.outerIndexPtr(), (n + 1) * sizeof(i32))
+                && Read(factor->L.innerIndexPtr(), nnz * sizeof(i32))
+                && Read(factor->L.valuePtr(), nnz * sizeof(f64));
+        }
+        fclose(in);
+
+        if (!ok)
+        {
+            LOG("Factorisation file %s is invalid, ignoring", path);
+        }
+        return ok;
+    }
+
+    /// Solves A x = b from the factorisation, in the same way as
+    /// SimplicialLDLT::solve
+    static
+    Eigen::VectorXd
+    SolveFactorised(const Factorisation& factor, const Eigen::VectorXd& b)
+    {
+        const Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> P(factor.perm);
+        Eigen::VectorXd x = P * b;
+        factor.L.triangularView<Eigen::UnitLower>().solveInPlace(x);
+        x = x.cwiseQuotient(factor.D);
+        factor.L.adjoint().triangularView<Eigen::UnitUpper>().solveInPlace(x);
+        return P.inverse() * x;
+    }
+
+    /// Fills unknownIndex with the row of every cell of the grid in
+    /// the system (FixedCell for the fixed ones), interior cells first
+    static
     void
-    MatrixInversionMethod(Grid* grid, const f64 stopPoint , const u64 maxIter)
+    NumberUnknowns(const Laplacian::CellGraph& graph, std::vector<int>* unknownIndex)
     {
-        TIME_FUNCTION();
-        using namespace Eigen;
-        
-        // checking if square matrix if not return nothing
-        if(grid->lineLength != grid->numLines)
-        {
-            return;
-        }
-             
-        // create three matricies and fill them with zeroes
-        MatrixXd A = MatrixXd::Zero(grid->lineLength * grid->numLines
-                      , grid->lineLength * grid->numLines);
-              
-        MatrixXd V = MatrixXd::Zero(1,grid->lineLength * grid->numLines);
-        MatrixXd known = MatrixXd::Zero(1,grid->lineLength * grid->numLines);
-
-        // counter what line on the actual grid the program is in 
-        int k=0;
-
-        LOG("Setting up grid.");
-        
-        // grid->lineLength  (how to find the line wrapping)
-        // Loop through the number of columns on A
-        for (int y = 0; y < A.cols() -2;)
-        {
-            // Loop through the number of columns of the grid 
-            for (uint x = 0; x <grid->lineLength ; ++x)
+        JasUnpack(graph, lineLength, numLines, interior, edge);
+
+        unknownIndex->assign(lineLength * numLines, FixedCell);
+        auto& index = *unknownIndex;
+        for (uint i = 0; i < interior.size(); ++i)
+        {
+            index[interior[i]] = i;
+        }
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            index[edge[e]] = interior.size() + e;
+        }
+    }
+
+    /// Builds the matrix A of the Laplace system over the non-fixed
+    /// cells of graph (4 on the diagonal, -1 for each non-fixed
+    /// neighbour)
+    static
+    void
+    BuildSystemMatrix(const Laplacian::CellGraph& graph,
+                      const std::vector<int>& index, SparseMat* A)
+    {
+        JasUnpack(graph, lineLength, interior, edge, edgeNeighbours);
+        const uint numUnknowns = graph.NumUnknowns();
+
+        std::vector<Eigen::Triplet<f64>> triplets;
+        triplets.reserve(5 * numUnknowns);
+
+        const auto AddRow = [&triplets, &index] (const int row, const Laplacian::Neighbours& n)
             {
-                //check if the current pixel is known
-                if ((*grid).fixedPoints.count(k * grid->numLines + x) != 0)
+                triplets.emplace_back(row, row, 4.0);
+                for (const auto neighbour : n)
                 {
-                    // If so add one to that place in A and add the known pixel
-                    // to that place in known
-                    A(y,y) = 1;                   
-                    known(0,y)=(*grid).voltages[k * grid->numLines + x];
-                   
-                    // The way A and known are structured y need to be incremented here
-                    y++;
-                        
+                    if (index[neighbour] != FixedCell)
+                    {
+                        triplets.emplace_back(row, index[neighbour], -1.0);
+                    }
                 }
+            };
 
-                else
+        for (const auto c : interior)
+        {
+            AddRow(index[c], Laplacian::Neighbours{{ c - 1, c + 1, c - lineLength, c + lineLength }});
+        }
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            AddRow(index[edge[e]], edgeNeighbours[e]);
+        }
+
+        A->resize(numUnknowns, numUnknowns);
+        A->setFromTriplets(triplets.begin(), triplets.end());
+        A->makeCompressed();
+    }
+
+    /// The right hand side of the system, i.e. the sum of the fixed
+    /// neighbours of every non-fixed cell
+    static
+    Eigen::VectorXd
+    BuildRhs(const Grid& grid, const Laplacian::CellGraph& graph,
+             const std::vector<int>& unknownIndex)
+    {
+        JasUnpack(graph, lineLength, interior, edge, edgeNeighbours);
+        const auto& voltages = grid.voltages;
+
+        Eigen::VectorXd b(graph.NumUnknowns());
+
+        const auto FixedSum = [&voltages, &unknownIndex] (const Laplacian::Neighbours& n) -> f64
+            {
+                f64 sum = 0.0;
+                for (const auto neighbour : n)
                 {
-                   
-                    // If not known add a -4 in A for current pixel and 1 for
-                    //each adjecent pixel
-                    A(y,y)= -4;
-
-                    //put 1 in A one left and one right of current place
-                    A(y,y+1) = 1;     
-                    A(y,y-1) = 1;
-                     
-                    // put 1 in A one up and one down of current place
-                    A(y,y+grid->numLines) = 1;
-                    A(y,y-(grid->numLines)) = 1 ;                  
-
-                    y++;                     
+                    if (unknownIndex[neighbour] == FixedCell)
+                    {
+                        sum += voltages[neighbour];
+                    }
                 }
-            }
-            // add one to the k value here
-            k++;
-            
-        }
-        
-        LOG("Solving grid");
-        // calculate the V by mutilpying (invers of A) * (known)
-        V = A.inverse() * known.transpose();
-        
-        LOG("Creating output grid");
-        // Fill in the grid with calculated values
-        for (int i = 1; i < V.rows() ; i++ )
-        {            
-            grid->voltages[i] = V(i);
+                return sum;
+            };
+
+        for (const auto c : interior)
+        {
+            b(unknownIndex[c]) = FixedSum(Laplacian::Neighbours{{ c - 1, c + 1, c - lineLength, c + lineLength }});
         }
-        
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            b(unknownIndex[edge[e]]) = FixedSum(edgeNeighbours[e]);
+        }
+        return b;
     }
 
-}
+    bool
+    MatrixInversionMethod(Grid* grid, const f64 stopPoint , const u64 maxIter,
+                          const char* cachePath)
+    {
+        TIME_FUNCTION();
+        // NOTE(Chris): This is a direct method, the tolerance and
+        // iteration count don't apply
+        (void)stopPoint;
+        (void)maxIter;
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
 
+        if (grid->fixedPoints.empty())
+        {
+            LOG("Grid has no fixed points, the system is singular");
+            return false;
+        }
 
+        std::vector<int> unknownIndex;
+        NumberUnknowns(graph, &unknownIndex);
+        const Eigen::VectorXd b = BuildRhs(*grid, graph, unknownIndex);
 
+        // NOTE(Chris): The matrix only depends on the geometry, so
+        // look for an existing factorisation, first in memory, then
+        // on disk
+        const u64 key = Laplacian::GeometryKey(*grid, graph);
+        auto& cache = FactorisationCache();
+        const Factorisation* factor = nullptr;
+        for (const auto& f : cache)
+        {
+            if (FactorisationMatches(f, key, *grid, graph))
+            {
+                LOG("Reusing factorisation from memory");
+                factor = &f;
+                break;
+            }
+        }
+
+        const auto AddToCache = [&cache] (Factorisation&& f) -> const Factorisation*
+            {
+                cache.push_back(std::move(f));
+                if (cache.size() > MaxCachedFactorisations)
+                {
+                    cache.pop_front();
+                }
+                return &cache.back();
+            };
 
+        if (!factor && cachePath)
+        {
+            Factorisation f;
+            if (ReadFactorisation(cachePath, key, &f)
+                && FactorisationMatches(f, key, *grid, graph))
+            {
+                LOG("Reusing factorisation from %s", cachePath);
+                factor = AddToCache(std::move(f));
+            }
+        }
+
+        Eigen::VectorXd V;
+        if (!factor)
+        {
+            LOG("Setting up sparse system (%u unknowns)", graph.NumUnknowns());
+            SparseMat A;
+            BuildSystemMatrix(graph, unknownIndex, &A);
+
+            // NOTE(Chris): A is symmetric positive definite, so LDL^T
+            // with an AMD ordering is the method of choice, LU is only
+            // kept as a fallback should it ever fail
+            Eigen::SimplicialLDLT<SparseMat, Eigen::Lower, Eigen::AMDOrdering<int>> ldlt(A);
+            if (ldlt.info() == Eigen::Success)
+            {
+                Factorisation f;
+                f.key = key;
+                f.lineLength = graph.lineLength;
+                f.numLines = graph.numLines;
+                f.horizZip = grid->horizZip;
+                f.verticZip = grid->verticZip;
+                f.fixed = graph.fixed;
+                f.L = ldlt.matrixL().nestedExpression();
+                f.L.makeCompressed();
+                f.D = ldlt.vectorD();
+                f.perm = ldlt.permutationP().indices();
+                factor = AddToCache(std::move(f));
+
+                if (cachePath && WriteFactorisation(cachePath, *factor))
+                {
+                    LOG("Wrote factorisation to %s", cachePath);
+                }
+            }
+            else
+            {
+                LOG("LDL^T factorisation failed, falling back to LU");
+                Eigen::SparseLU<SparseMat, Eigen::COLAMDOrdering<int>> lu;
+                lu.analyzePattern(A);
+                lu.factorize(A);
+                if (lu.info() != Eigen::Success)
+                {
+                    LOG("LU factorisation failed: %s", lu.lastErrorMessage().c_str());
+                    return false;
+                }
+                V = lu.solve(b);
+            }
+        }
+
+        if (factor)
+        {
+            LOG("Solving grid with LDL^T");
+            V = SolveFactorised(*factor, b);
+        }
+
+        LOG("Creating output grid");
+        for (uint c = 0; c < unknownIndex.size(); ++c)
+        {
+            if (unknownIndex[c] != FixedCell)
+            {
+                grid->voltages[c] = V(unknownIndex[c]);
+            }
+        }
+
+        return true;
+    }
+}
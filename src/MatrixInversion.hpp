@@ -14,11 +14,18 @@
 class Grid;
 namespace MatrixInversion
 {
-
-    void
-    MatrixInversionMethod(Grid* grid, const f64 stopPoint , const u64 maxIter);
+    /// Solves the grid directly with a sparse factorisation of the
+    /// Laplace system over the non-fixed cells. Works for any grid
+    /// shape and zip setting. stopPoint and maxIter are unused, but
+    /// kept so the method can be dispatched like the others.
+    /// Factorisations are kept in memory and reused for grids with the
+    /// same geometry (positions of the fixed points), if cachePath is
+    /// given they are also stored in and loaded from that file.
+    /// Returns false if the factorisation failed
+    bool
+    MatrixInversionMethod(Grid* grid, const f64 stopPoint , const u64 maxIter,
+                          const char* cachePath = nullptr);
     
 }
 
 #endif
-
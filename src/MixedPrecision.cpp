@@ -0,0 +1,228 @@
+/* ==========================================================================
+   $File: MixedPrecision.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "MixedPrecision.hpp"
+#include "Checkerboard.hpp"
+#include "Convergence.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "SpectralRadius.hpp"
+#include "Stencil.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace MixedPrecision
+{
+    /// Max number of threads to be used by OpenMP, as for the other
+    /// solvers
+    const uint MaxThreads = 30;
+
+    /// Number of single precision sweeps on each correction. This is
+    /// the error check interval of the other relaxation solvers, by
+    /// which point the correction has either converged to single
+    /// precision or the next refinement step would have to start from
+    /// a similar residual anyway
+    const uint InnerSweeps = 200;
+
+    using Checkerboard::Colour;
+    using Checkerboard::SplitGrid;
+
+    /// Stores the residual of the Jacobi form of the equations, r =
+    /// 1/4 (sum of neighbours) - v, for every non-fixed cell into rhs
+    /// (fixed cells have a residual of 0). Returns the max relative
+    /// change a Jacobi step would make, |r / (v + r)|
+    static
+    f64
+    Residual(const SplitGrid& split, std::vector<f32>* rhs)
+    {
+        JasUnpack(split, numLines, halfLength, values, update);
+        f32* r = rhs->data();
+
+        f64 maxErr = 0.0;
+        for (uint c = 0; c < 2; ++c)
+        {
+            const Colour colour = (Colour)c;
+            const Colour other = (Colour)(1 - c);
+
+#pragma omp parallel for default(none) shared(split, values, update, r, numLines, halfLength, colour, other) reduction(max:maxErr)
+            for (uint y = 1; y < numLines - 1; ++y)
+            {
+                const uint offset = (y + (uint)colour) % 2;
+                const uint row = split.RowStart(colour, y);
+                const uint right = split.RowStart(other, y) + offset;
+                const uint up = split.RowStart(other, y - 1);
+                const uint down = split.RowStart(other, y + 1);
+
+                for (uint i = 0; i < halfLength; ++i)
+                {
+                    if (!update[row + i])
+                        continue;
+
+                    const f64 phiI = 0.25 * (values[right + i] + values[right + i - 1]
+                                             + values[up + i] + values[down + i]);
+                    const f64 res = phiI - values[row + i];
+                    r[row + i] = (f32)res;
+
+                    const f64 absErr = std::abs(res / phiI);
+                    if (absErr > maxErr && absErr == absErr)
+                        maxErr = absErr;
+                }
+            }
+
+            const auto& edge = split.edge[c];
+            const auto& edgeNeighbours = split.edgeNeighbours[c];
+            for (uint e = 0; e < edge.size(); ++e)
+            {
+                const auto& n = edgeNeighbours[e];
+                const f64 phiI = 0.25 * (values[n[0]] + values[n[1]] + values[n[2]] + values[n[3]]);
+                const f64 res = phiI - values[edge[e]];
+                r[edge[e]] = (f32)res;
+
+                const f64 absErr = std::abs(res / phiI);
+                if (absErr > maxErr && absErr == absErr)
+                    maxErr = absErr;
+            }
+        }
+        return maxErr;
+    }
+
+    /// Over-relaxes one colour of the single precision correction,
+    /// rows in parallel and then the zipped edge cells serially
+    static
+    void
+    RelaxCorrection(const SplitGrid& split, const std::vector<f32>& rhs, const Colour colour,
+                    const f32 w, std::vector<f32>* correction)
+    {
+        JasUnpack(split, numLines, halfLength);
+        f32* e = correction->data();
+        const f32* r = rhs.data();
+        const u8* update = split.update.data();
+        const Colour other = (colour == Colour::Red) ? Colour::Black : Colour::Red;
+
+#pragma omp parallel for default(none) shared(split, e, r, update, numLines, halfLength, colour, other, w)
+        for (uint y = 1; y < numLines - 1; ++y)
+        {
+            const uint offset = (y + (uint)colour) % 2;
+            const uint row = split.RowStart(colour, y);
+            const f32* right = e + split.RowStart(other, y) + offset;
+            const f32* left = right - 1;
+            const f32* up = e + split.RowStart(other, y - 1);
+            const f32* down = e + split.RowStart(other, y + 1);
+
+            Stencil::SplitRowF32(e + row, right, left, up, down, r + row, update + row,
+                                 0, halfLength, w);
+        }
+
+        const auto& edge = split.edge[(uint)colour];
+        const auto& edgeNeighbours = split.edgeNeighbours[(uint)colour];
+        for (uint i = 0; i < edge.size(); ++i)
+        {
+            const auto& n = edgeNeighbours[i];
+            const f32 phiI = 0.25f * (e[n[0]] + e[n[1]] + e[n[2]] + e[n[3]]) + r[edge[i]];
+            e[edge[i]] = (1.0f - w) * e[edge[i]] + w * phiI;
+        }
+    }
+
+    /// Iterative refinement loop on the split layout. grid is only
+    /// written to when the monitor needs the voltages for a residual
+    /// criterion. Returns true if the tolerance was reached
+    static
+    bool
+    Refine(SplitGrid* split, Grid* grid, const Convergence::Monitor& monitor,
+           const f64 w, const f64 zeroTol, const u64 maxIter)
+    {
+        auto& values = split->values;
+        std::vector<f32> rhs(values.size(), 0.0f);
+        std::vector<f32> correction(values.size(), 0.0f);
+
+        u64 sweeps = 0;
+        f64 maxErr = 0.0;
+        for (;;)
+        {
+            maxErr = Residual(*split, &rhs);
+            if (monitor.UsesResidual())
+            {
+                Checkerboard::StoreToGrid(*split, grid);
+                maxErr = monitor.Measure(grid->voltages, maxErr);
+            }
+
+            if (maxErr < zeroTol)
+            {
+                LOG("Performed %u iterations, max error: %e", (unsigned)sweeps, maxErr);
+                return true;
+            }
+
+            if (sweeps >= maxIter)
+                break;
+
+            // NOTE(Chris): Report error every 5000 iterations
+            if (sweeps > 0 && sweeps % 5000 == 0)
+            {
+                LOG("After %u iterations, %s %e", (unsigned)sweeps,
+                    Convergence::CriterionName(Convergence::ActiveCriterion()), maxErr);
+            }
+
+            // NOTE(Chris): Every correction is found from zero, fixed
+            // cells and padding are never updated so stay 0 and the
+            // accumulation below can run over everything
+            std::fill(correction.begin(), correction.end(), 0.0f);
+            const u64 steps = std::min((u64)InnerSweeps, maxIter - sweeps);
+            for (u64 s = 0; s < steps; ++s)
+            {
+                RelaxCorrection(*split, rhs, Colour::Red, (f32)w, &correction);
+                RelaxCorrection(*split, rhs, Colour::Black, (f32)w, &correction);
+            }
+            sweeps += steps;
+
+            for (uint i = 0; i < values.size(); ++i)
+                values[i] += correction[i];
+        }
+        LOG("Overran max iteration counter (%u), max error: %e", (unsigned)maxIter, maxErr);
+        return false;
+    }
+
+    bool
+    MixedPrecisionSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                         bool parallel)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        const uint numCells = grid->voltages.size();
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        const f64 w = Spectral::OptimalOmega(Spectral::JacobiRadius(*grid, graph));
+        LOG("Mixed precision SOR, w = %f, %s kernels, num threads %u", w,
+            Stencil::InstructionSetName(Stencil::ActiveInstructionSet()), parallel ? numThreads : 1);
+
+        SplitGrid split;
+        Checkerboard::BuildSplitGrid(graph, &split);
+        Checkerboard::LoadFromGrid(*grid, &split);
+
+        const Convergence::Monitor monitor(*grid);
+        const bool converged = Refine(&split, grid, monitor, w, zeroTol, maxIter);
+
+        Checkerboard::StoreToGrid(split, grid);
+        return converged;
+    }
+}
@@ -0,0 +1,34 @@
+// -*- c++ -*-
+#if !defined(MIXEDPRECISION_H)
+/* ==========================================================================
+   $File: MixedPrecision.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define MIXEDPRECISION_H
+// Red-black SOR with the sweeps done in single precision, which halves
+// the memory traffic and doubles the SIMD width, wrapped in iterative
+// refinement in double precision so the accuracy isn't lost
+
+#include "GlobalDefines.hpp"
+
+class Grid;
+
+namespace MixedPrecision
+{
+    /// Mixed precision iterative refinement. The residual of the
+    /// current solution is computed in double, a correction is found by
+    /// red-black SOR sweeps in single precision on the split
+    /// checkerboard layout, and then added to the solution in double.
+    /// Supports all zip combinations. Unless a residual convergence
+    /// criterion is selected, zeroTol is the max relative change a
+    /// Jacobi step would make to any cell of the double precision
+    /// solution. maxIter limits the total number of single precision
+    /// sweeps. Returns true if the solution converged
+    bool
+    MixedPrecisionSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                         bool parallel = true);
+}
+#endif
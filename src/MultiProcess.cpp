@@ -0,0 +1,810 @@
+/* ==========================================================================
+   $File: MultiProcess.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "MultiProcess.hpp"
+#include "Convergence.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "RedBlack.hpp"
+#include "SpectralRadius.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+
+extern char** environ;
+
+namespace MultiProcess
+{
+    /// Max number of threads to be used by OpenMP in each worker, as
+    /// for the other solvers
+    const uint MaxThreads = 30;
+
+    /// Check the (globally reduced) error every this many iterations
+    const uint ErrorCheckInterval = 500;
+
+    /// Stride in f64s between the error slots of the workers, so that
+    /// each worker writes to its own cache line
+    const uint ErrorSlotStride = 8;
+
+    /// The rows of the grid owned by one worker. The worker's local
+    /// copy has a ghost row either side of these
+    struct Slab
+    {
+        uint firstLine;
+        uint numOwned;
+    };
+
+    /// The problem and parameters of the solve, written by the
+    /// launching process before it starts the workers
+    struct Problem
+    {
+        u32 numProcesses;
+        u32 lineLength;
+        u32 numLines;
+        u32 criterion;
+        u8 horizZip;
+        u8 verticZip;
+        u8 pinWorkers;
+        u8 scaleResidual;
+        f64 w;
+        f64 zeroTol;
+        u64 maxIter;
+    };
+
+    /// Progress of the solve, reported by the first worker for the
+    /// launching process to log. seq is odd while a report is being
+    /// written. The final report sets done, and is complete once the
+    /// workers exit
+    struct Progress
+    {
+        u32 seq;
+        u8 done;
+        u8 converged;
+        u64 iteration;
+        f64 maxErr;
+    };
+
+    /// The memory shared by the workers and the launching process.
+    /// This is a POSIX shared memory object which is unlinked as soon
+    /// as it is created, the workers attach to it through the file
+    /// descriptor they inherit
+    struct SharedRegion
+    {
+        void* base;
+        size_t size;
+        int fd;
+        Problem* problem;
+        /// Non-zero for the fixed cells of the grid
+        u8* fixed;
+        Progress* progress;
+        /// Process-shared barrier, (futex based on Linux)
+        pthread_barrier_t* barrier;
+        /// One slot per worker for the max relative change
+        f64* errors;
+        /// Halo buffers, indexed [parity][worker][top/bottom][x]
+        f64* halos;
+        /// The voltages of the full grid. These are the starting
+        /// voltages until the workers' first barrier, and are written
+        /// by the workers on exit
+        f64* result;
+        /// The residual measured by the first worker at each check,
+        /// when a residual criterion is active
+        f64* measured;
+    };
+
+    uint
+    NumNumaNodes()
+    {
+        DIR* dir = opendir("/sys/devices/system/node");
+        if (!dir)
+            return 1;
+
+        uint numNodes = 0;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            uint node;
+            if (sscanf(entry->d_name, "node%u", &node) == 1)
+                ++numNodes;
+        }
+        closedir(dir);
+
+        return numNodes > 0 ? numNodes : 1;
+    }
+
+    /// Restricts the calling process to the cpus of a NUMA node, so
+    /// that the memory it first touches is allocated on that node.
+    /// Returns false if the cpu list of the node couldn't be read
+    static
+    bool
+    PinToNode(const uint node)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (!file)
+            return false;
+
+        // NOTE(Chris): The list is of the form "0-13,28-41"
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        uint numCpus = 0;
+        uint first, last;
+        while (fscanf(file, "%u", &first) == 1)
+        {
+            last = first;
+            if (fscanf(file, "-%u", &last) != 1)
+                last = first;
+
+            for (uint c = first; c <= last && c < CPU_SETSIZE; ++c)
+            {
+                CPU_SET(c, &cpus);
+                ++numCpus;
+            }
+
+            if (fgetc(file) != ',')
+                break;
+        }
+        fclose(file);
+
+        if (numCpus == 0)
+            return false;
+
+        return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+    }
+
+    /// Splits the lines of the grid as evenly as possible between the
+    /// workers
+    static
+    std::vector<Slab>
+    SplitSlabs(const uint numLines, const uint numProcesses)
+    {
+        std::vector<Slab> slabs(numProcesses);
+        const uint base = numLines / numProcesses;
+        const uint extra = numLines % numProcesses;
+
+        uint line = 0;
+        for (uint p = 0; p < numProcesses; ++p)
+        {
+            slabs[p].firstLine = line;
+            slabs[p].numOwned = base + (p < extra ? 1 : 0);
+            line += slabs[p].numOwned;
+        }
+        return slabs;
+    }
+
+    /// Points the sections of shared into the mapping at shared->base
+    /// (if it is set) for numProcesses workers on a grid of the given
+    /// size, and returns the size of the mapping
+    static
+    size_t
+    LayoutSharedRegion(const uint numProcesses, const uint lineLength, const uint numCells,
+                       SharedRegion* shared)
+    {
+        // NOTE(Chris): Each section is aligned to a cache line
+        const size_t align = 64;
+        auto roundUp = [align](size_t s) { return (s + align - 1) / align * align; };
+
+        const size_t sizes[] = {
+            roundUp(sizeof(Problem)),
+            roundUp(sizeof(u8) * numCells),
+            roundUp(sizeof(Progress)),
+            roundUp(sizeof(pthread_barrier_t)),
+            roundUp(sizeof(f64) * ErrorSlotStride * numProcesses),
+            roundUp(sizeof(f64) * 2 * numProcesses * 2 * lineLength),
+            roundUp(sizeof(f64) * numCells),
+            roundUp(sizeof(f64))
+        };
+
+        u8* sections[sizeof(sizes) / sizeof(sizes[0])];
+        size_t offset = 0;
+        for (uint i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        {
+            sections[i] = (u8*)shared->base + offset;
+            offset += sizes[i];
+        }
+
+        if (shared->base)
+        {
+            shared->problem = (Problem*)sections[0];
+            shared->fixed = sections[1];
+            shared->progress = (Progress*)sections[2];
+            shared->barrier = (pthread_barrier_t*)sections[3];
+            shared->errors = (f64*)sections[4];
+            shared->halos = (f64*)sections[5];
+            shared->result = (f64*)sections[6];
+            shared->measured = (f64*)sections[7];
+        }
+        return offset;
+    }
+
+    /// Creates the shared region for numProcesses workers on a grid of
+    /// the given size and initialises the barrier. The descriptor is
+    /// left open (and inheritable) for the workers. Returns false on
+    /// failure
+    static
+    bool
+    CreateSharedRegion(const uint numProcesses, const uint lineLength, const uint numCells,
+                       SharedRegion* shared)
+    {
+        // NOTE(Chris): The name only needs to be unique until it is
+        // unlinked, straight after it is opened
+        static uint counter = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "/gridle-%d-%u", (int)getpid(), counter++);
+        shared->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (shared->fd < 0)
+        {
+            LOG("Unable to create shared memory object: %s", strerror(errno));
+            return false;
+        }
+        shm_unlink(name);
+
+        shared->base = nullptr;
+        shared->size = LayoutSharedRegion(numProcesses, lineLength, numCells, shared);
+        // NOTE(Chris): shm_open sets FD_CLOEXEC, which would close it
+        // before the workers could attach
+        if (fcntl(shared->fd, F_SETFD, 0) != 0 || ftruncate(shared->fd, shared->size) != 0)
+        {
+            LOG("Unable to size %zu bytes of shared memory: %s", shared->size, strerror(errno));
+            close(shared->fd);
+            return false;
+        }
+
+        shared->base = mmap(nullptr, shared->size, PROT_READ | PROT_WRITE, MAP_SHARED, shared->fd, 0);
+        if (shared->base == MAP_FAILED)
+        {
+            LOG("Unable to map %zu bytes of shared memory: %s", shared->size, strerror(errno));
+            close(shared->fd);
+            return false;
+        }
+        LayoutSharedRegion(numProcesses, lineLength, numCells, shared);
+
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        const int err = pthread_barrier_init(shared->barrier, &attr, numProcesses);
+        pthread_barrierattr_destroy(&attr);
+        if (err != 0)
+        {
+            LOG("Unable to initialise process-shared barrier: %s", strerror(err));
+            munmap(shared->base, shared->size);
+            close(shared->fd);
+            return false;
+        }
+
+        return true;
+    }
+
+    /// Maps the shared region created by the launching process from
+    /// the inherited descriptor. Returns false on failure
+    static
+    bool
+    AttachSharedRegion(const int fd, SharedRegion* shared)
+    {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Problem))
+            return false;
+
+        shared->fd = fd;
+        shared->size = info.st_size;
+        shared->base = mmap(nullptr, shared->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (shared->base == MAP_FAILED)
+            return false;
+
+        const Problem& problem = *(const Problem*)shared->base;
+        const uint numCells = problem.lineLength * problem.numLines;
+        if (LayoutSharedRegion(problem.numProcesses, problem.lineLength, numCells, shared) != shared->size)
+        {
+            munmap(shared->base, shared->size);
+            return false;
+        }
+        return true;
+    }
+
+    /// Unmaps the shared region, destroying the barrier and closing
+    /// the descriptor in the launching process
+    static
+    void
+    DestroySharedRegion(SharedRegion* shared)
+    {
+        pthread_barrier_destroy(shared->barrier);
+        munmap(shared->base, shared->size);
+        close(shared->fd);
+    }
+
+    /// Number of OpenMP threads for a worker: the cpus it may run on
+    /// (its node's if pinned, otherwise an even share), limited by the
+    /// size of its slab as in the other solvers
+    static
+    uint
+    WorkerThreads(const bool pinned, const uint numProcesses, const uint slabCells)
+    {
+        cpu_set_t cpus;
+        uint numCpus = 1;
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+            numCpus = CPU_COUNT(&cpus);
+        if (!pinned)
+            numCpus = std::max(1u, numCpus / numProcesses);
+
+        const uint numWorkChunks = (slabCells / 20000 > 0) ? (slabCells / 20000) : 1;
+        return std::min(std::min(numCpus, numWorkChunks), MaxThreads);
+    }
+
+    /// Colours the non-fixed cells owned by a slab, in the local
+    /// indices of the slab (i.e. with a ghost row either side). The
+    /// colours are those of the full grid, so relaxing the slabs
+    /// together is the same as relaxing the full grid. Only the cells
+    /// on a vertical zip need their neighbours stored, as the ghost
+    /// rows take care of the horizontal zip
+    static
+    void
+    ColourSlabCells(const Laplacian::CellGraph& graph, const Slab& slab,
+                    RedBlack::ColouredCells* red, RedBlack::ColouredCells* black)
+    {
+        JasUnpack(graph, lineLength, fixed);
+
+#ifdef USE_SIMD
+        red->update.assign((slab.numOwned + 2) * lineLength, 0);
+        black->update.assign((slab.numOwned + 2) * lineLength, 0);
+#endif
+
+        for (uint y = slab.firstLine; y < slab.firstLine + slab.numOwned; ++y)
+        {
+            for (uint x = 0; x < lineLength; ++x)
+            {
+                if (fixed[y * lineLength + x])
+                    continue;
+
+                const uint local = (y - slab.firstLine + 1) * lineLength + x;
+                RedBlack::ColouredCells* colour = ((x + y) % 2 == 0) ? red : black;
+
+                if (x > 0 && x < lineLength - 1)
+                {
+                    colour->interior.push_back(local);
+#ifdef USE_SIMD
+                    colour->update[local] = 1;
+#endif
+                    continue;
+                }
+
+                // NOTE(Chris): A non-fixed cell on the left or right
+                // edge is only valid with a vertical zip
+                const uint left = (x == 0) ? local + lineLength - 1 : local - 1;
+                const uint right = (x == lineLength - 1) ? local - (lineLength - 1) : local + 1;
+                colour->edge.push_back(local);
+                colour->edgeNeighbours.push_back({{left, right, local - lineLength, local + lineLength}});
+            }
+        }
+    }
+
+    /// Publishes the owned boundary rows of a slab into the halo buffer
+    /// of this parity, waits for the other workers to do the same, and
+    /// then fills the ghost rows from the neighbouring slabs
+    static
+    void
+    ExchangeHalos(std::vector<f64>* local, const Slab& slab, const uint process,
+                  const uint numProcesses, const uint lineLength, const bool horizZip,
+                  const uint parity, const SharedRegion& shared)
+    {
+        // NOTE(Chris): The halo buffers alternate between two parities,
+        // so a worker that races ahead to the next exchange can't
+        // overwrite a buffer that a slower worker is still reading from
+        // (it must first pass the barrier that the slower worker only
+        // reaches after reading), so only one barrier is needed
+        auto halo = [&](uint p, uint side)
+        {
+            return shared.halos + ((parity * numProcesses + p) * 2 + side) * lineLength;
+        };
+
+        const f64* firstOwned = local->data() + lineLength;
+        const f64* lastOwned = local->data() + slab.numOwned * lineLength;
+        std::copy(firstOwned, firstOwned + lineLength, halo(process, 0));
+        std::copy(lastOwned, lastOwned + lineLength, halo(process, 1));
+
+        pthread_barrier_wait(shared.barrier);
+
+        // NOTE(Chris): Without a horizontal zip the first and last
+        // lines are fixed, so the outer ghost rows are never read
+        if (process > 0 || horizZip)
+        {
+            const f64* above = halo((process + numProcesses - 1) % numProcesses, 1);
+            std::copy(above, above + lineLength, local->data());
+        }
+        if (process < numProcesses - 1 || horizZip)
+        {
+            const f64* below = halo((process + 1) % numProcesses, 0);
+            std::copy(below, below + lineLength, local->data() + (slab.numOwned + 1) * lineLength);
+        }
+    }
+
+    /// Applies a residual criterion at a check: every worker writes
+    /// its owned rows to the shared result, the first measures the
+    /// residual of the full grid, and all of them return it
+    static
+    f64
+    MeasureResidual(const std::vector<f64>& local, const Slab& slab, const uint process,
+                    const uint lineLength, const Convergence::Monitor& monitor,
+                    const f64 relChange, std::vector<f64>* full, const SharedRegion& shared)
+    {
+        std::copy(local.begin() + lineLength, local.begin() + (slab.numOwned + 1) * lineLength,
+                  shared.result + slab.firstLine * lineLength);
+        pthread_barrier_wait(shared.barrier);
+
+        if (process == 0)
+        {
+            std::copy(shared.result, shared.result + full->size(), full->begin());
+            *shared.measured = monitor.Measure(*full, relChange);
+        }
+        // NOTE(Chris): The result rows aren't written again until the
+        // next check, which is many barriers after this one
+        pthread_barrier_wait(shared.barrier);
+        return *shared.measured;
+    }
+
+    /// Publishes a progress report for the launching process to log
+    static
+    void
+    ReportProgress(Progress* progress, const u64 iteration, const f64 maxErr, const bool done,
+                   const bool converged)
+    {
+        __atomic_add_fetch(&progress->seq, 1, __ATOMIC_ACQ_REL);
+        progress->iteration = iteration;
+        progress->maxErr = maxErr;
+        progress->done = done ? 1 : 0;
+        progress->converged = converged ? 1 : 0;
+        __atomic_add_fetch(&progress->seq, 1, __ATOMIC_ACQ_REL);
+    }
+
+    /// The body of a worker process. Relaxes its slab, exchanging
+    /// halos after each colour, until the globally reduced error
+    /// (under the active criterion) drops below zeroTol or maxIter is
+    /// reached, and then writes its owned rows to the shared result
+    static
+    void
+    Worker(const Grid& grid, const Laplacian::CellGraph& graph, const std::vector<Slab>& slabs,
+           const uint process, const f64 w, const f64 zeroTol, const u64 maxIter,
+           const Convergence::Monitor& monitor, const SharedRegion& shared)
+    {
+        JasUnpack(grid, voltages, lineLength, horizZip);
+        const uint numProcesses = slabs.size();
+        const Slab& slab = slabs[process];
+
+        RedBlack::ColouredCells red;
+        RedBlack::ColouredCells black;
+        ColourSlabCells(graph, slab, &red, &black);
+
+        // NOTE(Chris): The local copy is allocated and first touched by
+        // the worker, so it lives on the worker's NUMA node
+        std::vector<f64> local((slab.numOwned + 2) * lineLength, 0.0);
+        std::copy(voltages.begin() + slab.firstLine * lineLength,
+                  voltages.begin() + (slab.firstLine + slab.numOwned) * lineLength,
+                  local.begin() + lineLength);
+
+        std::vector<f64> full;
+        if (process == 0 && monitor.UsesResidual())
+            full.resize(voltages.size());
+
+        uint parity = 0;
+        ExchangeHalos(&local, slab, process, numProcesses, lineLength, horizZip, parity, shared);
+        parity ^= 1;
+
+        f64 maxErr = 0.0;
+        bool converged = false;
+        u64 i = 1;
+        for (; i <= maxIter; ++i)
+        {
+            const bool computeErr = (i % ErrorCheckInterval == 0);
+
+            const f64 redErr = RedBlack::RelaxColour(&local, lineLength, red, w, computeErr);
+            ExchangeHalos(&local, slab, process, numProcesses, lineLength, horizZip, parity, shared);
+            parity ^= 1;
+
+            const f64 blackErr = RedBlack::RelaxColour(&local, lineLength, black, w, computeErr);
+            // NOTE(Chris): The error slot is written before the halo
+            // exchange, so its barrier also guarantees every worker's
+            // slot is up to date when we read them afterwards
+            if (unlikely(computeErr))
+                shared.errors[process * ErrorSlotStride] = std::max(redErr, blackErr);
+
+            ExchangeHalos(&local, slab, process, numProcesses, lineLength, horizZip, parity, shared);
+            parity ^= 1;
+
+            if (unlikely(computeErr))
+            {
+                maxErr = 0.0;
+                for (uint p = 0; p < numProcesses; ++p)
+                    maxErr = std::max(maxErr, shared.errors[p * ErrorSlotStride]);
+                if (monitor.UsesResidual())
+                    maxErr = MeasureResidual(local, slab, process, lineLength, monitor, maxErr,
+                                             &full, shared);
+
+                if (maxErr < zeroTol)
+                {
+                    converged = true;
+                    break;
+                }
+
+                if (process == 0 && i % 5000 == 0)
+                    ReportProgress(shared.progress, i, maxErr, false, false);
+            }
+        }
+
+        // NOTE(Chris): Every worker sees the same reduced error, so the
+        // first one can report for all of them
+        if (process == 0)
+            ReportProgress(shared.progress, converged ? i : maxIter, maxErr, true, converged);
+
+        std::copy(local.begin() + lineLength, local.begin() + (slab.numOwned + 1) * lineLength,
+                  shared.result + slab.firstLine * lineLength);
+    }
+
+    /// Logs the first worker's progress report if there is a new one.
+    /// A report that is being written, or changed while we read it,
+    /// is left for the next poll
+    static
+    void
+    LogProgress(const Progress& progress, u32* lastSeq)
+    {
+        const u32 seq = __atomic_load_n(&progress.seq, __ATOMIC_ACQUIRE);
+        if (seq == *lastSeq || seq % 2 != 0)
+            return;
+
+        const bool done = progress.done;
+        const u64 iteration = progress.iteration;
+        const f64 maxErr = progress.maxErr;
+        if (__atomic_load_n(&progress.seq, __ATOMIC_ACQUIRE) != seq)
+            return;
+
+        *lastSeq = seq;
+        if (done)
+            return;
+        LOG("After %u iterations, %s %e", (unsigned)iteration,
+            Convergence::CriterionName(Convergence::ActiveCriterion()), maxErr);
+    }
+
+    /// Waits for all of the workers to exit, logging their progress.
+    /// If any of them fails the rest are killed, as they would
+    /// otherwise wait on the barrier forever. Returns true if all of
+    /// the workers succeeded
+    static
+    bool
+    WaitForWorkers(std::vector<pid_t>* workers, const SharedRegion& shared)
+    {
+        u32 lastSeq = 0;
+        // NOTE(Chris): We poll each of our workers rather than waiting
+        // on any child, so we don't reap processes that aren't ours
+        bool success = true;
+        uint numRunning = workers->size();
+        while (numRunning > 0)
+        {
+            bool anyExited = false;
+            for (auto& worker : *workers)
+            {
+                if (worker <= 0)
+                    continue;
+
+                int status;
+                const pid_t pid = waitpid(worker, &status, WNOHANG);
+                if (pid == 0 || (pid < 0 && errno == EINTR))
+                    continue;
+
+                const bool failed = (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0);
+                if (failed && success)
+                {
+                    LOG("Worker process %d failed, stopping the others", (int)worker);
+                }
+                success = success && !failed;
+                worker = 0;
+                --numRunning;
+                anyExited = true;
+            }
+
+            if (!success)
+            {
+                for (auto worker : *workers)
+                {
+                    if (worker > 0)
+                        kill(worker, SIGKILL);
+                }
+            }
+
+            if (!anyExited)
+            {
+                LogProgress(*shared.progress, &lastSeq);
+                usleep(1000);
+            }
+        }
+        return success;
+    }
+
+    int
+    WorkerMain(const int argc, const char* argv[])
+    {
+        if (argc != 4)
+            return EXIT_FAILURE;
+
+        const int fd = atoi(argv[2]);
+        const uint process = atoi(argv[3]);
+        SharedRegion shared;
+        if (!AttachSharedRegion(fd, &shared))
+        {
+            LOG("Worker %u unable to attach to the shared region", process);
+            return EXIT_FAILURE;
+        }
+
+        const Problem& problem = *shared.problem;
+        // NOTE(Chris): Pin before the first parallel region, so that
+        // the OpenMP team is created on (and inherits) the node's cpus
+        if (problem.pinWorkers)
+            PinToNode(process);
+        Convergence::SelectCriterion((Cfg::ConvergenceCriterion)problem.criterion,
+                                     problem.scaleResidual);
+
+        // NOTE(Chris): Every worker rebuilds the grid, as the cell graph
+        // and the monitor need the whole of it
+        Grid grid(problem.horizZip, problem.verticZip);
+        grid.lineLength = problem.lineLength;
+        grid.numLines = problem.numLines;
+        const uint numCells = grid.lineLength * grid.numLines;
+        grid.voltages.assign(shared.result, shared.result + numCells);
+        for (uint i = 0; i < numCells; ++i)
+        {
+            if (shared.fixed[i])
+                grid.fixedPoints.emplace(i, grid.voltages[i]);
+        }
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(grid, &graph))
+            return EXIT_FAILURE;
+
+        const std::vector<Slab> slabs = SplitSlabs(grid.numLines, problem.numProcesses);
+        omp_set_num_threads(WorkerThreads(problem.pinWorkers, problem.numProcesses,
+                                          slabs[process].numOwned * grid.lineLength));
+
+        const Convergence::Monitor monitor(grid);
+        Worker(grid, graph, slabs, process, problem.w, problem.zeroTol, problem.maxIter, monitor, shared);
+
+        munmap(shared.base, shared.size);
+        return EXIT_SUCCESS;
+    }
+
+    /// Starts worker process p, a fresh copy of this program (so it
+    /// has its own OpenMP runtime) in the worker role, which attaches
+    /// to the shared region. The worker's own logging is discarded, as
+    /// we log its progress (and our stdout may be carrying json).
+    /// Returns the pid, or -1 on failure
+    static
+    pid_t
+    SpawnWorker(const uint p, const SharedRegion& shared)
+    {
+        char fdArg[16];
+        char processArg[16];
+        snprintf(fdArg, sizeof(fdArg), "%d", shared.fd);
+        snprintf(processArg, sizeof(processArg), "%u", p);
+        char* const argv[] = { (char*)Version::ProgramName, (char*)WorkerFlag, fdArg, processArg, nullptr };
+
+        // NOTE(Chris): The worker would otherwise truncate our log as
+        // it starts up
+        std::vector<char*> env;
+        const std::string logEnv = std::string(Version::LogPathEnv) + "=/dev/null";
+        for (char** e = environ; *e; ++e)
+        {
+            if (strncmp(*e, Version::LogPathEnv, strlen(Version::LogPathEnv)) != 0
+                || (*e)[strlen(Version::LogPathEnv)] != '=')
+                env.push_back(*e);
+        }
+        env.push_back((char*)logEnv.c_str());
+        env.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid;
+        const int err = posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, argv, env.data());
+        posix_spawn_file_actions_destroy(&actions);
+        if (err != 0)
+        {
+            LOG("Unable to start worker process: %s", strerror(err));
+            return -1;
+        }
+        return pid;
+    }
+
+    bool
+    MultiProcessSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                       uint numProcesses)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        JasUnpack((*grid), voltages, lineLength, numLines);
+        numProcesses = std::min(std::max(numProcesses, 1u), numLines);
+        const uint numCells = voltages.size();
+        const bool pinWorkers = (numProcesses > 1 && numProcesses == NumNumaNodes());
+
+        const f64 w = Spectral::OptimalOmega(Spectral::JacobiRadius(*grid, graph));
+        LOG("Multi-process red-black SOR, w = %f, num processes %u%s", w, numProcesses,
+            pinWorkers ? ", one per NUMA node" : "");
+
+        SharedRegion shared;
+        if (!CreateSharedRegion(numProcesses, lineLength, numCells, &shared))
+            return false;
+
+        Problem& problem = *shared.problem;
+        problem.numProcesses = numProcesses;
+        problem.lineLength = lineLength;
+        problem.numLines = numLines;
+        problem.criterion = (u32)Convergence::ActiveCriterion();
+        problem.horizZip = grid->horizZip;
+        problem.verticZip = grid->verticZip;
+        problem.pinWorkers = pinWorkers;
+        problem.scaleResidual = Convergence::ScalesByBoundary();
+        problem.w = w;
+        problem.zeroTol = zeroTol;
+        problem.maxIter = maxIter;
+        for (const auto& fixed : grid->fixedPoints)
+            shared.fixed[fixed.first] = 1;
+        std::copy(voltages.begin(), voltages.end(), shared.result);
+
+        std::vector<pid_t> workers;
+        workers.reserve(numProcesses);
+        for (uint p = 0; p < numProcesses; ++p)
+        {
+            const pid_t pid = SpawnWorker(p, shared);
+            if (pid < 0)
+            {
+                for (auto worker : workers)
+                    kill(worker, SIGKILL);
+                WaitForWorkers(&workers, shared);
+                DestroySharedRegion(&shared);
+                return false;
+            }
+            workers.push_back(pid);
+        }
+
+        const bool success = WaitForWorkers(&workers, shared);
+        const Progress& progress = *shared.progress;
+        const bool converged = success && progress.converged;
+        if (success)
+        {
+            std::copy(shared.result, shared.result + numCells, voltages.begin());
+            if (converged)
+                LOG("Performed %u iterations, max error: %e", (unsigned)progress.iteration, progress.maxErr);
+            else
+                LOG("Overran max iteration counter (%u), max error: %e", (unsigned)maxIter, progress.maxErr);
+        }
+
+        DestroySharedRegion(&shared);
+        return converged;
+    }
+}
@@ -0,0 +1,53 @@
+// -*- c++ -*-
+#if !defined(MULTIPROCESS_H)
+/* ==========================================================================
+   $File: MultiProcess.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define MULTIPROCESS_H
+// Distributed red-black SOR over several worker processes on one
+// host, so that each NUMA node streams its own slab of the grid
+// rather than one process saturating a single socket's memory bus
+
+#include "GlobalDefines.hpp"
+
+class Grid;
+
+namespace MultiProcess
+{
+    /// Returns the number of NUMA nodes on the machine, 1 if this
+    /// can't be determined
+    uint
+    NumNumaNodes();
+
+    /// The first argument the workers are started with, main hands
+    /// these invocations straight to WorkerMain
+    constexpr const char* WorkerFlag = "--multiprocess-worker";
+
+    /// Splits the grid into numProcesses horizontal slabs, each of
+    /// which is relaxed by red-black SOR in its own worker process.
+    /// The workers are fresh copies of the program (so each has its
+    /// own OpenMP team, sized to its share of the cpus), which attach
+    /// to the memory shared with this process. The halo rows are
+    /// exchanged through shared memory after every colour, and the
+    /// max relative change is reduced across the workers every check
+    /// interval (and the residual of the gathered grid measured, under
+    /// a residual criterion), so all the workers stop on the same
+    /// iteration. Supports all zip combinations. If the number of
+    /// processes matches the number of NUMA nodes each worker (and its
+    /// team) is pinned to its own node. Returns true if the workers
+    /// converged
+    bool
+    MultiProcessSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                       uint numProcesses);
+
+    /// Entry point of a worker process, started as "<program>
+    /// WorkerFlag <shared memory fd> <worker index>". Returns the exit
+    /// status
+    int
+    WorkerMain(const int argc, const char* argv[]);
+}
+#endif
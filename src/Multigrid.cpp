@@ -0,0 +1,494 @@
+/* ==========================================================================
+   $File: Multigrid.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Multigrid.hpp"
+#include "Convergence.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "RedBlack.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Multigrid
+{
+    /// Max number of threads to be used by OpenMP, as for the other
+    /// solvers
+    const uint MaxThreads = 30;
+
+    /// Number of red-black sweeps before and after the coarse grid
+    /// correction on each level
+    const uint PreSmoothSweeps = 2;
+    const uint PostSmoothSweeps = 2;
+
+    /// We stop coarsening once either dimension would drop below
+    /// this, the coarsest level is then just smoothed to death
+    const uint MinLevelSize = 5;
+    const uint MaxCoarsestSweeps = 1000;
+
+    /// One level of the hierarchy. On the finest level grid points to
+    /// the grid being solved, on the coarser levels it points to
+    /// ownedGrid, which holds the correction for the level above
+    /// (fixed points are restricted with value 0, as the correction
+    /// there is always 0).
+    struct Level
+    {
+        std::unique_ptr<Grid> ownedGrid;
+        Grid* grid;
+        Laplacian::CellGraph graph;
+        /// All non-fixed cells (interior then edge)
+        std::vector<uint> cells;
+        /// Checkerboard split of the non-fixed cells, and the same
+        /// with the order of the zipped edge cells reversed for the
+        /// reverse sweeps
+        RedBlack::ColouredCells red;
+        RedBlack::ColouredCells black;
+        RedBlack::ColouredCells reverseRed;
+        RedBlack::ColouredCells reverseBlack;
+        /// Right hand side scaled by h^2 for this level
+        std::vector<f64> rhs;
+        std::vector<f64> residual;
+    };
+
+    /// Copies a colour with the order of its zipped edge cells
+    /// reversed (the interior cells of a colour are independent, so
+    /// their order doesn't matter)
+    static
+    void
+    ReverseEdges(const RedBlack::ColouredCells& colour, RedBlack::ColouredCells* reversed)
+    {
+        reversed->interior = colour.interior;
+        reversed->edge.assign(colour.edge.rbegin(), colour.edge.rend());
+        reversed->edgeNeighbours.assign(colour.edgeNeighbours.rbegin(), colour.edgeNeighbours.rend());
+        reversed->edgeDiagonals.assign(colour.edgeDiagonals.rbegin(), colour.edgeDiagonals.rend());
+    }
+
+    /// Sets up the per-level work arrays once the graph is built
+    static
+    void
+    PrepareLevel(Level* level)
+    {
+        JasUnpack(level->graph, interior, edge, lineLength, numLines);
+
+        level->cells = interior;
+        level->cells.insert(level->cells.end(), edge.begin(), edge.end());
+        RedBlack::ColourCells(level->graph, &level->red, &level->black);
+        ReverseEdges(level->red, &level->reverseRed);
+        ReverseEdges(level->black, &level->reverseBlack);
+
+        level->rhs.assign(lineLength * numLines, 0.0);
+        level->residual.assign(lineLength * numLines, 0.0);
+    }
+
+    /// Creates the next coarser level from fine. Coarse cell (X, Y)
+    /// sits on fine cell (2X, 2Y), and is fixed if that cell or any
+    /// of its 4 neighbours are fixed, so that electrodes one pixel
+    /// thick don't vanish. Returns false if no useful level can be
+    /// made
+    static
+    bool
+    CoarsenLevel(const Level& fine, Level* coarse)
+    {
+        const Grid& fineGrid = *fine.grid;
+        JasUnpack(fineGrid, lineLength, numLines, horizZip, verticZip);
+        const auto& fixed = fine.graph.fixed;
+
+        const uint coarseLineLength = (lineLength + 1) / 2;
+        const uint coarseNumLines = (numLines + 1) / 2;
+        if (coarseLineLength < MinLevelSize || coarseNumLines < MinLevelSize)
+            return false;
+
+        coarse->ownedGrid = make_unique<Grid>(horizZip, verticZip);
+        coarse->grid = coarse->ownedGrid.get();
+        Grid& coarseGrid = *coarse->grid;
+        coarseGrid.lineLength = coarseLineLength;
+        coarseGrid.numLines = coarseNumLines;
+        coarseGrid.voltages.assign(coarseLineLength * coarseNumLines, 0.0);
+
+        // NOTE(Chris): Vertical zip joins the left and right edges,
+        // horizontal zip joins the top and bottom
+        const auto IsFineFixed = [&fixed, lineLength, numLines, horizZip, verticZip] (int x, int y) -> bool
+            {
+                if (x < 0 || x >= (int)lineLength)
+                {
+                    if (!verticZip)
+                        return false;
+                    x = (x < 0) ? lineLength - 1 : 0;
+                }
+                if (y < 0 || y >= (int)numLines)
+                {
+                    if (!horizZip)
+                        return false;
+                    y = (y < 0) ? numLines - 1 : 0;
+                }
+                return fixed[y * lineLength + x];
+            };
+
+        for (uint y = 0; y < coarseNumLines; ++y)
+            for (uint x = 0; x < coarseLineLength; ++x)
+            {
+                const int fx = 2 * x;
+                const int fy = 2 * y;
+                if (IsFineFixed(fx, fy)
+                    || IsFineFixed(fx - 1, fy) || IsFineFixed(fx + 1, fy)
+                    || IsFineFixed(fx, fy - 1) || IsFineFixed(fx, fy + 1))
+                {
+                    coarseGrid.AddFixedPoint(x, y, 0.0);
+                }
+            }
+
+        if (!Laplacian::BuildCellGraph(coarseGrid, &coarse->graph))
+            return false;
+
+        if (coarse->graph.NumUnknowns() == 0)
+            return false;
+
+        PrepareLevel(coarse);
+        return true;
+    }
+
+    /// Red-black Gauss-Seidel sweeps on A v = rhs, where A is the
+    /// 5-point Laplacian scaled by -h^2. Each colour is relaxed by
+    /// RedBlack::RelaxColour, interior then zipped edge cells. The
+    /// sweep order is red, black, or exactly the reverse if reverse is
+    /// set, so that a forward pre-smooth and reverse post-smooth leave
+    /// the cycle symmetric
+    static
+    void
+    Smooth(Level* level, const uint sweeps, const bool reverse)
+    {
+        auto* voltages = &level->grid->voltages;
+        const uint lineLength = level->graph.lineLength;
+        const auto& first = reverse ? level->reverseBlack : level->red;
+        const auto& second = reverse ? level->reverseRed : level->black;
+
+        for (uint s = 0; s < sweeps; ++s)
+        {
+            RedBlack::RelaxColour(voltages, lineLength, first, 1.0, false,
+                                  Cfg::StencilType::FivePoint, &level->rhs);
+            RedBlack::RelaxColour(voltages, lineLength, second, 1.0, false,
+                                  Cfg::StencilType::FivePoint, &level->rhs);
+        }
+    }
+
+    /// Stores rhs - A v in the level's residual for every non-fixed
+    /// cell. Fixed cells keep a residual of 0
+    static
+    void
+    ComputeResidual(Level* level)
+    {
+        const auto& voltages = level->grid->voltages;
+        JasUnpack((*level), rhs, residual);
+        JasUnpack(level->graph, lineLength, interior, edge, edgeNeighbours);
+
+#pragma omp parallel for default(none) shared(interior, voltages, rhs, residual, lineLength)
+        for (auto c = interior.begin(); c < interior.end(); ++c)
+        {
+            residual[*c] = rhs[*c] + voltages[*c + 1] + voltages[*c - 1]
+                + voltages[*c - lineLength] + voltages[*c + lineLength]
+                - 4.0 * voltages[*c];
+        }
+
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const auto& n = edgeNeighbours[e];
+            residual[edge[e]] = rhs[edge[e]] + voltages[n[0]] + voltages[n[1]]
+                + voltages[n[2]] + voltages[n[3]] - 4.0 * voltages[edge[e]];
+        }
+    }
+
+    /// Full weighting restriction of the fine residual into the
+    /// coarse right hand side. The factor of 4 accounts for the
+    /// doubled cell size in the h^2 scaling
+    static
+    void
+    Restrict(const Level& fine, Level* coarse)
+    {
+        const Grid& fineGrid = *fine.grid;
+        JasUnpack(fineGrid, lineLength, numLines, horizZip, verticZip);
+        const auto& residual = fine.residual;
+        const uint coarseLineLength = coarse->graph.lineLength;
+        const auto& cells = coarse->cells;
+        auto& rhs = coarse->rhs;
+
+        // Returns the fine residual at (x, y), wrapping where zipped
+        // and 0 outside the grid otherwise
+        const auto FineResidual = [&residual, lineLength, numLines, horizZip, verticZip] (int x, int y) -> f64
+            {
+                if (x < 0 || x >= (int)lineLength)
+                {
+                    if (!verticZip)
+                        return 0.0;
+                    x = (x < 0) ? lineLength - 1 : 0;
+                }
+                if (y < 0 || y >= (int)numLines)
+                {
+                    if (!horizZip)
+                        return 0.0;
+                    y = (y < 0) ? numLines - 1 : 0;
+                }
+                return residual[y * lineLength + x];
+            };
+
+#pragma omp parallel for default(none) shared(cells, rhs, coarseLineLength, FineResidual)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            const int fx = 2 * (*c % coarseLineLength);
+            const int fy = 2 * (*c / coarseLineLength);
+
+            const f64 centre = FineResidual(fx, fy);
+            const f64 sides = FineResidual(fx - 1, fy) + FineResidual(fx + 1, fy)
+                + FineResidual(fx, fy - 1) + FineResidual(fx, fy + 1);
+            const f64 corners = FineResidual(fx - 1, fy - 1) + FineResidual(fx + 1, fy - 1)
+                + FineResidual(fx - 1, fy + 1) + FineResidual(fx + 1, fy + 1);
+
+            // 4 * (4 centre + 2 sides + corners) / 16
+            rhs[*c] = 0.25 * (4.0 * centre + 2.0 * sides + corners);
+        }
+    }
+
+    /// Bilinearly interpolates the coarse correction and adds it to
+    /// the non-fixed cells of the fine level
+    static
+    void
+    ProlongateAndCorrect(const Level& coarse, Level* fine)
+    {
+        const Grid& coarseGrid = *coarse.grid;
+        JasUnpack(coarseGrid, lineLength, numLines, horizZip, verticZip);
+        const auto& correction = coarseGrid.voltages;
+        auto& voltages = fine->grid->voltages;
+        const uint fineLineLength = fine->graph.lineLength;
+        const auto& cells = fine->cells;
+
+        // Coarse correction at (x, y), wrapping where zipped, 0
+        // outside the grid otherwise (the fixed cells already hold 0)
+        const auto Correction = [&correction, lineLength, numLines, horizZip, verticZip] (uint x, uint y) -> f64
+            {
+                if (x >= lineLength)
+                {
+                    if (!verticZip)
+                        return 0.0;
+                    x = 0;
+                }
+                if (y >= numLines)
+                {
+                    if (!horizZip)
+                        return 0.0;
+                    y = 0;
+                }
+                return correction[y * lineLength + x];
+            };
+
+#pragma omp parallel for default(none) shared(cells, voltages, fineLineLength, Correction)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            const uint fx = *c % fineLineLength;
+            const uint fy = *c / fineLineLength;
+            const uint x = fx / 2;
+            const uint y = fy / 2;
+
+            f64 corr = Correction(x, y);
+            if ((fx & 1) && (fy & 1))
+            {
+                corr = 0.25 * (corr + Correction(x + 1, y)
+                               + Correction(x, y + 1) + Correction(x + 1, y + 1));
+            }
+            else if (fx & 1)
+            {
+                corr = 0.5 * (corr + Correction(x + 1, y));
+            }
+            else if (fy & 1)
+            {
+                corr = 0.5 * (corr + Correction(x, y + 1));
+            }
+
+            voltages[*c] += corr;
+        }
+    }
+
+    /// Recursive multigrid cycle starting at level l, improving the
+    /// correction held on that level
+    static
+    void
+    Cycle(std::vector<Level>* levels, const uint l, const uint cycleIndex)
+    {
+        Level& level = (*levels)[l];
+
+        if (l + 1 == levels->size())
+        {
+            const uint maxDim = std::max(level.graph.lineLength, level.graph.numLines);
+            const uint sweeps = std::max(std::min(Square(maxDim), MaxCoarsestSweeps) / 2, 1U);
+            for (uint s = 0; s < sweeps; ++s)
+            {
+                Smooth(&level, 1, false);
+                Smooth(&level, 1, true);
+            }
+            return;
+        }
+
+        Level& coarse = (*levels)[l + 1];
+
+        Smooth(&level, PreSmoothSweeps, false);
+        ComputeResidual(&level);
+        Restrict(level, &coarse);
+
+        std::fill(coarse.grid->voltages.begin(), coarse.grid->voltages.end(), 0.0);
+        for (uint i = 0; i < cycleIndex; ++i)
+        {
+            Cycle(levels, l + 1, cycleIndex);
+        }
+
+        ProlongateAndCorrect(coarse, &level);
+        Smooth(&level, PostSmoothSweeps, true);
+    }
+
+    bool
+    MultigridSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                    bool parallel, const uint cycleIndex)
+    {
+        TIME_FUNCTION();
+
+        // NOTE(Chris): Every level is a correction scheme level, the
+        // finest solves A e = r for the residual of the grid, and
+        // each coarser level solves for the restricted residual of
+        // the one above, all with the fixed points held at 0. The
+        // rediscretised coarse levels can only approximate the
+        // electrode shapes (and lose a cell at the edge of even sized
+        // grids), which on its own costs us a lot of cycles on our
+        // images. So the cycle is used as a (symmetric)
+        // preconditioner for conjugate gradients, which mops up the
+        // few modes the coarse grids get wrong and keeps the number
+        // of cycles flat as the grids grow.
+
+        std::vector<Level> levels(1);
+        levels[0].ownedGrid = make_unique<Grid>(grid->horizZip, grid->verticZip);
+        levels[0].grid = levels[0].ownedGrid.get();
+        {
+            Grid& correction = *levels[0].grid;
+            correction.lineLength = grid->lineLength;
+            correction.numLines = grid->numLines;
+            correction.fixedPoints = grid->fixedPoints;
+            correction.voltages.assign(grid->voltages.size(), 0.0);
+        }
+        if (!Laplacian::BuildCellGraph(*levels[0].grid, &levels[0].graph))
+            return false;
+        PrepareLevel(&levels[0]);
+
+        if (levels[0].graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        while (true)
+        {
+            Level coarse;
+            if (!CoarsenLevel(levels.back(), &coarse))
+                break;
+            levels.push_back(std::move(coarse));
+        }
+
+        const uint numCells = grid->voltages.size();
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        omp_set_num_threads(parallel ? numThreads : 1);
+
+        LOG("Multigrid with %u levels (coarsest %u x %u), %s-cycle, num threads %u",
+            (unsigned)levels.size(), levels.back().graph.lineLength, levels.back().graph.numLines,
+            cycleIndex == 1 ? "V" : "W", parallel ? numThreads : 1);
+
+        Level& fine = levels[0];
+        const auto& cells = fine.cells;
+        auto& voltages = grid->voltages;
+        // NOTE(Chris): The residual lives in the finest level's rhs
+        // and the preconditioned residual is the correction the cycle
+        // leaves in that level's grid
+        auto& residual = fine.rhs;
+        auto& precond = fine.grid->voltages;
+        std::vector<f64> search(numCells, 0.0);
+        std::vector<f64> product(numCells, 0.0);
+
+        Laplacian::ApplyLaplacian(fine.graph, voltages, &product);
+#pragma omp parallel for default(none) shared(cells, residual, product)
+        for (auto c = cells.begin(); c < cells.end(); ++c)
+        {
+            residual[*c] = -product[*c];
+        }
+
+        std::fill(precond.begin(), precond.end(), 0.0);
+        Cycle(&levels, 0, cycleIndex);
+        f64 rDotZ = Laplacian::Dot(cells, residual, precond);
+        search = precond;
+
+        // NOTE(Chris): The residual the CG recurrence maintains is of
+        // the Laplacian, not the Jacobi form the criteria are defined
+        // on, so the monitor measures it from the voltages like it
+        // does for the relaxation solvers
+        const Convergence::Monitor monitor(*grid);
+        const char* criterion = Convergence::CriterionName(Convergence::ActiveCriterion());
+
+        f64 maxErr = 0.0;
+        for (u64 i = 1; i <= maxIter; ++i)
+        {
+            Laplacian::ApplyLaplacian(fine.graph, search, &product);
+            const f64 pDotAp = Laplacian::Dot(cells, search, product);
+            if (pDotAp == 0.0)
+            {
+                LOG("Converged exactly after %u cycles", (unsigned)i - 1);
+                return true;
+            }
+            const f64 alpha = rDotZ / pDotAp;
+
+            maxErr = 0.0;
+#pragma omp parallel for default(none) shared(cells, voltages, residual, search, product, alpha) reduction(max:maxErr)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                const f64 step = alpha * search[*c];
+                voltages[*c] += step;
+                residual[*c] -= alpha * product[*c];
+
+                // NOTE(Chris): Cells that are exactly 0 (e.g. grounded
+                // regions, or the symmetry line between opposite
+                // electrodes) would give NaN or inf here, use the
+                // absolute change for these
+                const f64 absErr = (voltages[*c] != 0.0) ? std::abs(step / voltages[*c]) : std::abs(step);
+                if (absErr > maxErr)
+                {
+                    maxErr = absErr;
+                }
+            }
+
+            if (monitor.UsesResidual())
+                maxErr = monitor.Measure(voltages, maxErr);
+
+            if (maxErr < zeroTol)
+            {
+                LOG("Performed %u cycles, max error: %e", (unsigned)i, maxErr);
+                return true;
+            }
+            LOG("After %u cycles, %s %e", (unsigned)i, criterion, maxErr);
+
+            std::fill(precond.begin(), precond.end(), 0.0);
+            Cycle(&levels, 0, cycleIndex);
+            const f64 newRDotZ = Laplacian::Dot(cells, residual, precond);
+            const f64 beta = newRDotZ / rDotZ;
+            rDotZ = newRDotZ;
+
+#pragma omp parallel for default(none) shared(cells, search, precond, beta)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                search[*c] = precond[*c] + beta * search[*c];
+            }
+        }
+        LOG("Overran max iteration counter (%u), max error: %e", (unsigned)maxIter, maxErr);
+        return false;
+    }
+}
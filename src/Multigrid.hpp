@@ -0,0 +1,31 @@
+// -*- c++ -*-
+#if !defined(MULTIGRID_H)
+/* ==========================================================================
+   $File: Multigrid.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define MULTIGRID_H
+
+#include "GlobalDefines.hpp"
+
+class Grid;
+
+namespace Multigrid
+{
+    /// Solves the Grid using geometric multigrid cycles with a
+    /// red-black Gauss-Seidel smoother, accelerated by conjugate
+    /// gradients. cycleIndex is the number of coarse grid corrections
+    /// per level, i.e. 1 for a V-cycle and 2 for a W-cycle. maxIter
+    /// limits the number of cycles. The stopping criterion is the
+    /// active Convergence criterion, checked after every cycle; under
+    /// RelativeChange zeroTol is the max relative change of a cell over
+    /// a cycle (absolute for cells that are 0). Returns true if it
+    /// converged
+    bool
+    MultigridSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                    bool parallel = true, const uint cycleIndex = 1);
+}
+#endif
@@ -248,7 +248,7 @@ GnuplotString(const std::string& data)
 /// files.
 static
 bool
-PlotSingleSim(const Plot::PlottableGrids& grids)
+PlotSingleSim(const Plot::PlottableGrids& grids, const std::string& prefix)
 {
     TIME_FUNCTION();
     // expects the first two plottable grids
@@ -256,7 +256,13 @@ PlotSingleSim(const Plot::PlottableGrids& grids)
         return false;
     // NOTE(Chris): These assume that everything works
 
-    using namespace Plot::SingleSimFiles;
+    const std::string gridName = prefix + Plot::SingleSimFiles::gridPlot;
+    const std::string contourName = prefix + Plot::SingleSimFiles::contourPlot;
+    const std::string vectorName = prefix + Plot::SingleSimFiles::vectorPlot;
+    const char* gridPlot = gridName.c_str();
+    const char* contourPlot = contourName.c_str();
+    const char* vectorPlot = vectorName.c_str();
+
     std::string gpStr;
     gpStr += PlotColorMapString(*grids.singleSimGrid, gridPlot, "Stable Voltage (V)");
     gpStr += PlotContourMapString(*grids.singleSimGrid, contourPlot, "Stable Voltage (V)");
@@ -277,7 +283,7 @@ PlotSingleSim(const Plot::PlottableGrids& grids)
 /// Also logs the output files.
 static
 bool
-PlotCompareProb(const Plot::PlottableGrids& grids)
+PlotCompareProb(const Plot::PlottableGrids& grids, const std::string& prefix)
 {
     TIME_FUNCTION();
     // expects all plottable grids
@@ -289,7 +295,22 @@ PlotCompareProb(const Plot::PlottableGrids& grids)
         return false;
     // NOTE(Chris): These assume that everything works
 
-    using namespace Plot::CompareProbFiles;
+    namespace Files = Plot::CompareProbFiles;
+    const std::string gridName = prefix + Files::gridPlot;
+    const std::string contourName = prefix + Files::contourPlot;
+    const std::string vectorName = prefix + Files::vectorPlot;
+    const std::string gridAnalyticName = prefix + Files::gridAnalyticPlot;
+    const std::string contourAnalyticName = prefix + Files::contourAnalyticPlot;
+    const std::string vectorAnalyticName = prefix + Files::vectorAnalyticPlot;
+    const std::string differenceName = prefix + Files::differencePlot;
+    const char* gridPlot = gridName.c_str();
+    const char* contourPlot = contourName.c_str();
+    const char* vectorPlot = vectorName.c_str();
+    const char* gridAnalyticPlot = gridAnalyticName.c_str();
+    const char* contourAnalyticPlot = contourAnalyticName.c_str();
+    const char* vectorAnalyticPlot = vectorAnalyticName.c_str();
+    const char* differencePlot = differenceName.c_str();
+
     std::string gpStr;
     gpStr += PlotColorMapString(*grids.singleSimGrid, gridPlot, "Stable Voltage (V)");
     gpStr += PlotContourMapString(*grids.singleSimGrid, contourPlot, "Stable Voltage (V)");
@@ -321,7 +342,7 @@ PlotCompareProb(const Plot::PlottableGrids& grids)
 /// files.
 static
 bool
-PlotCompareTwo(const Plot::PlottableGrids& grids)
+PlotCompareTwo(const Plot::PlottableGrids& grids, const std::string& prefix)
 {
     TIME_FUNCTION();
     // expects all plottable grids
@@ -332,7 +353,21 @@ PlotCompareTwo(const Plot::PlottableGrids& grids)
         || !grids.difference)
         return false;
 
-    using namespace Plot::CompareTwoFiles;
+    namespace Files = Plot::CompareTwoFiles;
+    const std::string gridOneName = prefix + Files::gridOnePlot;
+    const std::string contourOneName = prefix + Files::contourOnePlot;
+    const std::string vectorOneName = prefix + Files::vectorOnePlot;
+    const std::string gridTwoName = prefix + Files::gridTwoPlot;
+    const std::string contourTwoName = prefix + Files::contourTwoPlot;
+    const std::string vectorTwoName = prefix + Files::vectorTwoPlot;
+    const std::string differenceName = prefix + Files::differencePlot;
+    const char* gridOnePlot = gridOneName.c_str();
+    const char* contourOnePlot = contourOneName.c_str();
+    const char* vectorOnePlot = vectorOneName.c_str();
+    const char* gridTwoPlot = gridTwoName.c_str();
+    const char* contourTwoPlot = contourTwoName.c_str();
+    const char* vectorTwoPlot = vectorTwoName.c_str();
+    const char* differencePlot = differenceName.c_str();
 
     std::string gpStr;
     gpStr += PlotColorMapString(*grids.singleSimGrid, gridOnePlot, "Stable Voltage (V)");
@@ -364,7 +399,8 @@ namespace Plot
 {
     bool
     WritePlotFiles(const PlottableGrids& grids,
-                   const Cfg::OperationMode mode)
+                   const Cfg::OperationMode mode,
+                   const std::string& prefix)
     {
         // NOTE(Chris): Dispatch to the correct solver
         using Cfg::OperationMode;
@@ -373,19 +409,19 @@ namespace Plot
         {
         case OperationMode::SingleSimulation:
         {
-            result = PlotSingleSim(grids);
+            result = PlotSingleSim(grids, prefix);
         } break;
 
         case OperationMode::CompareProblem0:
             // FALL THROUGH
         case OperationMode::CompareProblem1:
         {
-            result = PlotCompareProb(grids);
+            result = PlotCompareProb(grids, prefix);
         } break;
 
         case OperationMode::CompareTwo:
         {
-            result = PlotCompareTwo(grids);
+            result = PlotCompareTwo(grids, prefix);
         } break;
 
         default:
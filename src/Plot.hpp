@@ -64,10 +64,13 @@ namespace Plot
     };
 
     /// Uses gnuplot to produce the plots based on the on the provided
-    /// plots and mode. Returns true on success
+    /// plots and mode. prefix is prepended to the names of the output
+    /// files, so the plots of several simulations in a batch don't
+    /// overwrite each other. Returns true on success
     bool
     WritePlotFiles(const PlottableGrids& grids,
-                   const Cfg::OperationMode mode);
+                   const Cfg::OperationMode mode,
+                   const std::string& prefix = "");
 
 }
 #endif
@@ -0,0 +1,314 @@
+/* ==========================================================================
+   $File: Preconditioner.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Preconditioner.hpp"
+#include "AMG.hpp"
+#include "SweepEngine.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Precond
+{
+    /// The non-fixed cells in grid index order (the natural ordering
+    /// of the system) with their neighbours. Neighbours that are fixed
+    /// are kept, as the vectors are 0 there
+    struct OrderedCells
+    {
+        std::vector<uint> cells;
+        std::vector<Laplacian::Neighbours> neighbours;
+    };
+
+    static
+    OrderedCells
+    OrderCells(const Laplacian::CellGraph& graph)
+    {
+        JasUnpack(graph, lineLength, interior, edge, edgeNeighbours);
+
+        OrderedCells result;
+        result.cells.reserve(graph.NumUnknowns());
+        result.neighbours.reserve(graph.NumUnknowns());
+
+        // NOTE(Chris): Both lists are already sorted, so merge them
+        uint i = 0;
+        uint e = 0;
+        while (i < interior.size() || e < edge.size())
+        {
+            if (e == edge.size() || (i < interior.size() && interior[i] < edge[e]))
+            {
+                const uint c = interior[i++];
+                result.cells.push_back(c);
+                result.neighbours.push_back(Laplacian::Neighbours{{ c - 1, c + 1,
+                                                                    c - lineLength,
+                                                                    c + lineLength }});
+            }
+            else
+            {
+                result.cells.push_back(edge[e]);
+                result.neighbours.push_back(edgeNeighbours[e]);
+                ++e;
+            }
+        }
+        return result;
+    }
+
+    /// Symmetric SOR: one forward and one backward SOR sweep on A z = r
+    /// from z = 0, with the in place sweeps of the SOR solver (see
+    /// SweepEngine.hpp) and r as their source term. The forward sweep
+    /// takes the interior cells in order and then the zipped edge
+    /// cells, the backward sweep exactly the reverse
+    class SSOR : public Preconditioner
+    {
+    public:
+        SSOR(const Laplacian::CellGraph& graph) :
+            graph(graph),
+            reverseInterior(graph.interior.rbegin(), graph.interior.rend()),
+            reverseEdge(graph.edge.rbegin(), graph.edge.rend()),
+            reverseEdgeNeighbours(graph.edgeNeighbours.rbegin(), graph.edgeNeighbours.rend())
+        {
+            // NOTE(Chris): Optimal w for SSOR on the model problem,
+            // from the Jacobi spectral radius of the box
+            const f64 rhoJacobi = 0.5 * (std::cos(M_PI / (f64)(graph.lineLength - 1))
+                                         + std::cos(M_PI / (f64)(graph.numLines - 1)));
+            w = 2.0 / (1.0 + std::sqrt(2.0 * (1.0 - rhoJacobi)));
+        }
+
+        void
+        Apply(const std::vector<f64>& r, std::vector<f64>* result) const override
+        {
+            JasUnpack(graph, interior, edge, lineLength);
+            auto& z = *result;
+
+            for (const auto c : interior)
+            {
+                z[c] = 0.0;
+            }
+            for (const auto c : edge)
+            {
+                z[c] = 0.0;
+            }
+
+            // NOTE(Chris): The diagonals are only read by the 9-point
+            // stencil
+            Sweep::Cells forward(graph);
+            Sweep::Cells backward(reverseInterior, reverseEdge, reverseEdgeNeighbours,
+                                  noDiagonals, lineLength);
+            forward.source = r.data();
+            backward.source = r.data();
+
+            f64* v = z.data();
+            Sweep::RelaxRange<Sweep::SOR, Sweep::FivePoint, Sweep::NoError>(v, v, interior.data(),
+                                                                            interior.data() + interior.size(),
+                                                                            lineLength, w, r.data());
+            Sweep::RelaxEdges<Sweep::SOR, Sweep::FivePoint, Sweep::Zip, Sweep::NoError>(v, v, forward, w);
+
+            Sweep::RelaxEdges<Sweep::SOR, Sweep::FivePoint, Sweep::Zip, Sweep::NoError>(v, v, backward, w);
+            Sweep::RelaxRange<Sweep::SOR, Sweep::FivePoint, Sweep::NoError>(v, v, reverseInterior.data(),
+                                                                            reverseInterior.data()
+                                                                            + reverseInterior.size(),
+                                                                            lineLength, w, r.data());
+        }
+
+        const char*
+        Name() const override
+        {
+            return "SSOR";
+        }
+
+    private:
+        const Laplacian::CellGraph& graph;
+        std::vector<uint> reverseInterior;
+        std::vector<uint> reverseEdge;
+        std::vector<Laplacian::Neighbours> reverseEdgeNeighbours;
+        const std::vector<Laplacian::Neighbours> noDiagonals;
+        f64 w;
+    };
+
+    /// Zero-fill incomplete Cholesky in the natural ordering. For the
+    /// 5-point stencil the off-diagonal entries of the factor are
+    /// those of A, so only the diagonal D needs to be stored, and M =
+    /// (D + L) D^-1 (D + L^T)
+    class IncompleteCholesky : public Preconditioner
+    {
+    public:
+        IncompleteCholesky(const Laplacian::CellGraph& graph) :
+            order(OrderCells(graph)),
+            diag(graph.lineLength * graph.numLines, 0.0)
+        {
+            JasUnpack(order, cells, neighbours);
+            const auto& fixed = graph.fixed;
+
+            // d_i = a_ii - sum_{j < i} a_ij^2 / d_j, with a_ij = -1
+            for (uint k = 0; k < cells.size(); ++k)
+            {
+                const uint c = cells[k];
+                f64 d = 4.0;
+                for (const auto n : neighbours[k])
+                {
+                    if (n < c && !fixed[n])
+                    {
+                        d -= 1.0 / diag[n];
+                    }
+                }
+                diag[c] = d;
+            }
+        }
+
+        void
+        Apply(const std::vector<f64>& r, std::vector<f64>* result) const override
+        {
+            JasUnpack(order, cells, neighbours);
+            auto& z = *result;
+
+            // Forward solve (D + L) y = r, y is held in z. Neighbours
+            // later in the ordering are still 0 here
+            for (const auto c : cells)
+            {
+                z[c] = 0.0;
+            }
+            for (uint k = 0; k < cells.size(); ++k)
+            {
+                const uint c = cells[k];
+                const auto& n = neighbours[k];
+                z[c] = (r[c] + z[n[0]] + z[n[1]] + z[n[2]] + z[n[3]]) / diag[c];
+            }
+
+            // Backward solve (D + L^T) z = D y
+            for (uint k = cells.size(); k-- > 0; )
+            {
+                const uint c = cells[k];
+                f64 upper = 0.0;
+                for (const auto n : neighbours[k])
+                {
+                    if (n > c)
+                    {
+                        upper += z[n];
+                    }
+                }
+                z[c] += upper / diag[c];
+            }
+        }
+
+        const char*
+        Name() const override
+        {
+            return "IC(0)";
+        }
+
+    private:
+        OrderedCells order;
+        std::vector<f64> diag;
+    };
+
+    /// Symmetric Gauss-Seidel in the red-black ordering: red, black,
+    /// edge, then edge, black, red. The colours are updated in
+    /// parallel, as in RedBlackCells
+    class RedBlackSymmetric : public Preconditioner
+    {
+    public:
+        RedBlackSymmetric(const Laplacian::CellGraph& graph) :
+            graph(graph)
+        {
+            Laplacian::SplitRedBlack(graph.interior, graph.lineLength, &red, &black);
+        }
+
+        void
+        Apply(const std::vector<f64>& r, std::vector<f64>* result) const override
+        {
+            auto& z = *result;
+            const auto& edge = graph.edge;
+
+            for (const auto c : edge)
+            {
+                z[c] = 0.0;
+            }
+
+            // From z = 0 the first red update only sees the rhs
+#pragma omp parallel for default(none) shared(z, r)
+            for (auto c = red.begin(); c < red.end(); ++c)
+            {
+                z[*c] = 0.25 * r[*c];
+            }
+            UpdateColour(black, r, &z);
+
+            for (uint e = 0; e < edge.size(); ++e)
+            {
+                UpdateEdge(e, r, &z);
+            }
+            for (uint e = edge.size(); e-- > 0; )
+            {
+                UpdateEdge(e, r, &z);
+            }
+
+            // NOTE(Chris): The backward black sweep would recompute
+            // exactly the same values unless there are edge cells
+            if (!edge.empty())
+            {
+                UpdateColour(black, r, &z);
+            }
+            UpdateColour(red, r, &z);
+        }
+
+        const char*
+        Name() const override
+        {
+            return "Red-black symmetric Gauss-Seidel";
+        }
+
+    private:
+        void
+        UpdateColour(const std::vector<uint>& cells, const std::vector<f64>& r,
+                     std::vector<f64>* result) const
+        {
+            auto& z = *result;
+            const uint lineLength = graph.lineLength;
+#pragma omp parallel for default(none) shared(cells, z, r, lineLength)
+            for (auto c = cells.begin(); c < cells.end(); ++c)
+            {
+                z[*c] = 0.25 * (r[*c] + z[*c - 1] + z[*c + 1]
+                                + z[*c - lineLength] + z[*c + lineLength]);
+            }
+        }
+
+        void
+        UpdateEdge(const uint e, const std::vector<f64>& r, std::vector<f64>* result) const
+        {
+            auto& z = *result;
+            const uint c = graph.edge[e];
+            const auto& n = graph.edgeNeighbours[e];
+            z[c] = 0.25 * (r[c] + z[n[0]] + z[n[1]] + z[n[2]] + z[n[3]]);
+        }
+
+        const Laplacian::CellGraph& graph;
+        std::vector<uint> red;
+        std::vector<uint> black;
+    };
+
+    std::unique_ptr<Preconditioner>
+    MakePreconditioner(const Cfg::Preconditioner type,
+                       const Laplacian::CellGraph& graph)
+    {
+        switch (type)
+        {
+        case Cfg::Preconditioner::SSOR:
+            return make_unique<SSOR>(graph);
+
+        case Cfg::Preconditioner::IncompleteCholesky:
+            return make_unique<IncompleteCholesky>(graph);
+
+        case Cfg::Preconditioner::RedBlack:
+            return make_unique<RedBlackSymmetric>(graph);
+
+        case Cfg::Preconditioner::AlgebraicMultigrid:
+            return AMG::MakeAMGPreconditioner(graph);
+
+        case Cfg::Preconditioner::None:
+        default:
+            return nullptr;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+// -*- c++ -*-
+#if !defined(PRECONDITIONER_H)
+/* ==========================================================================
+   $File: Preconditioner.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define PRECONDITIONER_H
+// Preconditioners for the Krylov solvers, all working on the vectors
+// of the non-fixed cells stored in the grid layout
+
+#include "GlobalDefines.hpp"
+#include "JSON.hpp"
+#include "Laplacian.hpp"
+#include <memory>
+#include <vector>
+
+namespace Precond
+{
+    /// Interface for a preconditioner M of the Laplace system on a
+    /// CellGraph. The preconditioners must be symmetric positive
+    /// definite for use with CG
+    class Preconditioner
+    {
+    public:
+        virtual ~Preconditioner() {}
+
+        /// Computes z = M^-1 r on the non-fixed cells. z must be 0 on
+        /// the fixed cells, and is left that way
+        virtual void
+        Apply(const std::vector<f64>& r, std::vector<f64>* z) const = 0;
+
+        /// Name for the logs
+        virtual const char*
+        Name() const = 0;
+    };
+
+    /// Returns the preconditioner of the requested type for the
+    /// graph, or nullptr for Cfg::Preconditioner::None. The graph must
+    /// outlive the preconditioner
+    std::unique_ptr<Preconditioner>
+    MakePreconditioner(const Cfg::Preconditioner type,
+                       const Laplacian::CellGraph& graph);
+}
+#endif
@@ -5,11 +5,15 @@
    $License: MIT: http://opensource.org/licenses/MIT $
    ========================================================================== */
 #include "RedBlack.hpp"
+#include "Checkerboard.hpp"
 #include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "SpectralRadius.hpp"
+#include "Stencil.hpp"
+#include "SweepEngine.hpp"
 #include "Utility.hpp"
 
 #include <cmath>
-#include <atomic>
 #include <algorithm>
 
 // #include <xmmintrin.h>
@@ -27,844 +31,585 @@ namespace RedBlack
     /// Obviously this only applies to the parallel functions
     const uint MaxThreads = 30;
 
-    /// Holds the 3 vectors of points to be zipped to pass to the
-    /// functions that handle zipping
-    struct PreprocessedGridZips
-    {
-        typedef std::vector<std::pair<uint, uint> >  VecZip;
-        PreprocessedGridZips(VecZip&& h, VecZip&& v, VecZip&& hv)
-            : hZip(std::move(h)),
-              vZip(std::move(v)),
-              hvZip(std::move(hv))
-        {}
-        PreprocessedGridZips() = delete;
-        const VecZip hZip;
-        const VecZip vZip;
-        const VecZip hvZip;
-    };
-
-    /// Data type to hold the two stop conditions (we stop on
-    /// whichever comes first)
-    struct StopParams
-    {
-        const f64 zeroTol;
-        const u64 maxIter;
-        StopParams(f64 _zeroTol, u64 _maxIter) : zeroTol(_zeroTol), maxIter(_maxIter) {}
-    };
-
-    /// Multi-threaded implementation of the finite difference method
-    /// not taking into account the outer-most row/column (thus these
-    /// points will need to be fixed and zipping is not enabled). It
-    /// is recommended to use the disptach function to call this
-    /// function after verifying its appropriateness
-    static
-    void
-    RedBlackParaNoZip(Grid* grid, const std::vector<uint>& redPts, const std::vector<uint>& blkPts, const StopParams& stop)
-    {
-        // NOTE(Chris): Multi-threaded variant
+    using Sweep::StopParams;
 
-        // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
-        // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
-        //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
-        // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
+/// The in place sweep over one colour for the dispatch table
+template <typename Threads, typename Points, typename Zip, typename Err>
+using ColourSweep = Sweep::Simultaneous<Threads, Sweep::GaussSeidel, Points, Zip, Err>;
 
-        // NOTE(Chris): We never write to the fixed points, so we don't
-        // need to re-set them (as long as they were set properly in the
-        // incoming grid using AddFixedPoint)
-
-        JasUnpack((*grid), voltages, numLines, lineLength);
-
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
-
-        // Hand-waving 10k iterations per thread as minimum to not be dominated by context switches etc.
-        const uint numWorkChunks = (voltages.size() / 20000 > 0) ? (voltages.size() / 20000) : 1;
-        const uint numThreads = (numWorkChunks > omp_get_max_threads())
-            ? ((MaxThreads > omp_get_max_threads())
-               ? omp_get_max_threads()
-               : MaxThreads)
-            : numWorkChunks;
-
-        omp_set_num_threads(numThreads);
-
-        LOG("Num threads %u", numThreads);
+/// Red-black Gauss-Seidel over the lists of each colour's cells. Each
+/// iteration updates all of the red cells, then all of the black
+/// cells, which only depend on each other, so each colour is split
+/// between the threads. The zipped edge cells of each colour follow
+/// its interior. With the 9-point stencil the same is done over the
+/// four colours of FourColourCells. The sweep for the stencil, zips
+/// and threading is picked from the dispatch table once
+static
+bool
+RedBlackCells(Grid* grid, const Laplacian::CellGraph& graph, const StopParams& stop, bool parallel,
+              bool anderson)
+{
+    JasUnpack((*grid), voltages, lineLength);
 
-        // Atomic value for concurrent multi-threaded access
-        std::atomic<f64> maxErr(0.0);
+    const Cfg::StencilType stencil = Laplacian::ActiveStencil();
+    std::vector<ColouredCells> colours;
+    if (stencil == Cfg::StencilType::NinePoint)
+    {
+        FourColourCells(graph, &colours);
+    }
+    else
+    {
+        colours.resize(2);
+        ColourCells(graph, &colours[0], &colours[1]);
+    }
 
-        // Main loop - start with 1 so as not to take slow path on first iter
-        for (u64 i = 1; i <= stop.maxIter; ++i)
-        {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            // const ref to avoid damage again
+    std::vector<Sweep::Cells> colourCells;
+    colourCells.reserve(colours.size());
+    for (const auto& colour : colours)
+        colourCells.emplace_back(colour.interior, colour.edge, colour.edgeNeighbours,
+                                 colour.edgeDiagonals, lineLength);
+
+    const bool zip = !graph.edge.empty();
+    const auto sweep = Sweep::Dispatch<ColourSweep>::Select(parallel, zip, false, stencil);
+    const auto sweepErr = Sweep::Dispatch<ColourSweep>::Select(parallel, zip, true, stencil);
+
+    const auto accel = Sweep::MakeAccelerator(anderson, Sweep::Unknowns(graph), &voltages);
+    f64* v = voltages.data();
+    return Sweep::Run([v, &colourCells, sweep, sweepErr] (bool computeErr)
+                      {
+                          const auto relax = computeErr ? sweepErr : sweep;
+                          f64 maxErr = 0.0;
+                          for (const auto& cells : colourCells)
+                              maxErr = std::max(maxErr, relax(v, v, cells, 1.0));
+                          return maxErr;
+                      },
+                      [&voltages] () -> const std::vector<f64>&
+                      {
+                          return voltages;
+                      }, stop, Sweep::Checks::Fixed, Sweep::Accelerate(accel.get(), &voltages));
+}
 
-            if (unlikely(i % errorChunk == 0))
-            {
-                maxErr = 0.0;
-
-#pragma omp parallel for default(none) shared(redPts, lineLength, voltages, maxErr)
-                for (auto c = redPts.begin(); c < redPts.end(); ++c)
-                {
-                    const f64 prev = voltages[*c];
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    const f64 currentMax =  maxErr.load();
-                    if (absErr > currentMax)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-#pragma omp parallel for default(none) shared(blkPts, lineLength, voltages, maxErr)
-                for (auto c = blkPts.begin(); c < blkPts.end(); ++c)
-                {
-                    const f64 prev = voltages[*c];
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    if (absErr > maxErr)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %e", (unsigned)i, maxErr.load());
-                    return;
-                }
-
-                // NOTE(Chris): Report error every 5000 iterations
-                if (i % 5000 == 0)
-                {
-                    // If this is calculated near the beginning it tends
-                    // to overshoot, go to a quarter to refine the counter
-                    // (we use a modulo anyway so it will still stop at
-                    // the prediction)
-                    LOG("Relative change after %u iterations %f", (unsigned)i, maxErr.load());
-                }
-            }
-            else // normal path
-            {
 
-#pragma omp parallel for default(none) shared(redPts, lineLength, voltages)
-                for (auto c = redPts.begin(); c < redPts.end(); ++c)
-                {
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-                }
-
-#pragma omp parallel for default(none) shared(blkPts, lineLength, voltages)
-                for (auto c = blkPts.begin(); c < blkPts.end(); ++c)
-                {
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-                }
-            }
-        }
+/// Red-black SOR with Chebyshev acceleration, handles both the
+/// zipped and non-zipped cases. Rather than a fixed w, every
+/// half-sweep (one colour) uses the next w of the Chebyshev
+/// recurrence for the Jacobi spectral radius rho:
+/// w_0 = 1, w_1/2 = 1/(1 - rho^2/2), w_n+1/2 = 1/(1 - rho^2 w_n/4)
+/// which tends to the optimal SOR w, without the initial growth of
+/// the error that a fixed optimal w suffers from. Each colour is
+/// relaxed by RelaxColour, so the zipped cells are relaxed with
+/// their own colour, as the recurrence requires
+static
+bool
+RedBlackChebyshev(Grid* grid, const Laplacian::CellGraph& graph, const StopParams& stop, const f64 rho)
+{
+    JasUnpack((*grid), voltages, lineLength);
 
-    LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr.load());
+    ColouredCells red;
+    ColouredCells black;
+    ColourCells(graph, &red, &black);
+
+    const f64 rho2 = Square(rho);
+    const f64 wOpt = Spectral::OptimalOmega(rho);
+    LOG("Chebyshev acceleration, rho %f, limiting w %f", rho, wOpt);
+
+    // NOTE(Chris): The lambda holds the w of the recurrence, each call
+    // is a red and a black half-sweep
+    f64 w = 1.0;
+    bool firstIteration = true;
+    return Sweep::Run([&voltages, &red, &black, lineLength, rho2, w, firstIteration] (bool computeErr) mutable
+                      {
+                          const f64 redErr = RelaxColour(&voltages, lineLength, red, w, computeErr);
+                          w = firstIteration ? 1.0 / (1.0 - 0.5 * rho2) : 1.0 / (1.0 - 0.25 * rho2 * w);
+                          firstIteration = false;
+                          const f64 blkErr = RelaxColour(&voltages, lineLength, black, w, computeErr);
+                          w = 1.0 / (1.0 - 0.25 * rho2 * w);
+                          return std::max(redErr, blkErr);
+                      },
+                      [&voltages] () -> const std::vector<f64>&
+                      {
+                          return voltages;
+                      }, stop);
 }
 
-/// Multi-threaded implementation of the finite difference method
-/// that takes into account that some of the points on the outer
-/// rows may need to be zipped. The dispatch function can determine this
+/// The non-fixed interior cells of each colour grouped by row, with
+/// the offsets of the column strips into each row, for the tiled
+/// sweep. Strip s covers the red cells with x in [s*W, (s+1)*W) and the
+/// black cells with x in [s*W - 1, (s+1)*W - 1), where W is the tile
+/// width. The zipped edge cells are kept separately
+struct TiledCells
+{
+    uint lineLength;
+    uint numLines;
+    uint numStrips;
+    std::vector<uint> red;
+    std::vector<uint> black;
+    /// Offsets into red/black of each (row, strip boundary), numStrips + 1 per row
+    std::vector<uint> redStrips;
+    std::vector<uint> blackStrips;
+    ColouredCells redEdge;
+    ColouredCells blackEdge;
+};
+
+/// Groups the cells of the graph for the tiled sweep
 static
 void
-RedBlackParaZip(Grid* grid, const std::vector<uint>& redPts, const std::vector<uint>& blkPts,
-           const StopParams& stop, const PreprocessedGridZips& zips)
+BuildTiledCells(const Laplacian::CellGraph& graph, const uint tileWidth, TiledCells* cells)
 {
-        // NOTE(Chris): Multi-threaded variant
-
-        // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
-        // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
-        //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
-        // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
-
-        // NOTE(Chris): We never write to the fixed points, so we don't
-        // need to re-set them (as long as they were set properly in the
-        // incoming grid using AddFixedPoint)
-
-        JasUnpack((*grid), voltages, numLines, lineLength);
-        JasUnpack(zips, hZip, vZip, hvZip);
+    JasUnpack(graph, lineLength, numLines, interior);
+    cells->lineLength = lineLength;
+    cells->numLines = numLines;
+    cells->numStrips = (lineLength + tileWidth - 1) / tileWidth;
+    const uint numStrips = cells->numStrips;
 
-        // Check error every 500 iterations at first
-        uint errorChunk = 500;
+    ColourCells(graph, &cells->redEdge, &cells->blackEdge);
 
-        // Hand-waving 10k iterations per thread as minimum to not be dominated by context switches etc.
-        const uint numWorkChunks = (voltages.size() / 20000 > 0) ? (voltages.size() / 20000) : 1;
-        const uint numThreads = (numWorkChunks > omp_get_max_threads())
-            ? ((MaxThreads > omp_get_max_threads())
-               ? omp_get_max_threads()
-               : MaxThreads)
-            : numWorkChunks;
+    // NOTE(Chris): The interior cells are in row-major order, so each
+    // row of each colour is contiguous and sorted
+    auto& red = cells->red;
+    auto& black = cells->black;
+    Laplacian::SplitRedBlack(interior, lineLength, &red, &black);
 
-        omp_set_num_threads(numThreads);
-
-        LOG("Num threads %u", numThreads);
-
-        const auto WrapGridAccessNewVal =
-            [&voltages, lineLength, numLines] (const std::pair<uint,uint>& pt) -> f64
-            {
-                const uint id1 = pt.second * lineLength + (((int)pt.first - 1) < 0
-                                                           ? lineLength - 1
-                                                           : pt.first - 1);
-
-                const uint id2 = pt.second * lineLength + (pt.first + 1 >= lineLength
-                                                           ? 0
-                                                           : pt.first + 1);
-                const uint id3 = (((int)pt.second - 1) < 0
-                                  ? numLines - 1
-                                  : pt.second - 1) * lineLength + pt.first;
-
-                const uint id4 = (pt.second + 1 >= numLines
-                                  ? 0
-                                  : pt.second + 1) * lineLength + pt.first;
-
-                const f64 newVal = 0.25*(voltages[id1] + voltages[id2]
-                                         + voltages[id3] + voltages[id4]);
-                return newVal;
-            };
-
-        // Atomic value for concurrent multi-threaded access
-        std::atomic<f64> maxErr(0.0);
-
-        // Main loop - start with 1 so as not to take slow path on first iter
-        for (u64 i = 1; i <= stop.maxIter; ++i)
+    auto stripOffsets = [lineLength, numLines, numStrips, tileWidth](const std::vector<uint>& pts, const uint shift)
+    {
+        std::vector<uint> offsets(numLines * (numStrips + 1));
+        auto c = pts.begin();
+        for (uint y = 0; y < numLines; ++y)
         {
-            // We will just double buffer these 2 vectors to avoid reallocations new<->old
-            // const ref to avoid damage again
-
-            if (unlikely(i % errorChunk == 0))
-            {
-                maxErr = 0.0;
-
-#pragma omp parallel for default(none) shared(redPts, lineLength, voltages, maxErr)
-                for (auto c = redPts.begin(); c < redPts.end(); ++c)
-                {
-                    const f64 prev = voltages[*c];
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    const f64 currentMax =  maxErr.load();
-                    if (absErr > currentMax)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-#pragma omp parallel for default(none) shared(blkPts, lineLength, voltages, maxErr)
-                for (auto c = blkPts.begin(); c < blkPts.end(); ++c)
-                {
-                    const f64 prev = voltages[*c];
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    if (absErr > maxErr)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : hZip)
-                {
-                    const uint index = coord.second * lineLength + coord.first;
-                    const f64 prev = voltages[index];
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    if (absErr > maxErr)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : vZip)
-                {
-                    const uint index = coord.second * lineLength + coord.first;
-                    const f64 prev = voltages[index];
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    if (absErr > maxErr)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const uint index = coord.second * lineLength + coord.first;
-                    const f64 prev = voltages[index];
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    voltages[index] = newVal;
-                    const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                    if (absErr > maxErr)
-                    {
-                        maxErr = absErr;
-                    }
-                }
-
-
-                if (maxErr < stop.zeroTol)
-                {
-                    LOG("Performed %u iterations, max error: %e", (unsigned)i, maxErr.load());
-                    return;
-                }
-
-                // NOTE(Chris): Report error every 5000 iterations
-                if (i % 5000 == 0)
-                {
-                    // If this is calculated near the beginning it tends
-                    // to overshoot, go to a quarter to refine the counter
-                    // (we use a modulo anyway so it will still stop at
-                    // the prediction)
-                    LOG("Relative change after %u iterations %f", (unsigned)i, maxErr.load());
-                }
-            }
-            else // normal path
+            for (uint s = 0; s < numStrips; ++s)
             {
-
-#pragma omp parallel for default(none) shared(redPts, lineLength, voltages)
-                for (auto c = redPts.begin(); c < redPts.end(); ++c)
-                {
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-                }
-
-#pragma omp parallel for default(none) shared(blkPts, lineLength, voltages)
-                for (auto c = blkPts.begin(); c < blkPts.end(); ++c)
-                {
-                    const f64 newVal = 0.25 * (voltages[*c + 1] + voltages[*c - 1] + voltages[*c - lineLength] + voltages[*c + lineLength]);
-                    voltages[*c] = newVal;
-                }
-
-                for (const auto& coord : hZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-
-                for (const auto& coord : vZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
-
-                for (const auto& coord : hvZip)
-                {
-                    const f64 newVal = WrapGridAccessNewVal(coord);
-                    const uint index = coord.second * lineLength + coord.first;
-                    voltages[index] = newVal;
-                }
+                const uint boundary = y * lineLength + ((s * tileWidth > shift) ? s * tileWidth - shift : 0);
+                while (c != pts.end() && *c < boundary)
+                    ++c;
+                offsets[y * (numStrips + 1) + s] = c - pts.begin();
             }
+            while (c != pts.end() && *c < (y + 1) * lineLength)
+                ++c;
+            offsets[y * (numStrips + 1) + numStrips] = c - pts.begin();
         }
+        return offsets;
+    };
+    cells->redStrips = stripOffsets(red, 0);
+    cells->blackStrips = stripOffsets(black, 1);
+}
 
-    LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr.load());
+/// Gauss-Seidel update of the cells of [begin, end), returns the max
+/// relative change if computeErr is set
+static inline
+f64
+RelaxCells(f64* v, const uint* begin, const uint* end, const uint lineLength, const bool computeErr)
+{
+    return computeErr
+        ? Sweep::RelaxRange<Sweep::GaussSeidel, Sweep::FivePoint, Sweep::TrackError>(v, v, begin, end,
+                                                                                    lineLength, 1.0)
+        : Sweep::RelaxRange<Sweep::GaussSeidel, Sweep::FivePoint, Sweep::NoError>(v, v, begin, end,
+                                                                                 lineLength, 1.0);
 }
 
-/// Single threaded RedBlack implementation that ignores
-/// the outer row/column of points where points may need to be
-/// fixed. Thus, these all need to be fixed points. If handled by
-/// the dispatch function then this is all handled automagically
+/// Serial Gauss-Seidel update of zipped edge cells
 static
-void
-RedBlackSingleNoZip(Grid* grid, const std::vector<uint>& redPts, const std::vector<uint>& blkPts, const StopParams& stop)
+f64
+RelaxEdges(f64* v, const ColouredCells& cells, const bool computeErr)
 {
-    JasUnpack((*grid), voltages, lineLength);
+    const Sweep::Cells edgeCells(cells.interior, cells.edge, cells.edgeNeighbours, cells.edgeDiagonals, 0);
+    return computeErr
+        ? Sweep::RelaxEdges<Sweep::GaussSeidel, Sweep::FivePoint, Sweep::Zip, Sweep::TrackError>(v, v, edgeCells, 1.0)
+        : Sweep::RelaxEdges<Sweep::GaussSeidel, Sweep::FivePoint, Sweep::Zip, Sweep::NoError>(v, v, edgeCells, 1.0);
+}
 
-    // Check error every 500 iterations at first
-    const uint errorChunk = 500;
+/// Relaxes one colour of row y over the columns of a strip, or the
+/// whole row if strip == numStrips
+static inline
+f64
+RelaxRow(f64* v, const TiledCells& cells, const std::vector<uint>& pts, const std::vector<uint>& strips,
+         const uint y, const uint strip, const bool computeErr)
+{
+    const uint* offsets = strips.data() + y * (cells.numStrips + 1);
+    const uint begin = (strip == cells.numStrips) ? offsets[0] : offsets[strip];
+    const uint end = (strip == cells.numStrips) ? offsets[cells.numStrips] : offsets[strip + 1];
+    return RelaxCells(v, pts.data() + begin, pts.data() + end, cells.lineLength, computeErr);
+}
 
-    // Max relative change
+/// Fused red-black sweep over the interior rows [y0, y1) of a band,
+/// one column strip at a time. The black update of each row lags
+/// one row behind the red update, and each strip's black columns lag
+/// one column behind its red columns, so every black cell sees its
+/// new red neighbours and every red cell its old black
+/// neighbours. The black cells on the first and last rows of the band
+/// depend on the neighbouring bands, so are left for
+/// RelaxBandEdges
+static
+f64
+RelaxBand(f64* v, const TiledCells& cells, const uint y0, const uint y1, const bool computeErr)
+{
+    JasUnpack(cells, red, black, redStrips, blackStrips, numStrips);
     f64 maxErr = 0.0;
-    // Main loop - start from 1 so as not to calculate error on first iteration
-    for (u64 i = 1; i <= stop.maxIter; ++i)
+    for (uint s = 0; s < numStrips; ++s)
     {
-        // Unlikely means the branch predictor will always go the
-        // other way, it will have to backtrack on the very rare
-        // cases that this comes up (1 in errorChunk times). This
-        // is a penalty of < 200 cycles on those rare occasions
-
-        // Calculate and check error every chunk (500 iterations by default)
-        if (unlikely(i % errorChunk == 0))
+        for (uint y = y0; y <= y1; ++y)
         {
-            maxErr = 0.0;
+            if (y < y1)
+                maxErr = std::max(maxErr, RelaxRow(v, cells, red, redStrips, y, s, computeErr));
 
-            // Loop over the non-fixed points
-            for (const auto c : redPts)
-            {
-                const f64 prevVal = voltages[c];
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-
-                voltages[c] = newVal;
-                const f64 absErr = std::abs((prevVal - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
-            for (const auto c : blkPts)
-            {
-                const f64 prevVal = voltages[c];
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-
-                voltages[c] = newVal;
-                const f64 absErr = std::abs((prevVal - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
-
-            // If we have converged, then break by leaving the function
-            if (maxErr < stop.zeroTol)
-            {
-                LOG("Performed %u iterations, max error: %f", (unsigned)i, maxErr);
-                return;
-            }
-
-            if (i % 5000 == 0)
-            {
-                // Output current error every 5000 iterations
-                LOG("Relative change after %u iterations %f", (unsigned)i, maxErr);
-            }
-        }
-        else // normal path
-        {
-            // Loop over the non-fixed points and apply the RedBlack,
-            // no error calculations -- that comparison is costly for
-            // the cache
-            for (const auto c : redPts)
-            {
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-                voltages[c] = newVal;
-            }
-            for (const auto c : blkPts)
-            {
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-                voltages[c] = newVal;
-            }
+            if (y >= y0 + 2 && y < y1)
+                maxErr = std::max(maxErr, RelaxRow(v, cells, black, blackStrips, y - 1, s, computeErr));
         }
     }
-    LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr);
+    return maxErr;
 }
 
-/// Single threaded finite difference method that takes into
-/// account that some points need to be zipped
+/// Relaxes the black cells of the first and last rows of a band,
+/// after all the bands have been through RelaxBand
 static
-void
-RedBlackSingleZip(Grid* grid, const std::vector<uint>& redPts, const std::vector<uint>& blkPts,
-             const StopParams& stop, const PreprocessedGridZips& zips)
+f64
+RelaxBandEdges(f64* v, const TiledCells& cells, const uint y0, const uint y1, const bool computeErr)
 {
-    JasUnpack((*grid), voltages, lineLength, numLines);
-    JasUnpack(zips, hZip, vZip, hvZip);
-
-    const auto WrapGridAccessNewVal =
-        [&voltages, lineLength, numLines] (const std::pair<uint,uint>& pt) -> f64
-        {
-            const uint id1 = pt.second * lineLength + (((int)pt.first - 1) < 0
-                                                        ? lineLength - 1
-                                                        : pt.first - 1);
-
-            const uint id2 = pt.second * lineLength + (pt.first + 1 >= lineLength
-                                                        ? 0
-                                                        : pt.first + 1);
-            const uint id3 = (((int)pt.second - 1) < 0
-                                ? numLines - 1
-                                : pt.second - 1) * lineLength + pt.first;
-
-            const uint id4 = (pt.second + 1 >= numLines
-                                ? 0
-                                : pt.second + 1) * lineLength + pt.first;
+    JasUnpack(cells, black, blackStrips, numStrips);
+    f64 maxErr = RelaxRow(v, cells, black, blackStrips, y0, numStrips, computeErr);
+    if (y1 - 1 > y0)
+        maxErr = std::max(maxErr, RelaxRow(v, cells, black, blackStrips, y1 - 1, numStrips, computeErr));
+    return maxErr;
+}
 
-            const f64 newVal = 0.25*(voltages[id1] + voltages[id2]
-                                        + voltages[id3] + voltages[id4]);
-            return newVal;
-        };
+/// One red-black iteration of the tiled sweep. The interior rows are
+/// split into a band per thread, and the zipped edges are handled
+/// serially, the red before, and the black after, the interior
+static
+f64
+TiledIteration(std::vector<f64>* voltages, const TiledCells& cells,
+               const std::vector<uint>& bands, const bool computeErr)
+{
+    f64* v = voltages->data();
+    const uint numBands = bands.size() - 1;
 
-    // Check error every 500 iterations at first
-    const uint errorChunk = 500;
+    f64 maxErr = RelaxEdges(v, cells.redEdge, computeErr);
 
-    f64 maxErr = 0.0;
-    // Main loop - start from 1 so as not to calculate error on first iteration
-    for (u64 i = 1; i <= stop.maxIter; ++i)
+#pragma omp parallel for default(none) shared(v, cells, bands, computeErr, numBands) reduction(max:maxErr)
+    for (uint b = 0; b < numBands; ++b)
     {
-        if (unlikely(i % errorChunk == 0))
-        {
-            maxErr = 0.0;
-
-            // Loop over the non-fixed points
-            for (const auto c : redPts)
-            {
-                const f64 prevVal = voltages[c];
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-
-                voltages[c] = newVal;
-                const f64 absErr = std::abs((prevVal - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
-
-            for (const auto c : blkPts)
-            {
-                const f64 prevVal = voltages[c];
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-
-                voltages[c] = newVal;
-                const f64 absErr = std::abs((prevVal - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
-
-            for (const auto& coord : hZip)
-            {
-                const uint index = coord.second * lineLength + coord.first;
-                const f64 prev = voltages[index];
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                voltages[index] = newVal;
-                const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
+        const f64 err = RelaxBand(v, cells, bands[b], bands[b + 1], computeErr);
+        if (err > maxErr)
+            maxErr = err;
+    }
 
-            for (const auto& coord : vZip)
-            {
-                const uint index = coord.second * lineLength + coord.first;
-                const f64 prev = voltages[index];
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                voltages[index] = newVal;
-                const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
+#pragma omp parallel for default(none) shared(v, cells, bands, computeErr, numBands) reduction(max:maxErr)
+    for (uint b = 0; b < numBands; ++b)
+    {
+        const f64 err = RelaxBandEdges(v, cells, bands[b], bands[b + 1], computeErr);
+        if (err > maxErr)
+            maxErr = err;
+    }
 
-            for (const auto& coord : hvZip)
-            {
-                const uint index = coord.second * lineLength + coord.first;
-                const f64 prev = voltages[index];
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                voltages[index] = newVal;
-                const f64 absErr = std::abs((prev - newVal)/newVal);
-
-                if (absErr > maxErr)
-                {
-                    maxErr = absErr;
-                }
-            }
+    return std::max(maxErr, RelaxEdges(v, cells.blackEdge, computeErr));
+}
 
-            // If we have converged, then break by leaving the function
-            if (maxErr < stop.zeroTol)
-            {
-                LOG("Performed %u iterations, max error: %f", (unsigned)i, maxErr);
-                return;
-            }
+/// Cache-blocked red-black Gauss-Seidel. Rather than a pass over the
+/// grid for each colour, the red and black updates are fused into a
+/// single skewed pass over tileWidth wide column strips, so each cell
+/// is brought into cache once per iteration. The iterates are the
+/// same as those of the two-pass method, and all zip combinations are
+/// supported. With anderson set the iterate is extrapolated from the
+/// previous ones at each error check
+static
+bool
+RedBlackTiled(Grid* grid, const Laplacian::CellGraph& graph, const uint tileWidth,
+              const uint numThreads, const StopParams& stop, bool anderson)
+{
+    JasUnpack((*grid), voltages, numLines);
+
+    TiledCells cells;
+    BuildTiledCells(graph, tileWidth, &cells);
+
+    // NOTE(Chris): Each band needs at least 3 rows for the fused sweep
+    // to do anything, so limit the number of bands on small grids
+    const uint numInterior = numLines - 2;
+    const uint numBands = std::max(1u, std::min(numThreads, numInterior / 3));
+    std::vector<uint> bands(numBands + 1);
+    for (uint b = 0; b <= numBands; ++b)
+        bands[b] = 1 + (u64)b * numInterior / numBands;
+
+    LOG("Tiled red-black, tile width %u, %u strips, %u bands", tileWidth, cells.numStrips, numBands);
+
+    const auto accel = Sweep::MakeAccelerator(anderson, Sweep::Unknowns(graph), &voltages);
+
+    return Sweep::Run([&voltages, &cells, &bands] (bool computeErr)
+                      {
+                          return TiledIteration(&voltages, cells, bands, computeErr);
+                      },
+                      [&voltages] () -> const std::vector<f64>&
+                      {
+                          return voltages;
+                      }, stop, Sweep::Checks::Fixed,
+                      Sweep::Accelerate(accel.get(), &voltages));
+}
 
-            // Log error every 5000 iterations
-            if (i % 5000 == 0)
-            {
-                LOG("Relative change after %u iterations %f", (unsigned)i, maxErr);
-            }
-        }
-        else // normal path
-        {
-            // Loop over the non-fixed points and apply the RedBlack
-            for (const auto c : redPts)
-            {
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-                voltages[c] = newVal;
-            }
-            for (const auto c : blkPts)
-            {
-                const f64 newVal = 0.25 * (voltages[c + 1] + voltages[c - 1] + voltages[c - lineLength] + voltages[c + lineLength]);
-                voltages[c] = newVal;
-            }
+/// Splits the cells of the graph into the red ((x + y) even) and
+/// black cells of the checkerboard
+void
+ColourCells(const Laplacian::CellGraph& graph, ColouredCells* red, ColouredCells* black)
+{
+    JasUnpack(graph, lineLength, interior, edge, edgeNeighbours, edgeDiagonals);
 
-            // Handle the exterior Zip points by wrapping around the grid
-            for (const auto& coord : hZip)
-            {
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                const uint index = coord.second * lineLength + coord.first;
-                voltages[index] = newVal;
-            }
+    Laplacian::SplitRedBlack(interior, lineLength, &red->interior, &black->interior);
 
-            for (const auto& coord : vZip)
-            {
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                const uint index = coord.second * lineLength + coord.first;
-                voltages[index] = newVal;
-            }
+#ifdef USE_SIMD
+    for (ColouredCells* colour : { red, black })
+    {
+        colour->update.assign(graph.fixed.size(), 0);
+        for (auto c : colour->interior)
+            colour->update[c] = 1;
+    }
+#endif
 
-            for (const auto& coord : hvZip)
-            {
-                const f64 newVal = WrapGridAccessNewVal(coord);
-                const uint index = coord.second * lineLength + coord.first;
-                voltages[index] = newVal;
-            }
-        }
+    for (uint e = 0; e < edge.size(); ++e)
+    {
+        const uint x = edge[e] % lineLength;
+        const uint y = edge[e] / lineLength;
+        ColouredCells* colour = ((x + y) % 2 == 0) ? red : black;
+        colour->edge.push_back(edge[e]);
+        colour->edgeNeighbours.push_back(edgeNeighbours[e]);
+        colour->edgeDiagonals.push_back(edgeDiagonals[e]);
     }
-    LOG("Overran max iteration counter (%u), max error: %f", (unsigned)stop.maxIter, maxErr);
 }
 
-/// Types of possible problems with Zip definition
-enum class ZipDefinitionProblem
-{
-    Horizontal,
-        Vertical,
-        Both,
-        None
-        };
-
-/// Checks the validity of the grid WRT the zip settings and
-/// returns the problem with it (if there is one)
-static
-ZipDefinitionProblem
-CheckGridZips(const Grid& grid)
+/// Splits the cells of the graph into the four colours of the parity
+/// of x and y, (x % 2) + 2 (y % 2)
+void
+FourColourCells(const Laplacian::CellGraph& graph, std::vector<ColouredCells>* colours)
 {
-    JasUnpack(grid, verticZip, horizZip, numLines, lineLength, fixedPoints);
+    JasUnpack(graph, lineLength, interior, edge, edgeNeighbours, edgeDiagonals);
 
-    if (!horizZip || !verticZip)
-    {
-        if (fixedPoints.count(0) == 0
-            || fixedPoints.count(lineLength - 1) == 0
-            || fixedPoints.count((numLines - 1) * lineLength) == 0
-            || fixedPoints.count((numLines - 1) * lineLength + lineLength - 1) == 0)
-        {
-            LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-            return ZipDefinitionProblem::Both;
-        }
-    }
+    colours->assign(4, ColouredCells());
+    auto& c = *colours;
+    for (uint i = 0; i < c.size(); ++i)
+        c[i].interior.reserve(interior.size() / 4 + 1);
 
-    if (!verticZip)
+    for (const auto cell : interior)
     {
-        // Check first and final column for empty pixels (corners require more specific check)
-        for (uint y = 1; y < numLines - 1; ++y)
-        {
-            if (fixedPoints.count(y * lineLength) == 0
-                || fixedPoints.count(y * lineLength + lineLength - 1) == 0)
-            {
-                LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-                return ZipDefinitionProblem::Vertical;
-            }
-        }
+        const uint x = cell % lineLength;
+        const uint y = cell / lineLength;
+        c[(x % 2) + 2 * (y % 2)].interior.push_back(cell);
     }
 
-    if (!horizZip)
+    for (uint e = 0; e < edge.size(); ++e)
     {
-        // Check first and final row for empty pixels (corners require more specific check)
-        for (uint x = 1; x < lineLength - 1; ++x)
-        {
-            if (fixedPoints.count(x) == 0
-                || fixedPoints.count((numLines - 1) * lineLength + x) == 0)
-            {
-                LOG("Badly described grid, some outer points are not set, but the relevant zip is not enabled");
-                return ZipDefinitionProblem::Horizontal;
-            }
-        }
+        const uint x = edge[e] % lineLength;
+        const uint y = edge[e] / lineLength;
+        ColouredCells& colour = c[(x % 2) + 2 * (y % 2)];
+        colour.edge.push_back(edge[e]);
+        colour.edgeNeighbours.push_back(edgeNeighbours[e]);
+        colour.edgeDiagonals.push_back(edgeDiagonals[e]);
     }
-    return ZipDefinitionProblem::None;
 }
 
-/// Prepares vectors of the zipped points (the ones which require
-/// special overlap treatment), and returns a struct of these 3
-/// vectors
+/// Over-relaxes the interior cells of one colour a row at a time with
+/// the vectorised kernels, rows in parallel
 static
-PreprocessedGridZips
-PreprocessGridZips(const Grid& grid)
+f64
+RelaxColourRows(std::vector<f64>* v, const uint lineLength, const std::vector<u8>& update,
+                const f64 w, const bool computeErr)
 {
-    std::vector<std::pair<uint, uint> > horizZipPoints;
-    std::vector<std::pair<uint, uint> > verticZipPoints;
-    std::vector<std::pair<uint, uint> > horizAndVerticZipPoints;
+    f64* voltages = v->data();
+    const u8* mask = update.data();
+    const uint numLines = update.size() / lineLength;
 
-    JasUnpack(grid, verticZip, horizZip, lineLength, numLines, fixedPoints);
-    if (horizZip)
+    f64 maxErr = 0.0;
+#pragma omp parallel for default(none) shared(voltages, mask, lineLength, numLines, w, computeErr) reduction(max:maxErr)
+    for (uint y = 1; y < numLines - 1; ++y)
     {
-        horizZipPoints.reserve(2 * lineLength);
-        for (uint x = 1; x < lineLength - 1; ++x)
-        {
-            if (fixedPoints.count(x) == 0)
-            {
-                horizZipPoints.push_back(std::make_pair(x, 0));
-            }
-
-            if (fixedPoints.count((numLines - 1) * lineLength + x) == 0)
-            {
-                horizZipPoints.push_back(std::make_pair(x, numLines - 1));
-            }
-        }
+        const f64 err = Stencil::SORRow(voltages + y * lineLength, mask + y * lineLength, lineLength,
+                                        1, lineLength - 1, w, computeErr);
+        if (err > maxErr)
+            maxErr = err;
     }
-    // Sort automatically compares first, then second types for pairs
-    std::sort(horizZipPoints.begin(), horizZipPoints.end());
+    return maxErr;
+}
 
-    if (verticZip)
-    {
-        verticZipPoints.reserve(2*numLines);
-        for (uint y = 1; y < numLines - 1; ++y)
-        {
-            if (fixedPoints.count(y * lineLength) == 0)
-            {
-                verticZipPoints.push_back(std::make_pair(0, y));
-            }
-            if (fixedPoints.count(y * lineLength + lineLength - 1) == 0)
-            {
-                verticZipPoints.push_back(std::make_pair(lineLength - 1, y));
-            }
-        }
-    }
-    std::sort(verticZipPoints.begin(), verticZipPoints.end());
+/// The in place over-relaxed sweep over one colour for the dispatch
+/// table
+template <typename Threads, typename Points, typename Zip, typename Err>
+using SORColourSweep = Sweep::Simultaneous<Threads, Sweep::SOR, Points, Zip, Err>;
+
+/// Over-relaxes the zipped edge cells of one colour, serially
+static
+f64
+RelaxEdgeCells(std::vector<f64>* v, const ColouredCells& cells, const f64 w, const bool computeErr)
+{
+    f64* voltages = v->data();
+    const Sweep::Cells edgeCells(cells.interior, cells.edge, cells.edgeNeighbours, cells.edgeDiagonals, 0);
+    return computeErr
+        ? Sweep::RelaxEdges<Sweep::SOR, Sweep::FivePoint, Sweep::Zip, Sweep::TrackError>(voltages, voltages,
+                                                                                        edgeCells, w)
+        : Sweep::RelaxEdges<Sweep::SOR, Sweep::FivePoint, Sweep::Zip, Sweep::NoError>(voltages, voltages,
+                                                                                     edgeCells, w);
+}
 
-    if (horizZip && verticZip)
+/// Over-relaxes the cells of one colour (interior cells in
+/// parallel, then the zipped edge cells), returns the max relative
+/// change if computeErr is set, otherwise 0
+f64
+RelaxColour(std::vector<f64>* v, const uint lineLength, const ColouredCells& cells,
+            const f64 w, const bool computeErr, const Cfg::StencilType stencil,
+            const std::vector<f64>* source)
+{
+    // NOTE(Chris): If the colour carries its update mask the interior
+    // is swept a row at a time by the SIMD kernels. The scalar row
+    // kernel visits every cell of the row, so without vector support
+    // the index loop below is quicker. The kernels are 5-point only,
+    // and have no source term
+    if (!cells.update.empty() && stencil == Cfg::StencilType::FivePoint && !source
+        && Stencil::ActiveInstructionSet() != Stencil::InstructionSet::Scalar)
     {
-        horizAndVerticZipPoints.reserve(4);
-        if (fixedPoints.count(0) == 0)
-        {
-            horizAndVerticZipPoints.push_back(std::make_pair(0,0));
-        }
-        if (fixedPoints.count(lineLength - 1) == 0)
-        {
-            horizAndVerticZipPoints.push_back(std::make_pair(lineLength, 0));
-        }
-        if (fixedPoints.count((numLines - 1) * lineLength) == 0)
-        {
-            horizAndVerticZipPoints.push_back(std::make_pair(0, numLines - 1));
-        }
-        if (fixedPoints.count((numLines - 1) * lineLength + lineLength - 1) == 0)
-        {
-            horizAndVerticZipPoints.push_back(std::make_pair(lineLength - 1, numLines - 1));
-        }
+        const f64 maxErr = RelaxColourRows(v, lineLength, cells.update, w, computeErr);
+        return std::max(maxErr, RelaxEdgeCells(v, cells, w, computeErr));
     }
-    std::sort(horizAndVerticZipPoints.begin(), horizAndVerticZipPoints.end());
 
-    return PreprocessedGridZips(std::move(horizZipPoints),
-                                std::move(verticZipPoints),
-                                std::move(horizAndVerticZipPoints));
+    // newVal(x,y) = (1-w)*phi(x,y) + w*phiI(x,y)
+    // where phiI is the Gauss-Seidel value
+    // phiI = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
+    f64* voltages = v->data();
+    Sweep::Cells colourCells(cells.interior, cells.edge, cells.edgeNeighbours, cells.edgeDiagonals,
+                             lineLength);
+    colourCells.source = source ? source->data() : nullptr;
+    const auto relax = Sweep::Dispatch<SORColourSweep>::Select(omp_get_max_threads() > 1,
+                                                               !cells.edge.empty(), computeErr, stencil);
+    return relax(voltages, voltages, colourCells, w);
 }
 
-/// The dispatch function for finite difference method. Checks the
-/// validity of the grid WRT zip parameters and then dispatches it
-/// to 1 of 4 worker functions, depending on whether it has zips,
-/// and whether we are running parallel code or not
-void
+#ifdef USE_SIMD
+/// Red-black Gauss-Seidel on the split checkerboard layout, so each
+/// colour is relaxed with unit stride by the vectorised kernels.
+/// Supports all zip combinations. With anderson set the iterate is
+/// extrapolated from the previous ones at each error check
+static
+bool
+RedBlackSplit(Grid* grid, const Laplacian::CellGraph& graph, const StopParams& stop,
+              bool anderson)
+{
+    Checkerboard::SplitGrid split;
+    Checkerboard::BuildSplitGrid(graph, &split);
+    Checkerboard::LoadFromGrid(*grid, &split);
+
+    LOG("Red-black on the split layout using %s kernels",
+        Stencil::InstructionSetName(Stencil::ActiveInstructionSet()));
+
+    const auto accel = Sweep::MakeAccelerator(anderson, Checkerboard::Unknowns(split), &split.values);
+
+    // NOTE(Chris): w = 1 is plain Gauss-Seidel, (1 - w) * prev
+    // vanishes exactly so this matches the other red-black paths. The
+    // residual is measured on the grid, so the split layout is only
+    // copied back when it is needed
+    const bool converged =
+        Sweep::Run([&split] (bool computeErr)
+                   {
+                       const f64 redErr = Checkerboard::RelaxColour(&split, Checkerboard::Colour::Red,
+                                                                    1.0, computeErr);
+                       return std::max(redErr, Checkerboard::RelaxColour(&split, Checkerboard::Colour::Black,
+                                                                         1.0, computeErr));
+                   },
+                   [&split, grid] () -> const std::vector<f64>&
+                   {
+                       Checkerboard::StoreToGrid(split, grid);
+                       return grid->voltages;
+                   }, stop, Sweep::Checks::Fixed,
+                   Sweep::Accelerate(accel.get(), &split.values));
+
+    Checkerboard::StoreToGrid(split, grid);
+    return converged;
+}
+#endif
+
+/// The dispatch function for the red-black method. Checks the
+/// validity of the grid WRT zip parameters and then dispatches it to
+/// the Chebyshev, tiled or split layout methods if selected, or
+/// otherwise the sweep over the cell lists, which picks its kernel
+/// for the zips and threading from a dispatch table
+bool
 RedBlackSolver(Grid* grid, const f64 zeroTol,
-               const u64 maxIter, bool parallel)
+               const u64 maxIter, bool parallel, bool chebyshev,
+               bool tiled, uint tileWidth, bool anderson)
 {
     TIME_FUNCTION();
 
     // NOTE(Chris): This function dispatches the calculation to
     // the most appropriate function (zips or not, parallel or
-    // not), after having preprocessed the grid to check its
-    // validity
-
-    JasUnpack((*grid), horizZip, verticZip, numLines, lineLength, fixedPoints);
-
-    // NOTE(Chris): We choose to trade off some memory for computation
-    // speed inside the loop
-    std::vector<uint> coordRangeRed; //non-fixed red points
-    coordRangeRed.reserve(numLines*lineLength / 2);
-
-    std::vector<uint> coordRangeBlack; //non-fixed red points
-    coordRangeBlack.reserve(numLines*lineLength / 2);
-
-    // Ignore outer boundary (handled by zips)
-    for (uint y = 1; y < numLines - 1; ++y)
-        for (uint x = 1; x < lineLength - 1; ++x)
-        {
-            const uint index = y * lineLength + x;
-            if (fixedPoints.count(index) == 0)
-            {
-                if ((index % lineLength) % 2 == 0)
-                {
-                    coordRangeRed.push_back(index);
-                }
-                else
-                {
-                    coordRangeBlack.push_back(index);
-                }
+    // not). The validity of the grid WRT the zips is checked when
+    // building the cell graph
 
-            }
-        }
+    // NOTE(Chris): No need to use the more complex parallel routines
+    // if we only have 1 thread available
+    if (omp_get_max_threads() == 1)
+        parallel = false;
 
-    switch (CheckGridZips(*grid))
+    const uint numWorkChunks = (grid->voltages.size() / 20000 > 0) ? (grid->voltages.size() / 20000) : 1;
+    const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+        ? ((MaxThreads > (uint)omp_get_max_threads())
+           ? omp_get_max_threads()
+           : MaxThreads)
+        : numWorkChunks;
+    const uint activeThreads = parallel ? numThreads : 1;
+    omp_set_num_threads(activeThreads);
+
+    Laplacian::CellGraph graph;
+    if (!Laplacian::BuildCellGraph(*grid, &graph))
+        return false;
+
+    bool splitLayout = false;
+#ifdef USE_SIMD
+    splitLayout = (Stencil::ActiveInstructionSet() != Stencil::InstructionSet::Scalar);
+#endif
+
+    // NOTE(Chris): The other sweeps are written for the 5-point
+    // checkerboard, so the 9-point stencil always uses the four colour
+    // sweep over the cell lists
+    const bool ninePoint = (Laplacian::ActiveStencil() == Cfg::StencilType::NinePoint);
+    if (ninePoint)
     {
-    case ZipDefinitionProblem::Both:
-    {
-        LOG("Check both zip definitions");
-        return;
-    } break;
+        if (chebyshev || tiled)
+            LOG("Chebyshev and tiled options only support the 5-point stencil, ignoring them");
+        chebyshev = false;
+        tiled = false;
+        splitLayout = false;
+    }
 
-    case ZipDefinitionProblem::Horizontal:
+    // NOTE(Chris): The extrapolation assumes the same map between
+    // checks, which the changing w of the Chebyshev schedule breaks
+    if (chebyshev && anderson)
     {
-        LOG("Check horizontal zip definition");
-        return;
-    } break;
+        LOG("Anderson acceleration isn't supported with the Chebyshev schedule, ignoring it");
+        anderson = false;
+    }
 
-    case ZipDefinitionProblem::Vertical:
+    if (tiled && !chebyshev)
     {
-        LOG("Check vertical zip definition");
-        return;
-    } break;
+        // NOTE(Chris): The fused sweep reuses 4 rows of the strip, keep
+        // these in half of L2 to leave room for the indices. Narrower
+        // strips than this only break up the hardware prefetching
+        if (tileWidth == 0)
+            tileWidth = std::max(16u, DataCacheSize(2, 256 * 1024) / (2 * 4 * (uint)sizeof(f64)));
+
+        return RedBlackTiled(grid, graph, tileWidth, activeThreads,
+                             StopParams(*grid, zeroTol, maxIter), anderson);
+    }
 
-    default:
+    if (chebyshev)
     {
-
-    } break;
+        return RedBlackChebyshev(grid, graph, StopParams(*grid, zeroTol, maxIter),
+                                 Spectral::JacobiRadius(*grid, graph));
     }
 
-    // NOTE(Chris): No need to use the more complex parallel routines
-    // if we only have 1 thread available
-    if (omp_get_max_threads() == 1)
-        parallel = false;
-
-    if (!verticZip && !horizZip)
+#ifdef USE_SIMD
+    // NOTE(Chris): As in SOR, the split layout only pays off with the
+    // vector kernels
+    if (splitLayout)
     {
-        if (parallel)
-        {
-            RedBlackParaNoZip(grid, coordRangeRed, coordRangeBlack, StopParams(zeroTol, maxIter));
-        }
-        else
-        {
-            RedBlackSingleNoZip(grid, coordRangeRed, coordRangeBlack, StopParams(zeroTol, maxIter));
-        }
-        return;
+        return RedBlackSplit(grid, graph, StopParams(*grid, zeroTol, maxIter), anderson);
     }
+#endif
 
-    auto zips = PreprocessGridZips(*grid);
+    LOG("%s over the cell lists, num threads %u", ninePoint ? "Four colour 9-point" : "Red-black",
+        activeThreads);
 
-    if (parallel)
-    {
-        RedBlackParaZip(grid, coordRangeRed, coordRangeBlack, StopParams(zeroTol, maxIter), zips);
-    }
-    else
-    {
-        RedBlackSingleZip(grid, coordRangeRed, coordRangeBlack, StopParams(zeroTol, maxIter), zips);
-    }
+    return RedBlackCells(grid, graph, StopParams(*grid, zeroTol, maxIter), parallel, anderson);
 }
 }
@@ -10,14 +10,68 @@
 #define REDBLACK_H
 
 #include "GlobalDefines.hpp"
+#include "Laplacian.hpp"
+#include <vector>
 
 class Grid;
 
 namespace RedBlack
 {
-    /// Method that behaves very similarly to FDM, just using the Red-Black iterative method instead
+    /// The non-fixed cells of one colour of the checkerboard. The
+    /// zipped edge cells carry their wrapped (and diagonal) neighbours,
+    /// as in the CellGraph. With USE_SIMD the interior cells are also flagged in
+    /// update (one entry per cell of the grid), so that they can be
+    /// relaxed a row at a time by the vectorised kernels
+    struct ColouredCells
+    {
+        std::vector<uint> interior;
+        std::vector<uint> edge;
+        std::vector<Laplacian::Neighbours> edgeNeighbours;
+        std::vector<Laplacian::Neighbours> edgeDiagonals;
+        std::vector<u8> update;
+    };
+
+    /// Splits the cells of the graph into the red ((x + y) even) and
+    /// black cells of the checkerboard
+    void
+    ColourCells(const Laplacian::CellGraph& graph, ColouredCells* red, ColouredCells* black);
+
+    /// Splits the cells of the graph into four colours by the parity
+    /// of x and y, in the order (even, even), (odd, even), (even, odd),
+    /// (odd, odd), so that no two interior cells of a colour are
+    /// neighbours under the 9-point stencil either. The update masks
+    /// are left empty, as the vectorised kernels are 5-point only
     void
+    FourColourCells(const Laplacian::CellGraph& graph, std::vector<ColouredCells>* colours);
+
+    /// Over-relaxes the cells of one colour (interior cells in
+    /// parallel, then the zipped edge cells), returns the max relative
+    /// change if computeErr is set, otherwise 0. The colours must come
+    /// from FourColourCells for the 9-point stencil. If source is given
+    /// (the h^2 scaled right hand side, one entry per cell of the grid)
+    /// the Poisson equation is relaxed instead of Laplace's
+    f64
+    RelaxColour(std::vector<f64>* v, const uint lineLength, const ColouredCells& cells,
+                const f64 w, const bool computeErr,
+                const Cfg::StencilType stencil = Cfg::StencilType::FivePoint,
+                const std::vector<f64>* source = nullptr);
+
+    /// Method that behaves very similarly to FDM, just using the Red-Black iterative method instead.
+    /// With the 9-point stencil selected the cells are split into four
+    /// colours rather than two, and the Chebyshev and tiled options
+    /// are ignored.
+    /// If chebyshev is set the sweeps are over-relaxed following the
+    /// Chebyshev schedule, which tends to the optimal SOR factor.
+    /// Otherwise, if tiled is set both colours are updated in a single
+    /// cache-blocked pass over strips tileWidth cells wide (0 to size
+    /// these from the L2 cache). If anderson is set (and chebyshev
+    /// isn't) the iterate is extrapolated from the last few at each
+    /// error check (see Anderson.hpp). Returns true if the solution
+    /// converged before maxIter
+    bool
     RedBlackSolver(Grid* grid, const f64 zeroTol,
-                   const u64 maxIter, bool parallel = true);
+                   const u64 maxIter, bool parallel = true,
+                   bool chebyshev = false, bool tiled = false,
+                   uint tileWidth = 0, bool anderson = false);
 }
 #endif
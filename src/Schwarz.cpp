@@ -0,0 +1,445 @@
+/* ==========================================================================
+   $File: Schwarz.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Schwarz.hpp"
+#include "Grid.hpp"
+#include "Laplacian.hpp"
+#include "SpectralRadius.hpp"
+#include "SweepEngine.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <Eigen/Dense>
+
+namespace Schwarz
+{
+    /// Max number of threads to be used by OpenMP
+    const uint MaxThreads = 30;
+
+    /// Bounds on the side of the owned part of a tile. A 64 x 64 tile
+    /// with its halo is about 40 kB of voltages, so it stays in L2
+    /// across its local sweeps, and below 32 the halo starts to
+    /// dominate the work
+    const uint MaxTileSize = 64;
+    const uint MinTileSize = 32;
+
+    /// Number of cells each tile extends into its neighbours, beyond
+    /// which there is one more ghost layer held fixed during the local
+    /// sweeps
+    const uint Overlap = 4;
+
+    /// Red-black SOR sweeps each tile performs between halo exchanges
+    const uint LocalSweeps = 8;
+
+    /// Convergence is checked every so many outer iterations (about as
+    /// many sweeps as the other relaxation solvers)
+    const uint ErrorCheckInterval = 50;
+
+    using Sweep::StopParams;
+
+    /// A tile of the grid, extended by the overlap and a ghost ring,
+    /// with its own contiguous copy of the voltages. The local cells
+    /// map to globalIndex, wrapping across zipped edges
+    struct Tile
+    {
+        uint width;
+        uint height;
+        std::vector<uint> globalIndex;
+        std::vector<f64> values;
+        /// Local indices of the non-fixed cells off the ghost ring
+        std::vector<uint> red;
+        std::vector<uint> black;
+        /// Non-zero for the local cells this tile writes back
+        std::vector<u8> owned;
+        /// Local and global index of each owned non-fixed cell
+        std::vector<std::pair<uint, uint> > writeBack;
+    };
+
+    /// Splits [0, length) into ranges of about tileSide and returns
+    /// their boundaries. Across a zip the number of ranges is kept even
+    /// (or 1), so that the tile colouring still alternates there
+    static
+    std::vector<uint>
+    SplitAxis(const uint length, const uint tileSide, const bool periodic)
+    {
+        uint numTiles = std::max(1u, (length + tileSide - 1) / tileSide);
+        if (periodic && numTiles > 1 && numTiles % 2 == 1)
+        {
+            ++numTiles;
+        }
+
+        std::vector<uint> bounds(numTiles + 1);
+        for (uint t = 0; t <= numTiles; ++t)
+        {
+            bounds[t] = (uint)((u64)t * length / numTiles);
+        }
+        return bounds;
+    }
+
+    static inline
+    uint
+    Wrap(const int coord, const uint length)
+    {
+        const int l = (int)length;
+        return (uint)(((coord % l) + l) % l);
+    }
+
+    /// Builds the tile owning [x0, x1) x [y0, y1). Its halo wraps in
+    /// the zipped directions and is clipped to the grid in the others
+    /// (where the outer cells are fixed anyway)
+    static
+    Tile
+    BuildTile(const Laplacian::CellGraph& graph, const uint x0, const uint x1,
+              const uint y0, const uint y1, const bool periodicX, const bool periodicY)
+    {
+        JasUnpack(graph, lineLength, numLines, fixed);
+        const int halo = (int)Overlap + 1;
+
+        const int extX0 = periodicX ? (int)x0 - halo : std::max(0, (int)x0 - halo);
+        const int extX1 = periodicX ? (int)x1 + halo : std::min((int)lineLength, (int)x1 + halo);
+        const int extY0 = periodicY ? (int)y0 - halo : std::max(0, (int)y0 - halo);
+        const int extY1 = periodicY ? (int)y1 + halo : std::min((int)numLines, (int)y1 + halo);
+
+        Tile tile;
+        tile.width = extX1 - extX0;
+        tile.height = extY1 - extY0;
+        const uint numLocal = tile.width * tile.height;
+        tile.globalIndex.resize(numLocal);
+        tile.values.resize(numLocal);
+        tile.owned.assign(numLocal, 0);
+
+        for (uint j = 0; j < tile.height; ++j)
+        {
+            const int y = extY0 + (int)j;
+            for (uint i = 0; i < tile.width; ++i)
+            {
+                const int x = extX0 + (int)i;
+                const uint local = j * tile.width + i;
+                const uint global = Wrap(y, numLines) * lineLength + Wrap(x, lineLength);
+                tile.globalIndex[local] = global;
+
+                const bool ring = (i == 0 || j == 0 || i == tile.width - 1 || j == tile.height - 1);
+                const bool owned = (x >= (int)x0 && x < (int)x1 && y >= (int)y0 && y < (int)y1);
+                tile.owned[local] = owned;
+
+                if (fixed[global])
+                    continue;
+
+                if (!ring)
+                {
+                    ((i + j) % 2 == 0 ? tile.red : tile.black).push_back(local);
+                }
+                if (owned)
+                {
+                    tile.writeBack.push_back(std::make_pair(local, global));
+                }
+            }
+        }
+        return tile;
+    }
+
+    /// Over-relaxes the cells of one colour of a tile, returns the max
+    /// relative change over the owned cells if computeErr is set,
+    /// otherwise 0
+    static inline
+    f64
+    RelaxTileColour(Tile* tile, const std::vector<uint>& cells, const f64 w,
+                    const bool computeErr)
+    {
+        JasUnpack((*tile), width, values, owned);
+
+        f64 maxErr = 0.0;
+        for (const auto c : cells)
+        {
+            const f64 prev = values[c];
+            const f64 phiI = 0.25 * (values[c + 1] + values[c - 1]
+                                     + values[c - width] + values[c + width]);
+            const f64 newVal = (1.0 - w) * prev + w * phiI;
+            values[c] = newVal;
+
+            if (unlikely(computeErr) && owned[c])
+            {
+                const f64 absErr = std::abs((prev - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                {
+                    maxErr = absErr;
+                }
+            }
+        }
+        return maxErr;
+    }
+
+    /// Local solve on one tile: copies in the current voltages over
+    /// the tile and its halo, runs LocalSweeps red-black SOR sweeps
+    /// with the ghost ring held fixed, and writes back the owned
+    /// cells. Returns the max relative change over the owned cells in
+    /// the final sweep if computeErr is set, otherwise 0
+    static
+    f64
+    SolveTile(Tile* tile, std::vector<f64>* v, const f64 w, const bool computeErr)
+    {
+        JasUnpack((*tile), globalIndex, values, red, black, writeBack);
+        auto& voltages = *v;
+
+        for (uint l = 0; l < globalIndex.size(); ++l)
+        {
+            values[l] = voltages[globalIndex[l]];
+        }
+
+        f64 maxErr = 0.0;
+        for (uint sweep = 0; sweep < LocalSweeps; ++sweep)
+        {
+            const bool lastSweep = computeErr && (sweep + 1 == LocalSweeps);
+            const f64 redErr = RelaxTileColour(tile, red, w, lastSweep);
+            const f64 blackErr = RelaxTileColour(tile, black, w, lastSweep);
+            maxErr = std::max(redErr, blackErr);
+        }
+
+        for (const auto& cell : writeBack)
+        {
+            voltages[cell.second] = values[cell.first];
+        }
+        return maxErr;
+    }
+
+    /// Coarse space with one constant per tile (Nicolaides), which
+    /// carries the smooth part of the error across the whole grid in
+    /// one step. Without it the number of outer iterations grows with
+    /// the number of tiles across the grid, i.e. with the thread count
+    struct CoarseSpace
+    {
+        /// Factorisation of the Galerkin matrix A_0 = R A R^T, where R
+        /// sums the cells owned by each tile
+        Eigen::LDLT<Eigen::MatrixXd> factor;
+        Eigen::VectorXd rhs;
+        Eigen::VectorXd correction;
+        std::vector<f64> product;
+    };
+
+    static
+    void
+    BuildCoarseSpace(const Laplacian::CellGraph& graph, const std::vector<Tile>& tiles,
+                     CoarseSpace* coarse)
+    {
+        JasUnpack(graph, lineLength, numLines, interior, edge, edgeNeighbours);
+        const uint numTiles = tiles.size();
+
+        std::vector<uint> tileOf(lineLength * numLines, 0);
+        for (uint t = 0; t < numTiles; ++t)
+        {
+            for (const auto& cell : tiles[t].writeBack)
+            {
+                tileOf[cell.second] = t;
+            }
+        }
+
+        // NOTE(Chris): A_0(s, t) sums A_ij over the non-fixed cells i
+        // owned by s and j owned by t
+        Eigen::MatrixXd a0 = Eigen::MatrixXd::Zero(numTiles, numTiles);
+        auto addRow = [&](const uint c, const Laplacian::Neighbours& n)
+        {
+            a0(tileOf[c], tileOf[c]) += 4.0;
+            for (const auto neighbour : n)
+            {
+                if (!graph.fixed[neighbour])
+                    a0(tileOf[c], tileOf[neighbour]) -= 1.0;
+            }
+        };
+        for (const auto c : interior)
+        {
+            addRow(c, Laplacian::Neighbours{{ c - 1, c + 1, c - lineLength, c + lineLength }});
+        }
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            addRow(edge[e], edgeNeighbours[e]);
+        }
+
+        // NOTE(Chris): A tile can be entirely fixed, which leaves an
+        // empty row; put 1 on its diagonal so A_0 stays invertible
+        for (uint t = 0; t < numTiles; ++t)
+        {
+            if (tiles[t].writeBack.empty())
+                a0(t, t) = 1.0;
+        }
+
+        coarse->factor.compute(a0);
+        coarse->rhs.resize(numTiles);
+        coarse->correction.resize(numTiles);
+        coarse->product.assign(lineLength * numLines, 0.0);
+    }
+
+    /// Coarse correction x += R^T A_0^-1 R (b - A x), where b holds
+    /// the fixed points (so R (b - A x) is minus the sum of A x over
+    /// each tile's owned cells)
+    static
+    void
+    CoarseCorrect(const Laplacian::CellGraph& graph, const std::vector<Tile>& tiles,
+                  CoarseSpace* coarse, std::vector<f64>* v)
+    {
+        auto& voltages = *v;
+        auto& product = coarse->product;
+        auto& rhs = coarse->rhs;
+        const uint numTiles = tiles.size();
+
+        Laplacian::ApplyLaplacian(graph, voltages, &product);
+
+#pragma omp parallel for default(none) shared(tiles, product, rhs, numTiles)
+        for (uint t = 0; t < numTiles; ++t)
+        {
+            f64 sum = 0.0;
+            for (const auto& cell : tiles[t].writeBack)
+            {
+                sum -= product[cell.second];
+            }
+            rhs[t] = sum;
+        }
+
+        coarse->correction = coarse->factor.solve(rhs);
+        const auto& correction = coarse->correction;
+
+#pragma omp parallel for default(none) shared(tiles, voltages, correction, numTiles)
+        for (uint t = 0; t < numTiles; ++t)
+        {
+            for (const auto& cell : tiles[t].writeBack)
+            {
+                voltages[cell.second] += correction[t];
+            }
+        }
+    }
+
+    /// Multiplicative Schwarz: each outer iteration applies the coarse
+    /// correction, then solves the tiles of each colour in turn, so
+    /// every tile sees the latest values of its neighbours of the
+    /// other colours. Tiles of one colour never read each other's
+    /// owned cells, so they run in parallel
+    static
+    bool
+    MultiplicativeSchwarz(Grid* grid, const Laplacian::CellGraph& graph,
+                          std::vector<Tile>* tileList,
+                          const std::array<std::vector<uint>, 4>& colours,
+                          const f64 w, const StopParams& stop)
+    {
+        auto& voltages = grid->voltages;
+        auto& tiles = *tileList;
+
+        CoarseSpace coarse;
+        BuildCoarseSpace(graph, tiles, &coarse);
+
+        f64 maxErr = 0.0;
+        for (u64 i = 1; i <= stop.maxIter; ++i)
+        {
+            const bool computeErr = (i % ErrorCheckInterval == 0);
+
+            CoarseCorrect(graph, tiles, &coarse, &voltages);
+
+            maxErr = 0.0;
+            for (const auto& colour : colours)
+            {
+                const uint numTiles = colour.size();
+                f64 colourErr = 0.0;
+#pragma omp parallel for default(none) shared(colour, tiles, voltages, w, computeErr, numTiles) reduction(max:colourErr) schedule(dynamic)
+                for (uint t = 0; t < numTiles; ++t)
+                {
+                    const f64 tileErr = SolveTile(&tiles[colour[t]], &voltages, w, computeErr);
+                    if (tileErr > colourErr)
+                    {
+                        colourErr = tileErr;
+                    }
+                }
+                maxErr = std::max(maxErr, colourErr);
+            }
+
+            if (unlikely(computeErr))
+            {
+                maxErr = stop.monitor.Measure(voltages, maxErr);
+                if (maxErr < stop.zeroTol)
+                {
+                    LOG("Performed %u iterations (%u sweeps per tile), max error: %e",
+                        (unsigned)i, (unsigned)(i * LocalSweeps), maxErr);
+                    return true;
+                }
+
+                // NOTE(Chris): Report error every 500 iterations
+                if (i % 500 == 0)
+                {
+                    LOG("After %u iterations, %s %e", (unsigned)i,
+                        Convergence::CriterionName(Convergence::ActiveCriterion()), maxErr);
+                }
+            }
+        }
+
+        LOG("Overran max iteration counter (%u), max error: %e", (unsigned)stop.maxIter, maxErr);
+        return false;
+    }
+
+    bool
+    SchwarzSolver(Grid* grid, const f64 zeroTol, const u64 maxIter, bool parallel)
+    {
+        TIME_FUNCTION();
+
+        Laplacian::CellGraph graph;
+        if (!Laplacian::BuildCellGraph(*grid, &graph))
+            return false;
+
+        if (graph.NumUnknowns() == 0)
+        {
+            LOG("No unknowns in the grid, nothing to solve");
+            return true;
+        }
+
+        JasUnpack((*grid), lineLength, numLines, horizZip, verticZip);
+
+        const uint numCells = lineLength * numLines;
+        const uint numWorkChunks = (numCells / 20000 > 0) ? (numCells / 20000) : 1;
+        const uint numThreads = (numWorkChunks > (uint)omp_get_max_threads())
+            ? ((MaxThreads > (uint)omp_get_max_threads())
+               ? omp_get_max_threads()
+               : MaxThreads)
+            : numWorkChunks;
+        const uint activeThreads = parallel ? numThreads : 1;
+        omp_set_num_threads(activeThreads);
+
+        // NOTE(Chris): Aim for at least one tile of each colour per
+        // thread, within the size bounds
+        const uint tileSide = std::max(MinTileSize,
+                                       std::min(MaxTileSize,
+                                                (uint)std::sqrt((f64)numCells / (4.0 * activeThreads))));
+        // NOTE(Chris): verticZip wraps in x, horizZip in y
+        const auto xBounds = SplitAxis(lineLength, tileSide, verticZip);
+        const auto yBounds = SplitAxis(numLines, tileSide, horizZip);
+        const uint tilesX = xBounds.size() - 1;
+        const uint tilesY = yBounds.size() - 1;
+
+        std::vector<Tile> tiles;
+        tiles.reserve(tilesX * tilesY);
+        std::array<std::vector<uint>, 4> colours;
+        for (uint ty = 0; ty < tilesY; ++ty)
+        {
+            for (uint tx = 0; tx < tilesX; ++tx)
+            {
+                colours[(tx % 2) + 2 * (ty % 2)].push_back(tiles.size());
+                tiles.push_back(BuildTile(graph, xBounds[tx], xBounds[tx + 1],
+                                          yBounds[ty], yBounds[ty + 1],
+                                          verticZip, horizZip));
+            }
+        }
+
+        // NOTE(Chris): The local sweeps only have to converge on a tile,
+        // the global w (close to 2) is far too large for that, so use
+        // the optimal w of an empty box the size of a tile
+        const uint boxX = std::min(lineLength, tileSide + 2 * Overlap);
+        const uint boxY = std::min(numLines, tileSide + 2 * Overlap);
+        const f64 rhoTile = 0.5 * (std::cos(M_PI / (f64)(boxX + 1))
+                                   + std::cos(M_PI / (f64)(boxY + 1)));
+        const f64 w = Spectral::OptimalOmega(rhoTile);
+        LOG("Schwarz on %u x %u tiles (side %u, overlap %u), w = %f, num threads %u",
+            tilesX, tilesY, tileSide, Overlap, w, activeThreads);
+
+        return MultiplicativeSchwarz(grid, graph, &tiles, colours, w, StopParams(*grid, zeroTol, maxIter));
+    }
+}
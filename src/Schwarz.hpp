@@ -0,0 +1,34 @@
+// -*- c++ -*-
+#if !defined(SCHWARZ_H)
+/* ==========================================================================
+   $File: Schwarz.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define SCHWARZ_H
+// Overlapping domain decomposition, so that the threads synchronise
+// once per tile solve rather than once per sweep
+
+#include "GlobalDefines.hpp"
+
+class Grid;
+
+namespace Schwarz
+{
+    /// Multiplicative overlapping Schwarz iteration. The grid is split
+    /// into 2D tiles, each of which is copied out with an overlap and
+    /// ghost layer (halo exchange), relaxed by several red-black SOR
+    /// sweeps on its own, and its owned cells written back. The tiles
+    /// are coloured so that tiles of one colour can be processed in
+    /// parallel, and a coarse correction with one value per tile ties
+    /// them together. Supports all zip combinations. zeroTol is the max
+    /// relative change of a cell over the final sweep of a tile, and
+    /// maxIter limits the number of outer iterations. Returns true if
+    /// it converged
+    bool
+    SchwarzSolver(Grid* grid, const f64 zeroTol, const u64 maxIter,
+                  bool parallel = true);
+}
+#endif
@@ -0,0 +1,179 @@
+/* ==========================================================================
+   $File: SolutionCache.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "SolutionCache.hpp"
+#include "FieldFile.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace SolutionCache
+{
+    /// Bumped whenever the key or entry format changes, so that old
+    /// entries are never picked up
+    const u32 CacheVersion = 1;
+
+    /// Hashes whether the option is set and its value
+    template <typename T>
+    static
+    u64
+    HashOption(const Jasnah::Option<T>& opt, const u64 seed)
+    {
+        const u8 isSet = (bool)opt;
+        u64 key = Hash64(&isSet, sizeof(isSet), seed);
+        if (opt)
+        {
+            const T value = *opt;
+            key = Hash64(&value, sizeof(value), key);
+        }
+        return key;
+    }
+
+    Jasnah::Option<u64>
+    InputKey(const Cfg::GridConfigData& cfg)
+    {
+        FILE* image = fopen(cfg.imagePath.c_str(), "rb");
+        if (!image)
+        {
+            LOG("Unable to read %s for the cache key", cfg.imagePath.c_str());
+            return Jasnah::None;
+        }
+
+        u64 key = Hash64(&CacheVersion, sizeof(CacheVersion));
+        u8 buf[64 * 1024];
+        size_t bytes;
+        while ((bytes = fread(buf, 1, sizeof(buf), image)) > 0)
+        {
+            key = Hash64(buf, bytes, key);
+        }
+        fclose(image);
+
+        // NOTE(Chris): The colour map is unordered, so hash it in order
+        // of colour
+        std::vector<u32> colours;
+        colours.reserve(cfg.constraints.size());
+        for (const auto& c : cfg.constraints)
+            colours.push_back(c.first);
+        std::sort(colours.begin(), colours.end());
+        for (const auto colour : colours)
+        {
+            const Constraint& constraint = cfg.constraints.at(colour);
+            const i32 type = (i32)constraint.first;
+            key = Hash64(&colour, sizeof(colour), key);
+            key = Hash64(&type, sizeof(type), key);
+            key = Hash64(&constraint.second, sizeof(constraint.second), key);
+        }
+
+        key = HashOption(cfg.scaleFactor, key);
+        key = HashOption(cfg.horizZip, key);
+        key = HashOption(cfg.verticZip, key);
+        key = HashOption(cfg.mode, key);
+        key = HashOption(cfg.zeroTol, key);
+        key = HashOption(cfg.maxIter, key);
+        key = HashOption(cfg.convergence, key);
+        key = HashOption(cfg.scaleResidual, key);
+        key = HashOption(cfg.stencil, key);
+        key = HashOption(cfg.mgCycle, key);
+        key = HashOption(cfg.nestedIteration, key);
+        key = HashOption(cfg.preconditioner, key);
+        key = HashOption(cfg.chebyshev, key);
+        key = HashOption(cfg.anderson, key);
+        key = HashOption(cfg.temporalBlocking, key);
+        key = HashOption(cfg.tiledSweep, key);
+        key = HashOption(cfg.tileWidth, key);
+        key = HashOption(cfg.numProcesses, key);
+        return key;
+    }
+
+    std::string
+    EntryPath(const std::string& directory, const u64 key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.field", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    bool
+    Load(const std::string& directory, const u64 key, Grid* grid)
+    {
+        JasUnpack((*grid), voltages, lineLength, numLines, horizZip, verticZip);
+        const std::string path = EntryPath(directory, key);
+
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        const size_t expected = sizeof(FieldFile::Header) + voltages.size() * sizeof(f64);
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size != expected)
+        {
+            LOG("Cache entry %s doesn't match the grid, ignoring", path.c_str());
+            close(fd);
+            return false;
+        }
+
+        void* base = mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+        {
+            LOG("Unable to map cache entry %s", path.c_str());
+            return false;
+        }
+
+        const FieldFile::Header* header = (const FieldFile::Header*)base;
+        const bool matches = std::equal(header->magic, header->magic + sizeof(header->magic),
+                                        FieldFile::FieldMagic)
+            && header->lineLength == lineLength
+            && header->numLines == numLines
+            && (bool)header->horizZip == horizZip
+            && (bool)header->verticZip == verticZip;
+
+        if (matches)
+        {
+            const f64* values = (const f64*)((const u8*)base + sizeof(FieldFile::Header));
+            std::copy(values, values + voltages.size(), voltages.begin());
+            LOG("Loaded solution from cache entry %s", path.c_str());
+        }
+        else
+        {
+            LOG("Cache entry %s doesn't match the grid, ignoring", path.c_str());
+        }
+
+        munmap(base, expected);
+        return matches;
+    }
+
+    bool
+    Store(const std::string& directory, const u64 key, const Grid& grid)
+    {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            LOG("Unable to create cache directory %s", directory.c_str());
+            return false;
+        }
+
+        const std::string path = EntryPath(directory, key);
+        const std::string tempPath = path + ".tmp" + std::to_string(getpid());
+        if (!FieldFile::WriteField(grid, tempPath.c_str()))
+            return false;
+
+        if (rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            LOG("Unable to move cache entry into place at %s", path.c_str());
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+// -*- c++ -*-
+#if !defined(SOLUTIONCACHE_H)
+/* ==========================================================================
+   $File: SolutionCache.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define SOLUTIONCACHE_H
+// On-disk cache of solved grids. Each entry is a field file named by
+// the hash of everything the solution depends on, so re-running an
+// identical config just maps the previous solution back in
+
+#include "GlobalDefines.hpp"
+#include "Jasnah.hpp"
+#include "JSON.hpp"
+#include <string>
+
+class Grid;
+
+namespace SolutionCache
+{
+    /// Hash of the full input of a solve: the bytes of the image, the
+    /// colour map, the scale factor, the zips, and the mode, tolerances
+    /// and options of the solver. None if the image can't be read
+    Jasnah::Option<u64>
+    InputKey(const Cfg::GridConfigData& cfg);
+
+    /// Path of the entry for key in the cache directory
+    std::string
+    EntryPath(const std::string& directory, const u64 key);
+
+    /// Maps the entry for key and copies it into the grid's voltages.
+    /// Returns false if there is no entry, or if it doesn't match the
+    /// grid (in which case the grid is left alone)
+    bool
+    Load(const std::string& directory, const u64 key, Grid* grid);
+
+    /// Stores the solved grid under key, creating the directory if
+    /// needed. The entry is written under a temporary name and then
+    /// renamed, so concurrent runs never see a partial entry
+    bool
+    Store(const std::string& directory, const u64 key, const Grid& grid);
+}
+#endif
@@ -0,0 +1,219 @@
+/* ==========================================================================
+   $File: SpectralRadius.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "SpectralRadius.hpp"
+#include "Grid.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+namespace Spectral
+{
+    /// Max number of Lanczos steps (each costs about as much as one
+    /// sweep of the solver)
+    const uint MaxLanczosSteps = 1000;
+
+    /// The smallest Ritz value is re-evaluated every so many steps
+    const uint RitzCheckInterval = 10;
+
+    /// Relative change in the smallest Ritz value between checks
+    /// below which it is considered converged
+    const f64 RitzTol = 1e-3;
+
+    /// Number of eigenvalues of the symmetric tridiagonal matrix with
+    /// diagonal alpha and off-diagonal beta that are less than x
+    /// (Sturm sequence count)
+    static
+    uint
+    CountBelow(const std::vector<f64>& alpha, const std::vector<f64>& beta, const f64 x)
+    {
+        uint count = 0;
+        f64 d = 1.0;
+        for (uint i = 0; i < alpha.size(); ++i)
+        {
+            d = alpha[i] - x - ((i > 0) ? Square(beta[i - 1]) / d : 0.0);
+            // NOTE(Chris): Nudge an exact 0 pivot, as is standard
+            if (d == 0.0)
+                d = -1e-300;
+            if (d < 0.0)
+                ++count;
+        }
+        return count;
+    }
+
+    /// Smallest eigenvalue of the symmetric tridiagonal matrix, by
+    /// bisection
+    static
+    f64
+    SmallestEigenvalue(const std::vector<f64>& alpha, const std::vector<f64>& beta)
+    {
+        // NOTE(Chris): Gershgorin lower bound, and the first diagonal
+        // entry is a Rayleigh quotient so an upper bound
+        f64 lo = alpha[0];
+        for (uint i = 0; i < alpha.size(); ++i)
+        {
+            const f64 radius = ((i > 0) ? std::abs(beta[i - 1]) : 0.0)
+                + ((i + 1 < alpha.size()) ? std::abs(beta[i]) : 0.0);
+            lo = std::min(lo, alpha[i] - radius);
+        }
+        f64 hi = alpha[0];
+
+        for (uint iter = 0; iter < 100 && hi - lo > 1e-15 * std::abs(hi); ++iter)
+        {
+            const f64 mid = 0.5 * (lo + hi);
+            if (CountBelow(alpha, beta, mid) > 0)
+                hi = mid;
+            else
+                lo = mid;
+        }
+        return 0.5 * (lo + hi);
+    }
+
+    f64
+    EstimateJacobiRadius(const Laplacian::CellGraph& graph)
+    {
+        TIME_FUNCTION();
+
+        JasUnpack(graph, interior, edge);
+
+        std::vector<uint> cells;
+        cells.reserve(graph.NumUnknowns());
+        cells.insert(cells.end(), interior.begin(), interior.end());
+        cells.insert(cells.end(), edge.begin(), edge.end());
+
+        if (cells.empty())
+            return 0.0;
+
+        // NOTE(Chris): Lanczos on A (the vectors stay 0 on the fixed
+        // cells, so ApplyLaplacian acts as the matrix of the unknowns).
+        // A constant start vector overlaps strongly with the smoothest
+        // mode of every connected region, which is the one we want
+        const uint numCells = graph.lineLength * graph.numLines;
+        std::vector<f64> q(numCells, 0.0);
+        std::vector<f64> qPrev(numCells, 0.0);
+        std::vector<f64> w(numCells, 0.0);
+
+        const f64 startNorm = 1.0 / std::sqrt((f64)cells.size());
+        for (const auto c : cells)
+            q[c] = startNorm;
+
+        std::vector<f64> alpha;
+        std::vector<f64> beta;
+        const uint maxSteps = std::min(MaxLanczosSteps, (uint)cells.size());
+        alpha.reserve(maxSteps);
+        beta.reserve(maxSteps);
+
+        f64 lambdaMin = 0.0;
+        f64 prevLambdaMin = 0.0;
+        for (uint step = 0; step < maxSteps; ++step)
+        {
+            Laplacian::ApplyLaplacian(graph, q, &w);
+
+            const f64 a = Laplacian::Dot(cells, q, w);
+            const f64 b = (step > 0) ? beta.back() : 0.0;
+            for (const auto c : cells)
+                w[c] -= a * q[c] + b * qPrev[c];
+
+            const f64 bNext = std::sqrt(Laplacian::Dot(cells, w, w));
+            alpha.push_back(a);
+            beta.push_back(bNext);
+
+            const bool invariant = (bNext < 1e-12 * std::abs(a));
+            if (invariant || (step + 1) % RitzCheckInterval == 0 || step + 1 == maxSteps)
+            {
+                lambdaMin = SmallestEigenvalue(alpha, beta);
+                if (invariant
+                    || (step + 1 > RitzCheckInterval
+                        && std::abs(lambdaMin - prevLambdaMin) < RitzTol * lambdaMin))
+                {
+                    LOG("Lanczos converged after %u steps", step + 1);
+                    break;
+                }
+                prevLambdaMin = lambdaMin;
+            }
+
+            std::swap(qPrev, q);
+            for (const auto c : cells)
+                q[c] = w[c] / bNext;
+        }
+
+        return std::max(0.0, 1.0 - 0.25 * lambdaMin);
+    }
+
+    /// Radii computed so far during this run, by geometry key
+    static
+    std::unordered_map<u64, f64>&
+    RadiusCache()
+    {
+        static std::unordered_map<u64, f64> cache;
+        return cache;
+    }
+
+    /// Looks up key in the cache file, returns true if found
+    static
+    bool
+    ReadCachedRadius(const char* path, const u64 key, f64* rho)
+    {
+        FILE* in = fopen(path, "r");
+        if (!in)
+            return false;
+
+        bool found = false;
+        unsigned long long fileKey;
+        f64 fileRho;
+        while (fscanf(in, "%llx %lf", &fileKey, &fileRho) == 2)
+        {
+            // NOTE(Chris): Keep going, the last entry for a key wins
+            if ((u64)fileKey == key)
+            {
+                *rho = fileRho;
+                found = true;
+            }
+        }
+        fclose(in);
+        return found;
+    }
+
+    f64
+    JacobiRadius(const Grid& grid, const Laplacian::CellGraph& graph)
+    {
+        const u64 key = Laplacian::GeometryKey(grid, graph);
+
+        auto& cache = RadiusCache();
+        const auto cached = cache.find(key);
+        if (cached != cache.end())
+        {
+            LOG("Reusing Jacobi spectral radius %f from memory", cached->second);
+            return cached->second;
+        }
+
+        f64 rho;
+        if (ReadCachedRadius(Version::OmegaCache, key, &rho))
+        {
+            LOG("Reusing Jacobi spectral radius %f from %s", rho, Version::OmegaCache);
+            cache[key] = rho;
+            return rho;
+        }
+
+        rho = EstimateJacobiRadius(graph);
+        LOG("Estimated Jacobi spectral radius %f", rho);
+        cache[key] = rho;
+
+        FILE* out = fopen(Version::OmegaCache, "a");
+        if (out)
+        {
+            fprintf(out, "%016llx %.17g\n", (unsigned long long)key, rho);
+            fclose(out);
+        }
+        else
+        {
+            LOG("Unable to write %s", Version::OmegaCache);
+        }
+        return rho;
+    }
+}
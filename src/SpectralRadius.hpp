@@ -0,0 +1,44 @@
+// -*- c++ -*-
+#if !defined(SPECTRALRADIUS_H)
+/* ==========================================================================
+   $File: SpectralRadius.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define SPECTRALRADIUS_H
+// Estimates of the convergence rate of the stationary iterations on
+// the actual set of non-fixed cells, to choose the relaxation factor
+
+#include "GlobalDefines.hpp"
+#include "Laplacian.hpp"
+
+#include <cmath>
+
+class Grid;
+
+namespace Spectral
+{
+    /// Estimates the spectral radius of the Jacobi iteration matrix
+    /// I - A/4 on the non-fixed cells of the graph, from the smallest
+    /// eigenvalue of A found by a Lanczos iteration. The estimate
+    /// approaches the true value from below
+    f64
+    EstimateJacobiRadius(const Laplacian::CellGraph& graph);
+
+    /// Returns the Jacobi spectral radius for the grid, estimating it
+    /// only if it isn't already known for this geometry, from this
+    /// run or from a previous one (via Version::OmegaCache)
+    f64
+    JacobiRadius(const Grid& grid, const Laplacian::CellGraph& graph);
+
+    /// Optimal SOR over-relaxation factor for a consistently ordered
+    /// matrix with Jacobi spectral radius rho
+    inline f64
+    OptimalOmega(const f64 rho)
+    {
+        return 2.0 / (1.0 + std::sqrt(1.0 - rho * rho));
+    }
+}
+#endif
@@ -0,0 +1,662 @@
+/* ==========================================================================
+   $File: Stencil.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Stencil.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <cstring>
+
+// NOTE(Chris): GCC contracts a * b + c into an FMA wherever it likes in
+// C++ (even in ISO mode), and it makes different choices for the
+// scalar and vector loops, so turn that off here to keep the
+// instruction sets giving identical iterates
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#if defined(USE_SIMD) && defined(__x86_64__)
+#define STENCIL_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Stencil
+{
+    // NOTE(Chris): All of the kernels sum the neighbours in the same
+    // order as the scalar ones (right, left, up, down) and don't use
+    // FMA, so every instruction set gives bit-identical iterates
+
+    /// Scalar Jacobi row kernel, Masked selects whether update is used
+    template <bool Masked>
+    static
+    f64
+    JacobiRowScalar(const f64* in, f64* out, const u8* update, const uint lineLength,
+                    const uint begin, const uint end, const bool computeErr)
+    {
+        const f64* up = in - lineLength;
+        const f64* down = in + lineLength;
+        f64 maxErr = 0.0;
+        for (uint x = begin; x < end; ++x)
+        {
+            if (Masked && !update[x])
+            {
+                out[x] = in[x];
+                continue;
+            }
+
+            const f64 newVal = 0.25 * (in[x + 1] + in[x - 1] + up[x] + down[x]);
+            out[x] = newVal;
+
+            if (unlikely(computeErr))
+            {
+                const f64 absErr = std::abs((in[x] - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                    maxErr = absErr;
+            }
+        }
+        return maxErr;
+    }
+
+    static
+    f64
+    SORRowScalar(f64* v, const u8* update, const uint lineLength, const uint begin, const uint end,
+                 const f64 w, const bool computeErr)
+    {
+        const f64* up = v - lineLength;
+        const f64* down = v + lineLength;
+        f64 maxErr = 0.0;
+        for (uint x = begin; x < end; ++x)
+        {
+            if (!update[x])
+                continue;
+
+            const f64 prev = v[x];
+            const f64 phiI = 0.25 * (v[x + 1] + v[x - 1] + up[x] + down[x]);
+            const f64 newVal = (1.0 - w) * prev + w * phiI;
+            v[x] = newVal;
+
+            if (unlikely(computeErr))
+            {
+                const f64 absErr = std::abs((prev - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                    maxErr = absErr;
+            }
+        }
+        return maxErr;
+    }
+
+    static
+    f64
+    SplitRowScalar(f64* row, const f64* right, const f64* left, const f64* up, const f64* down,
+                   const u8* update, const uint begin, const uint end, const f64 w,
+                   const bool computeErr)
+    {
+        f64 maxErr = 0.0;
+        for (uint i = begin; i < end; ++i)
+        {
+            const f64 prev = row[i];
+            const f64 phiI = 0.25 * (right[i] + left[i] + up[i] + down[i]);
+            const f64 newVal = update[i] ? (1.0 - w) * prev + w * phiI : prev;
+            row[i] = newVal;
+
+            if (unlikely(computeErr))
+            {
+                const f64 absErr = std::abs((prev - newVal) / newVal);
+                if (absErr > maxErr && absErr == absErr)
+                    maxErr = absErr;
+            }
+        }
+        return maxErr;
+    }
+
+    static
+    void
+    SplitRowF32Scalar(f32* row, const f32* right, const f32* left, const f32* up, const f32* down,
+                      const f32* rhs, const u8* update, const uint begin, const uint end, const f32 w)
+    {
+        for (uint i = begin; i < end; ++i)
+        {
+            const f32 prev = row[i];
+            const f32 phiI = 0.25f * (right[i] + left[i] + up[i] + down[i]) + rhs[i];
+            row[i] = update[i] ? (1.0f - w) * prev + w * phiI : prev;
+        }
+    }
+
+#ifdef STENCIL_X86_SIMD
+    // NOTE(Chris): The max instructions return their second operand if
+    // either is NaN, so passing the running max second drops the NaNs
+    // from 0/0, as the scalar check does
+
+    /// Loads 4 entries of the update mask as a vector mask
+    __attribute__((target("avx2")))
+    static inline
+    __m256i
+    LoadMaskAVX2(const u8* update)
+    {
+        i32 bits;
+        memcpy(&bits, update, sizeof(bits));
+        const __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bits));
+        return _mm256_cmpgt_epi64(wide, _mm256_setzero_si256());
+    }
+
+    __attribute__((target("avx2")))
+    static inline
+    f64
+    HorizontalMaxAVX2(__m256d v)
+    {
+        const __m128d half = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        const __m128d quarter = _mm_max_pd(half, _mm_unpackhi_pd(half, half));
+        return _mm_cvtsd_f64(quarter);
+    }
+
+    template <bool Masked>
+    __attribute__((target("avx2")))
+    static
+    f64
+    JacobiRowAVX2(const f64* in, f64* out, const u8* update, const uint lineLength,
+                  const uint begin, const uint end, const bool computeErr)
+    {
+        const f64* up = in - lineLength;
+        const f64* down = in + lineLength;
+        const __m256d quarter = _mm256_set1_pd(0.25);
+        const __m256d signBit = _mm256_set1_pd(-0.0);
+        __m256d err = _mm256_setzero_pd();
+
+        uint x = begin;
+        for (; x + 4 <= end; x += 4)
+        {
+            const __m256d prev = _mm256_loadu_pd(in + x);
+            const __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_loadu_pd(in + x + 1),
+                                                                          _mm256_loadu_pd(in + x - 1)),
+                                                            _mm256_loadu_pd(up + x)),
+                                              _mm256_loadu_pd(down + x));
+            __m256d newVal = _mm256_mul_pd(quarter, sum);
+            if (Masked)
+                newVal = _mm256_blendv_pd(prev, newVal, _mm256_castsi256_pd(LoadMaskAVX2(update + x)));
+            _mm256_storeu_pd(out + x, newVal);
+
+            if (unlikely(computeErr))
+            {
+                // NOTE(Chris): Cells that aren't updated give 0 or NaN
+                const __m256d rel = _mm256_div_pd(_mm256_sub_pd(prev, newVal), newVal);
+                err = _mm256_max_pd(_mm256_andnot_pd(signBit, rel), err);
+            }
+        }
+
+        const f64 tailErr = JacobiRowScalar<Masked>(in, out, update, lineLength, x, end, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX2(err), tailErr) : 0.0;
+    }
+
+    /// Returns the right neighbours of the lanes of a, where b follows
+    /// a along the row, i.e. [a1 a2 a3 b0]
+    __attribute__((target("avx2")))
+    static inline
+    __m256d
+    RightNeighboursAVX2(__m256d a, __m256d b)
+    {
+        const __m256d straddle = _mm256_permute2f128_pd(a, b, 0x21);
+        return _mm256_shuffle_pd(a, straddle, 0x5);
+    }
+
+    /// Returns the left neighbours of the lanes of b, where b follows
+    /// a along the row, i.e. [a3 b0 b1 b2]
+    __attribute__((target("avx2")))
+    static inline
+    __m256d
+    LeftNeighboursAVX2(__m256d a, __m256d b)
+    {
+        const __m256d straddle = _mm256_permute2f128_pd(a, b, 0x21);
+        return _mm256_shuffle_pd(straddle, b, 0x5);
+    }
+
+    __attribute__((target("avx2")))
+    static
+    f64
+    SORRowAVX2(f64* v, const u8* update, const uint lineLength, const uint begin, const uint end,
+               const f64 w, const bool computeErr)
+    {
+        const f64* up = v - lineLength;
+        const f64* down = v + lineLength;
+        const __m256d quarter = _mm256_set1_pd(0.25);
+        const __m256d weight = _mm256_set1_pd(w);
+        const __m256d oneMinusW = _mm256_set1_pd(1.0 - w);
+        const __m256d signBit = _mm256_set1_pd(-0.0);
+        __m256d err = _mm256_setzero_pd();
+
+        // NOTE(Chris): The update is in place, so rather than loading
+        // the left and right neighbours from memory (which would overlap
+        // the previous store and stall the store forwarding), they are
+        // shifted out of the vectors on either side. These hold the
+        // values from before the update, but the neighbours of updated
+        // cells are of the other colour and so don't change. The load
+        // of the next vector can read up to 3 cells past end, which are
+        // at worst in the row below
+        uint x = begin;
+        if (x + 4 <= end)
+        {
+            __m256d left = _mm256_loadu_pd(v + x - 1);
+            __m256d prev = _mm256_loadu_pd(v + x);
+            for (; x + 4 <= end; x += 4)
+            {
+                const __m256i mask = LoadMaskAVX2(update + x);
+                const __m256d next = _mm256_loadu_pd(v + x + 4);
+                const __m256d right = RightNeighboursAVX2(prev, next);
+                const __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(right, left),
+                                                                _mm256_loadu_pd(up + x)),
+                                                  _mm256_loadu_pd(down + x));
+                const __m256d phiI = _mm256_mul_pd(quarter, sum);
+                const __m256d newVal = _mm256_add_pd(_mm256_mul_pd(oneMinusW, prev), _mm256_mul_pd(weight, phiI));
+                // NOTE(Chris): The cells of the other colour are never
+                // written, they may be read by the threads working on the
+                // neighbouring rows
+                _mm256_maskstore_pd(v + x, mask, newVal);
+
+                if (unlikely(computeErr))
+                {
+                    const __m256d rel = _mm256_div_pd(_mm256_sub_pd(prev, newVal), newVal);
+                    const __m256d absErr = _mm256_and_pd(_mm256_andnot_pd(signBit, rel), _mm256_castsi256_pd(mask));
+                    err = _mm256_max_pd(absErr, err);
+                }
+
+                left = LeftNeighboursAVX2(prev, next);
+                prev = next;
+            }
+        }
+
+        const f64 tailErr = SORRowScalar(v, update, lineLength, x, end, w, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX2(err), tailErr) : 0.0;
+    }
+
+    __attribute__((target("avx2")))
+    static
+    f64
+    SplitRowAVX2(f64* row, const f64* right, const f64* left, const f64* up, const f64* down,
+                 const u8* update, const uint begin, const uint end, const f64 w,
+                 const bool computeErr)
+    {
+        const __m256d quarter = _mm256_set1_pd(0.25);
+        const __m256d weight = _mm256_set1_pd(w);
+        const __m256d oneMinusW = _mm256_set1_pd(1.0 - w);
+        const __m256d signBit = _mm256_set1_pd(-0.0);
+        __m256d err = _mm256_setzero_pd();
+
+        // NOTE(Chris): The neighbours live in the arrays of the other
+        // colour, so every lane is useful and there's nothing to stall
+        // on. Only this row is written, so the masked lanes can simply
+        // be blended back and stored
+        uint i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            const __m256d prev = _mm256_loadu_pd(row + i);
+            const __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_loadu_pd(right + i),
+                                                                          _mm256_loadu_pd(left + i)),
+                                                            _mm256_loadu_pd(up + i)),
+                                              _mm256_loadu_pd(down + i));
+            const __m256d phiI = _mm256_mul_pd(quarter, sum);
+            __m256d newVal = _mm256_add_pd(_mm256_mul_pd(oneMinusW, prev), _mm256_mul_pd(weight, phiI));
+            newVal = _mm256_blendv_pd(prev, newVal, _mm256_castsi256_pd(LoadMaskAVX2(update + i)));
+            _mm256_storeu_pd(row + i, newVal);
+
+            if (unlikely(computeErr))
+            {
+                const __m256d rel = _mm256_div_pd(_mm256_sub_pd(prev, newVal), newVal);
+                err = _mm256_max_pd(_mm256_andnot_pd(signBit, rel), err);
+            }
+        }
+
+        const f64 tailErr = SplitRowScalar(row, right, left, up, down, update, i, end, w, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX2(err), tailErr) : 0.0;
+    }
+
+    __attribute__((target("avx2")))
+    static
+    void
+    SplitRowF32AVX2(f32* row, const f32* right, const f32* left, const f32* up, const f32* down,
+                    const f32* rhs, const u8* update, const uint begin, const uint end, const f32 w)
+    {
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 weight = _mm256_set1_ps(w);
+        const __m256 oneMinusW = _mm256_set1_ps(1.0f - w);
+
+        uint i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            i64 bits;
+            memcpy(&bits, update + i, sizeof(bits));
+            const __m256i wide = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(bits));
+            const __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(wide, _mm256_setzero_si256()));
+
+            const __m256 prev = _mm256_loadu_ps(row + i);
+            const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(right + i),
+                                                                         _mm256_loadu_ps(left + i)),
+                                                           _mm256_loadu_ps(up + i)),
+                                             _mm256_loadu_ps(down + i));
+            const __m256 phiI = _mm256_add_ps(_mm256_mul_ps(quarter, sum), _mm256_loadu_ps(rhs + i));
+            const __m256 newVal = _mm256_add_ps(_mm256_mul_ps(oneMinusW, prev), _mm256_mul_ps(weight, phiI));
+            _mm256_storeu_ps(row + i, _mm256_blendv_ps(prev, newVal, mask));
+        }
+
+        SplitRowF32Scalar(row, right, left, up, down, rhs, update, i, end, w);
+    }
+
+    /// Loads 8 entries of the update mask as a mask register
+    static inline
+    __mmask8
+    LoadMaskAVX512(const u8* update)
+    {
+        // NOTE(Chris): Fold each byte onto its low bit (the shifts only
+        // bring bits of the next byte into the upper bits), then the
+        // multiply gathers the low bit of byte k into bit 56 + k
+        // without any carries
+        u64 bits;
+        memcpy(&bits, update, sizeof(bits));
+        bits |= bits >> 4;
+        bits |= bits >> 2;
+        bits |= bits >> 1;
+        bits &= 0x0101010101010101ULL;
+        return (__mmask8)((bits * 0x0102040810204080ULL) >> 56);
+    }
+
+    __attribute__((target("avx512f")))
+    static inline
+    __m512d
+    AbsAVX512(__m512d v)
+    {
+        return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(v),
+                                                    _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL)));
+    }
+
+    __attribute__((target("avx512f")))
+    static inline
+    f64
+    HorizontalMaxAVX512(__m512d v)
+    {
+        alignas(64) f64 lanes[8];
+        _mm512_store_pd(lanes, v);
+        f64 result = lanes[0];
+        for (uint i = 1; i < 8; ++i)
+            result = std::max(result, lanes[i]);
+        return result;
+    }
+
+    template <bool Masked>
+    __attribute__((target("avx512f")))
+    static
+    f64
+    JacobiRowAVX512(const f64* in, f64* out, const u8* update, const uint lineLength,
+                    const uint begin, const uint end, const bool computeErr)
+    {
+        const f64* up = in - lineLength;
+        const f64* down = in + lineLength;
+        const __m512d quarter = _mm512_set1_pd(0.25);
+        __m512d err = _mm512_setzero_pd();
+
+        uint x = begin;
+        for (; x + 8 <= end; x += 8)
+        {
+            const __m512d prev = _mm512_loadu_pd(in + x);
+            const __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(_mm512_loadu_pd(in + x + 1),
+                                                                          _mm512_loadu_pd(in + x - 1)),
+                                                            _mm512_loadu_pd(up + x)),
+                                              _mm512_loadu_pd(down + x));
+            const __mmask8 mask = Masked ? LoadMaskAVX512(update + x) : (__mmask8)0xFF;
+            const __m512d newVal = _mm512_mask_blend_pd(mask, prev, _mm512_mul_pd(quarter, sum));
+            _mm512_storeu_pd(out + x, newVal);
+
+            if (unlikely(computeErr))
+            {
+                const __m512d rel = _mm512_div_pd(_mm512_sub_pd(prev, newVal), newVal);
+                err = _mm512_mask_max_pd(err, mask, AbsAVX512(rel), err);
+            }
+        }
+
+        const f64 tailErr = JacobiRowScalar<Masked>(in, out, update, lineLength, x, end, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX512(err), tailErr) : 0.0;
+    }
+
+    __attribute__((target("avx512f")))
+    static
+    f64
+    SORRowAVX512(f64* v, const u8* update, const uint lineLength, const uint begin, const uint end,
+                 const f64 w, const bool computeErr)
+    {
+        const f64* up = v - lineLength;
+        const f64* down = v + lineLength;
+        const __m512d quarter = _mm512_set1_pd(0.25);
+        const __m512d weight = _mm512_set1_pd(w);
+        const __m512d oneMinusW = _mm512_set1_pd(1.0 - w);
+        // NOTE(Chris): Lanes 1-8 and 7-14 of a pair of vectors
+        const __m512i rightIdx = _mm512_set_epi64(8, 7, 6, 5, 4, 3, 2, 1);
+        const __m512i leftIdx = _mm512_set_epi64(14, 13, 12, 11, 10, 9, 8, 7);
+        __m512d err = _mm512_setzero_pd();
+
+        // NOTE(Chris): As in the AVX2 version, the left and right
+        // neighbours are shifted out of the surrounding vectors rather
+        // than reloaded from behind the in-place stores
+        uint x = begin;
+        if (x + 8 <= end)
+        {
+            __m512d left = _mm512_loadu_pd(v + x - 1);
+            __m512d prev = _mm512_loadu_pd(v + x);
+            for (; x + 8 <= end; x += 8)
+            {
+                const __mmask8 mask = LoadMaskAVX512(update + x);
+                const __m512d next = _mm512_loadu_pd(v + x + 8);
+                const __m512d right = _mm512_permutex2var_pd(prev, rightIdx, next);
+                const __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(right, left),
+                                                                _mm512_loadu_pd(up + x)),
+                                                  _mm512_loadu_pd(down + x));
+                const __m512d phiI = _mm512_mul_pd(quarter, sum);
+                const __m512d newVal = _mm512_add_pd(_mm512_mul_pd(oneMinusW, prev), _mm512_mul_pd(weight, phiI));
+                _mm512_mask_storeu_pd(v + x, mask, newVal);
+
+                if (unlikely(computeErr))
+                {
+                    const __m512d rel = _mm512_div_pd(_mm512_sub_pd(prev, newVal), newVal);
+                    err = _mm512_mask_max_pd(err, mask, AbsAVX512(rel), err);
+                }
+
+                left = _mm512_permutex2var_pd(prev, leftIdx, next);
+                prev = next;
+            }
+        }
+
+        const f64 tailErr = SORRowScalar(v, update, lineLength, x, end, w, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX512(err), tailErr) : 0.0;
+    }
+
+    __attribute__((target("avx512f")))
+    static
+    f64
+    SplitRowAVX512(f64* row, const f64* right, const f64* left, const f64* up, const f64* down,
+                   const u8* update, const uint begin, const uint end, const f64 w,
+                   const bool computeErr)
+    {
+        const __m512d quarter = _mm512_set1_pd(0.25);
+        const __m512d weight = _mm512_set1_pd(w);
+        const __m512d oneMinusW = _mm512_set1_pd(1.0 - w);
+        __m512d err = _mm512_setzero_pd();
+
+        uint i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            const __m512d prev = _mm512_loadu_pd(row + i);
+            const __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(_mm512_loadu_pd(right + i),
+                                                                          _mm512_loadu_pd(left + i)),
+                                                            _mm512_loadu_pd(up + i)),
+                                              _mm512_loadu_pd(down + i));
+            const __m512d phiI = _mm512_mul_pd(quarter, sum);
+            const __m512d newVal = _mm512_add_pd(_mm512_mul_pd(oneMinusW, prev), _mm512_mul_pd(weight, phiI));
+            const __mmask8 mask = LoadMaskAVX512(update + i);
+            _mm512_mask_storeu_pd(row + i, mask, newVal);
+
+            if (unlikely(computeErr))
+            {
+                const __m512d rel = _mm512_div_pd(_mm512_sub_pd(prev, newVal), newVal);
+                err = _mm512_mask_max_pd(err, mask, AbsAVX512(rel), err);
+            }
+        }
+
+        const f64 tailErr = SplitRowScalar(row, right, left, up, down, update, i, end, w, computeErr);
+        return computeErr ? std::max(HorizontalMaxAVX512(err), tailErr) : 0.0;
+    }
+
+    __attribute__((target("avx512f")))
+    static
+    void
+    SplitRowF32AVX512(f32* row, const f32* right, const f32* left, const f32* up, const f32* down,
+                      const f32* rhs, const u8* update, const uint begin, const uint end, const f32 w)
+    {
+        const __m512 quarter = _mm512_set1_ps(0.25f);
+        const __m512 weight = _mm512_set1_ps(w);
+        const __m512 oneMinusW = _mm512_set1_ps(1.0f - w);
+
+        uint i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            const __mmask16 mask = (__mmask16)(LoadMaskAVX512(update + i)
+                                               | (LoadMaskAVX512(update + i + 8) << 8));
+
+            const __m512 prev = _mm512_loadu_ps(row + i);
+            const __m512 sum = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_loadu_ps(right + i),
+                                                                         _mm512_loadu_ps(left + i)),
+                                                           _mm512_loadu_ps(up + i)),
+                                             _mm512_loadu_ps(down + i));
+            const __m512 phiI = _mm512_add_ps(_mm512_mul_ps(quarter, sum), _mm512_loadu_ps(rhs + i));
+            const __m512 newVal = _mm512_add_ps(_mm512_mul_ps(oneMinusW, prev), _mm512_mul_ps(weight, phiI));
+            _mm512_mask_storeu_ps(row + i, mask, newVal);
+        }
+
+        SplitRowF32Scalar(row, right, left, up, down, rhs, update, i, end, w);
+    }
+#endif
+
+    /// Best instruction set supported by both the build and the CPU
+    static
+    InstructionSet
+    BestInstructionSet()
+    {
+#ifdef STENCIL_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return InstructionSet::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::AVX2;
+#endif
+        return InstructionSet::Scalar;
+    }
+
+    static
+    InstructionSet&
+    Active()
+    {
+        static InstructionSet isa = BestInstructionSet();
+        return isa;
+    }
+
+    InstructionSet
+    ActiveInstructionSet()
+    {
+        return Active();
+    }
+
+    const char*
+    InstructionSetName(InstructionSet isa)
+    {
+        switch (isa)
+        {
+        case InstructionSet::AVX512:
+            return "AVX-512";
+        case InstructionSet::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+        }
+    }
+
+    void
+    SelectInstructionSet(InstructionSet isa)
+    {
+        const InstructionSet best = BestInstructionSet();
+        Active() = ((int)isa < (int)best) ? isa : best;
+    }
+
+    f64
+    JacobiRow(const f64* in, f64* out, const u8* update, const uint lineLength,
+              const uint begin, const uint end, const bool computeErr)
+    {
+        switch (Active())
+        {
+#ifdef STENCIL_X86_SIMD
+        case InstructionSet::AVX512:
+            return update ? JacobiRowAVX512<true>(in, out, update, lineLength, begin, end, computeErr)
+                          : JacobiRowAVX512<false>(in, out, update, lineLength, begin, end, computeErr);
+        case InstructionSet::AVX2:
+            return update ? JacobiRowAVX2<true>(in, out, update, lineLength, begin, end, computeErr)
+                          : JacobiRowAVX2<false>(in, out, update, lineLength, begin, end, computeErr);
+#endif
+        default:
+            return update ? JacobiRowScalar<true>(in, out, update, lineLength, begin, end, computeErr)
+                          : JacobiRowScalar<false>(in, out, update, lineLength, begin, end, computeErr);
+        }
+    }
+
+    f64
+    SORRow(f64* v, const u8* update, const uint lineLength, const uint begin, const uint end,
+           const f64 w, const bool computeErr)
+    {
+        switch (Active())
+        {
+#ifdef STENCIL_X86_SIMD
+        case InstructionSet::AVX512:
+            return SORRowAVX512(v, update, lineLength, begin, end, w, computeErr);
+        case InstructionSet::AVX2:
+            return SORRowAVX2(v, update, lineLength, begin, end, w, computeErr);
+#endif
+        default:
+            return SORRowScalar(v, update, lineLength, begin, end, w, computeErr);
+        }
+    }
+
+    f64
+    SplitRow(f64* row, const f64* right, const f64* left, const f64* up, const f64* down,
+             const u8* update, const uint begin, const uint end, const f64 w,
+             const bool computeErr)
+    {
+        switch (Active())
+        {
+#ifdef STENCIL_X86_SIMD
+        case InstructionSet::AVX512:
+            return SplitRowAVX512(row, right, left, up, down, update, begin, end, w, computeErr);
+        case InstructionSet::AVX2:
+            return SplitRowAVX2(row, right, left, up, down, update, begin, end, w, computeErr);
+#endif
+        default:
+            return SplitRowScalar(row, right, left, up, down, update, begin, end, w, computeErr);
+        }
+    }
+
+    void
+    SplitRowF32(f32* row, const f32* right, const f32* left, const f32* up, const f32* down,
+                const f32* rhs, const u8* update, const uint begin, const uint end, const f32 w)
+    {
+        switch (Active())
+        {
+#ifdef STENCIL_X86_SIMD
+        case InstructionSet::AVX512:
+            SplitRowF32AVX512(row, right, left, up, down, rhs, update, begin, end, w);
+            break;
+        case InstructionSet::AVX2:
+            SplitRowF32AVX2(row, right, left, up, down, rhs, update, begin, end, w);
+            break;
+#endif
+        default:
+            SplitRowF32Scalar(row, right, left, up, down, rhs, update, begin, end, w);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+// -*- c++ -*-
+#if !defined(STENCIL_H)
+/* ==========================================================================
+   $File: Stencil.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define STENCIL_H
+// Row kernels for the 5-point stencil. These sweep contiguous
+// segments of a row, rather than gathering through a list of indices,
+// so they can be vectorised. With USE_SIMD the AVX2 and AVX-512
+// versions are chosen at runtime from what the CPU supports
+
+#include "GlobalDefines.hpp"
+
+namespace Stencil
+{
+    /// Instruction sets the kernels are available for
+    enum class InstructionSet
+    {
+        Scalar,
+        AVX2,
+        AVX512
+    };
+
+    /// Returns the instruction set currently used by the kernels
+    InstructionSet
+    ActiveInstructionSet();
+
+    /// Returns a printable name for an instruction set
+    const char*
+    InstructionSetName(InstructionSet isa);
+
+    /// Selects the instruction set used by the kernels, clamped to the
+    /// best one supported by the CPU (and compiled in). By default the
+    /// best one is used, this is mostly useful for testing
+    void
+    SelectInstructionSet(InstructionSet isa);
+
+    /// Jacobi update of the cells [begin, end) of a row, in is the
+    /// start of the row in the previous iterate and out the start of
+    /// the row in the new iterate. Cells with a zero in update (if
+    /// non-null) keep their value. Returns the max relative change over
+    /// the updated cells if computeErr is set, otherwise 0
+    f64
+    JacobiRow(const f64* in, f64* out, const u8* update, const uint lineLength,
+              const uint begin, const uint end, const bool computeErr);
+
+    /// In-place over-relaxed update of the cells [begin, end) of the
+    /// row starting at v that are non-zero in update. The updated
+    /// cells must not neighbour each other along the row (i.e. one
+    /// colour of a checkerboard). The cells that aren't updated are
+    /// never written. Returns the max relative change over the updated
+    /// cells if computeErr is set, otherwise 0
+    f64
+    SORRow(f64* v, const u8* update, const uint lineLength, const uint begin, const uint end,
+           const f64 w, const bool computeErr);
+
+    /// Over-relaxed update of the entries [begin, end) of row, from
+    /// neighbour rows held in separate arrays, i.e. entry i of row has
+    /// neighbours right[i], left[i], up[i] and down[i]. This is the
+    /// update of one colour of the split checkerboard layout. Entries
+    /// with a zero in update keep their value. Returns the max
+    /// relative change over the updated entries if computeErr is set,
+    /// otherwise 0
+    f64
+    SplitRow(f64* row, const f64* right, const f64* left, const f64* up, const f64* down,
+             const u8* update, const uint begin, const uint end, const f64 w,
+             const bool computeErr);
+
+    /// Single precision over-relaxed update of the entries [begin,
+    /// end) of row, laid out as for SplitRow, for the equation A e =
+    /// rhs, where A is the 5-point Laplacian scaled by -1/4. i.e. the
+    /// Gauss-Seidel value of an entry is 1/4 of the sum of its
+    /// neighbours plus rhs. Entries with a zero in update keep their
+    /// value. This is the inner sweep of the mixed precision solver,
+    /// which measures its error in double, so no error is returned
+    void
+    SplitRowF32(f32* row, const f32* right, const f32* left, const f32* up, const f32* down,
+                const f32* rhs, const u8* update, const uint begin, const uint end, const f32 w);
+}
+#endif
@@ -0,0 +1,142 @@
+/* ==========================================================================
+   $File: Superposition.cpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+#include "Superposition.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Superposition
+{
+    bool
+    BuildBases(const Cfg::GridConfigData& cfg, const SolveFn& solve,
+               BasisSet* bases)
+    {
+        TIME_FUNCTION();
+
+        const bool horizZip = cfg.horizZip.ValueOr(false);
+        const bool verticZip = cfg.verticZip.ValueOr(false);
+        const uint scaleFactor = cfg.scaleFactor.ValueOr(1);
+
+        // Every CONSTANT colour at 0 V, this is the starting point
+        // for each basis
+        std::unordered_map<u32, Constraint> zeroed(cfg.constraints);
+        for (auto& c : zeroed)
+        {
+            if (c.second.first == ConstraintType::CONSTANT)
+            {
+                c.second.second = 0.0;
+                bases->colors.push_back(c.first);
+            }
+        }
+        // NOTE(Chris): Sort so the order doesn't depend on the hash map
+        std::sort(bases->colors.begin(), bases->colors.end());
+
+        bases->cfg = cfg;
+        bases->geometry = Grid(horizZip, verticZip);
+        if (!bases->geometry.LoadFromImage(cfg.imagePath.c_str(), zeroed, scaleFactor))
+            return false;
+
+        bases->fields.clear();
+        for (const auto color : bases->colors)
+        {
+            auto constraints = zeroed;
+            constraints[color].second = 1.0;
+
+            Grid grid(horizZip, verticZip);
+            if (!grid.LoadFromImage(cfg.imagePath.c_str(), constraints, scaleFactor))
+                return false;
+
+            const bool present = std::any_of(grid.fixedPoints.begin(), grid.fixedPoints.end(),
+                                             [](const std::pair<const MemIndex, f64>& fp)
+                                             {
+                                                 return fp.second != 0.0;
+                                             });
+            if (!present)
+            {
+                LOG("Colour %u doesn't appear in the image, no basis needed", color);
+                bases->fields.emplace_back();
+                continue;
+            }
+
+            LOG("Solving basis for colour %u", color);
+            solve(cfg, &grid);
+            bases->fields.push_back(std::move(grid.voltages));
+        }
+
+        return true;
+    }
+
+    /// Checks that cfg maps every colour to the same constraint type
+    /// as base, on the same image, scale and zips
+    static
+    bool
+    SameGeometry(const Cfg::GridConfigData& base, const Cfg::GridConfigData& cfg)
+    {
+        if (base.imagePath != cfg.imagePath
+            || base.scaleFactor.ValueOr(1) != cfg.scaleFactor.ValueOr(1)
+            || base.horizZip.ValueOr(false) != cfg.horizZip.ValueOr(false)
+            || base.verticZip.ValueOr(false) != cfg.verticZip.ValueOr(false)
+            || base.constraints.size() != cfg.constraints.size())
+        {
+            return false;
+        }
+
+        for (const auto& c : base.constraints)
+        {
+            const auto found = cfg.constraints.find(c.first);
+            if (found == cfg.constraints.end()
+                || found->second.first != c.second.first)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Jasnah::Option<Grid>
+    Evaluate(const BasisSet& bases, const Cfg::GridConfigData& cfg)
+    {
+        TIME_FUNCTION();
+
+        if (!SameGeometry(bases.cfg, cfg))
+        {
+            LOG("Config %s doesn't match the geometry of the bases", cfg.imagePath.c_str());
+            return Jasnah::None;
+        }
+
+        Grid result(bases.geometry);
+        auto& voltages = result.voltages;
+        std::fill(voltages.begin(), voltages.end(), 0.0);
+        const uint numCells = voltages.size();
+
+        for (uint b = 0; b < bases.colors.size(); ++b)
+        {
+            const auto& field = bases.fields[b];
+            const f64 weight = cfg.constraints.find(bases.colors[b])->second.second;
+            if (field.empty() || weight == 0.0)
+                continue;
+
+            // NOTE(Chris): Simple enough for the compiler to vectorise
+            f64* __restrict__ out = voltages.data();
+            const f64* __restrict__ in = field.data();
+#pragma omp parallel for default(none) shared(out, in, weight, numCells)
+            for (uint i = 0; i < numCells; ++i)
+            {
+                out[i] += weight * in[i];
+            }
+        }
+
+        // The fixed cells of the sum hold the new boundary values
+        for (auto& fp : result.fixedPoints)
+        {
+            fp.second = voltages[fp.first];
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,57 @@
+// -*- c++ -*-
+#if !defined(SUPERPOSITION_H)
+/* ==========================================================================
+   $File: Superposition.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define SUPERPOSITION_H
+// Laplace's equation is linear, so the solution for any set of
+// electrode voltages is a weighted sum of the solutions with each
+// electrode at 1 V and the others at 0 V
+
+#include "GlobalDefines.hpp"
+#include "JSON.hpp"
+#include "Grid.hpp"
+#include <functional>
+#include <vector>
+
+namespace Superposition
+{
+    /// The basis fields for one geometry
+    struct BasisSet
+    {
+        /// Config the bases were built from, used to check that
+        /// evaluated configs describe the same geometry
+        Cfg::GridConfigData cfg;
+        /// Grid of the geometry with all electrodes at 0 V
+        Grid geometry;
+        /// Colour of the CONSTANT constraint each field belongs to
+        std::vector<u32> colors;
+        /// Solution with only that colour at 1 V, empty if the colour
+        /// doesn't appear in the image
+        std::vector<std::vector<f64> > fields;
+
+        BasisSet() : geometry(false, false) {}
+    };
+
+    /// Function used to solve each basis problem
+    typedef std::function<void(const Cfg::GridConfigData&, Grid*)> SolveFn;
+
+    /// Solves one basis field for each CONSTANT constraint of cfg.
+    /// LERP constraints interpolate between their neighbours, so they
+    /// follow the electrodes they join and need no basis of their
+    /// own. Returns false if the image can't be loaded
+    bool
+    BuildBases(const Cfg::GridConfigData& cfg, const SolveFn& solve,
+               BasisSet* bases);
+
+    /// Evaluates the solution for the constraint values of cfg as a
+    /// weighted sum of the bases. Returns None (after logging why) if
+    /// cfg doesn't describe the same geometry as the bases
+    Jasnah::Option<Grid>
+    Evaluate(const BasisSet& bases, const Cfg::GridConfigData& cfg);
+}
+#endif
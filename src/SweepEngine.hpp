@@ -0,0 +1,554 @@
+// -*- c++ -*-
+#if !defined(SWEEPENGINE_H)
+/* ==========================================================================
+   $File: SweepEngine.hpp $
+   $Version: 1.0 $
+   $Notice: (C) Copyright 2016 Chris Osborne. All Rights Reserved. $
+   $License: MIT: http://opensource.org/licenses/MIT $
+   ========================================================================== */
+
+#define SWEEPENGINE_H
+// The relaxation sweeps over lists of cells shared by the FDM,
+// Gauss-Seidel, red-black and SOR solvers. The update rule, stencil,
+// zip handling, error tracking, threading and precision are all
+// template policies, so every combination is its own branch-free
+// instantiation of the same loop, and the solvers choose between them
+// once per solve from a dispatch table rather than each carrying its
+// own copies
+
+#include "GlobalDefines.hpp"
+#include "Anderson.hpp"
+#include "Convergence.hpp"
+#include "Laplacian.hpp"
+#include "Utility.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Grid;
+
+namespace Sweep
+{
+    /// Data type to hold the two stop conditions (we stop on
+    /// whichever comes first)
+    struct StopParams
+    {
+        const f64 zeroTol;
+        const u64 maxIter;
+        /// Applies the selected convergence criterion to the error
+        const Convergence::Monitor monitor;
+        StopParams(const Grid& grid, f64 _zeroTol, u64 _maxIter)
+            : zeroTol(_zeroTol), maxIter(_maxIter), monitor(grid) {}
+    };
+
+    // NOTE(Chris): We need d2phi/dx^2 + d2phi/dy^2 = 0
+    // => 1/h^2 * ((phi(x+1,y) - 2phi(x,y) + phi(x-1,y))
+    //           + (phi(x,y+1) - 2phi(x,y) + phi(x,y-1))
+    // => phi(x,y) = 1/4 * (phi(x+1,y) + phi(x-1,y) + phi(x,y+1) + phi(x,y-1))
+    // The update rules below take this phi (from one of the stencils
+    // further down) and the previous value of the cell
+
+    /// Jacobi update, the new value is phi of the previous iterate, so
+    /// the sweep must read and write different arrays
+    struct Jacobi
+    {
+        template <typename Real>
+        static inline Real
+        Apply(const Real prev, const Real phi, const Real w)
+        {
+            (void)prev; (void)w;
+            return phi;
+        }
+    };
+
+    /// Gauss-Seidel update, in place so each cell sees the new values
+    /// of the cells updated before it
+    struct GaussSeidel
+    {
+        template <typename Real>
+        static inline Real
+        Apply(const Real prev, const Real phi, const Real w)
+        {
+            (void)prev; (void)w;
+            return phi;
+        }
+    };
+
+    /// Successive over-relaxation of the Gauss-Seidel update,
+    /// newVal = (1-w) * prev + w * phi
+    struct SOR
+    {
+        template <typename Real>
+        static inline Real
+        Apply(const Real prev, const Real phi, const Real w)
+        {
+            return (Real(1) - w) * prev + w * phi;
+        }
+    };
+
+    /// The cells visited by a sweep. As in the CellGraph the interior
+    /// cells have their neighbours at the usual +-1, +-lineLength
+    /// offsets, and the zipped edge cells carry their own
+    struct Cells
+    {
+        Cells(const std::vector<uint>& _interior, const std::vector<uint>& _edge,
+              const std::vector<Laplacian::Neighbours>& _edgeNeighbours,
+              const std::vector<Laplacian::Neighbours>& _edgeDiagonals, const uint _lineLength)
+            : interior(_interior),
+              edge(_edge),
+              edgeNeighbours(_edgeNeighbours),
+              edgeDiagonals(_edgeDiagonals),
+              lineLength(_lineLength)
+        {}
+
+        explicit Cells(const Laplacian::CellGraph& graph)
+            : Cells(graph.interior, graph.edge, graph.edgeNeighbours, graph.edgeDiagonals,
+                    graph.lineLength)
+        {}
+
+        /// Splits the interior rows (the interior must be sorted) into
+        /// numBands bands of whole rows for the Ordered sweep in
+        /// parallel. Without bands the interior is swept as one
+        inline void
+        SplitBands(const uint numLines, uint numBands)
+        {
+            const uint numRows = numLines - 2;
+            numBands = std::max(1u, std::min(numBands, numRows));
+            bands.resize(numBands + 1);
+            for (uint b = 0; b <= numBands; ++b)
+            {
+                const uint rowStart = (1 + (u64)b * numRows / numBands) * lineLength;
+                bands[b] = std::lower_bound(interior.begin(), interior.end(), rowStart) - interior.begin();
+            }
+        }
+
+        const std::vector<uint>& interior;
+        const std::vector<uint>& edge;
+        const std::vector<Laplacian::Neighbours>& edgeNeighbours;
+        /// Only read by the 9-point stencil, so may be empty otherwise
+        const std::vector<Laplacian::Neighbours>& edgeDiagonals;
+        const uint lineLength;
+        /// Offsets into interior of the bands, numBands + 1 entries
+        /// (empty if not split)
+        std::vector<uint> bands;
+        /// If set, the right hand side (scaled by h^2, one entry per
+        /// cell of the grid) of the Poisson equation to relax instead of
+        /// Laplace's
+        const f64* source = nullptr;
+    };
+
+    /// The 5-point stencil,
+    /// phi = 1/4 (left + right + up + down)
+    struct FivePoint
+    {
+        template <typename Real>
+        static inline Real
+        Interior(const Real* v, const uint c, const uint lineLength)
+        {
+            return Real(0.25) * (v[c + 1] + v[c - 1] + v[c - lineLength] + v[c + lineLength]);
+        }
+
+        template <typename Real>
+        static inline Real
+        Edge(const Real* v, const Cells& cells, const uint e)
+        {
+            const auto& n = cells.edgeNeighbours[e];
+            return Real(0.25) * (v[n[0]] + v[n[1]] + v[n[2]] + v[n[3]]);
+        }
+
+        /// The contribution of the (h^2 scaled) source term to phi
+        template <typename Real>
+        static inline Real
+        Source(const Real s)
+        {
+            return Real(0.25) * s;
+        }
+    };
+
+    /// The compact 9-point (Mehrstellen) stencil,
+    /// phi = 1/20 (4 (left + right + up + down) + the 4 diagonals)
+    /// For Laplace's equation its truncation error is fourth order in
+    /// h, rather than second, for the same one cell halo
+    struct NinePoint
+    {
+        template <typename Real>
+        static inline Real
+        Interior(const Real* v, const uint c, const uint lineLength)
+        {
+            return Real(0.05) * (Real(4) * (v[c + 1] + v[c - 1] + v[c - lineLength] + v[c + lineLength])
+                                 + v[c - lineLength - 1] + v[c - lineLength + 1]
+                                 + v[c + lineLength - 1] + v[c + lineLength + 1]);
+        }
+
+        template <typename Real>
+        static inline Real
+        Edge(const Real* v, const Cells& cells, const uint e)
+        {
+            const auto& n = cells.edgeNeighbours[e];
+            const auto& d = cells.edgeDiagonals[e];
+            return Real(0.05) * (Real(4) * (v[n[0]] + v[n[1]] + v[n[2]] + v[n[3]])
+                                 + v[d[0]] + v[d[1]] + v[d[2]] + v[d[3]]);
+        }
+
+        /// The contribution of the (h^2 scaled) source term to phi,
+        /// taking the source as constant over the stencil
+        template <typename Real>
+        static inline Real
+        Source(const Real s)
+        {
+            return Real(0.3) * s;
+        }
+    };
+
+    /// The zipped edge cells are skipped entirely
+    struct NoZip { static const bool Edges = false; };
+    /// The zipped edge cells are updated after the interior
+    struct Zip { static const bool Edges = true; };
+
+    /// The max relative change isn't computed
+    struct NoError { static const bool Track = false; };
+    /// The max relative change of the sweep is returned
+    struct TrackError { static const bool Track = true; };
+
+    /// Single threaded
+    struct Serial { static const bool Threaded = false; };
+    /// The interior is split between the OpenMP threads
+    struct Parallel { static const bool Threaded = true; };
+
+    /// Keeps track of the max relative change, ignoring the NaNs from
+    /// cells that are still 0
+    template <typename Real>
+    inline void
+    TrackMax(const Real prev, const Real newVal, Real* maxErr)
+    {
+        const Real absErr = std::abs((prev - newVal) / newVal);
+        if (absErr > *maxErr && absErr == absErr)
+            *maxErr = absErr;
+    }
+
+    /// Updates the interior cells [begin, end) in order, reading src
+    /// and writing dst (the same array for the in place rules), adding
+    /// the source term if HasSource
+    template <typename Rule, typename Points, typename Err, bool HasSource, typename Real>
+    inline Real
+    RelaxCells(const Real* src, Real* dst, const uint* begin, const uint* end,
+               const uint lineLength, const Real w, const f64* source)
+    {
+        Real maxErr = 0;
+        for (const uint* c = begin; c < end; ++c)
+        {
+            const Real prev = src[*c];
+            Real phi = Points::Interior(src, *c, lineLength);
+            if (HasSource)
+                phi += Points::Source((Real)source[*c]);
+            const Real newVal = Rule::Apply(prev, phi, w);
+            dst[*c] = newVal;
+
+            if (Err::Track)
+                TrackMax(prev, newVal, &maxErr);
+        }
+        return maxErr;
+    }
+
+    /// RelaxCells, with the source term if one is given
+    template <typename Rule, typename Points, typename Err, typename Real>
+    inline Real
+    RelaxRange(const Real* src, Real* dst, const uint* begin, const uint* end,
+               const uint lineLength, const Real w, const f64* source = nullptr)
+    {
+        return source
+            ? RelaxCells<Rule, Points, Err, true>(src, dst, begin, end, lineLength, w, source)
+            : RelaxCells<Rule, Points, Err, false>(src, dst, begin, end, lineLength, w, source);
+    }
+
+    /// Updates the zipped edge cells serially, as with an odd period
+    /// two edge cells of the same colour can be neighbours across the
+    /// zip
+    template <typename Rule, typename Points, typename Zip, typename Err, typename Real>
+    inline Real
+    RelaxEdges(const Real* src, Real* dst, const Cells& cells, const Real w)
+    {
+        Real maxErr = 0;
+        if (!Zip::Edges)
+            return maxErr;
+
+        const auto& edge = cells.edge;
+        for (uint e = 0; e < edge.size(); ++e)
+        {
+            const Real prev = src[edge[e]];
+            Real phi = Points::Edge(src, cells, e);
+            if (cells.source)
+                phi += Points::Source((Real)cells.source[edge[e]]);
+            const Real newVal = Rule::Apply(prev, phi, w);
+            dst[edge[e]] = newVal;
+
+            if (Err::Track)
+                TrackMax(prev, newVal, &maxErr);
+        }
+        return maxErr;
+    }
+
+    /// One sweep over cells whose updates don't depend on each other:
+    /// the Jacobi update from src into dst, or one colour of the
+    /// checkerboard in place (src == dst). The interior is split
+    /// evenly between the threads, then the edges are updated.
+    /// Returns the max relative change if tracking the error,
+    /// otherwise 0. For the 9-point stencil a colour must be one of the
+    /// four of RedBlack::FourColourCells, as the diagonal neighbours
+    /// of a checkerboard cell share its colour
+    template <typename Threads, typename Rule, typename Points, typename Zip, typename Err,
+              typename Real = f64>
+    struct Simultaneous
+    {
+        static Real
+        Run(const Real* src, Real* dst, const Cells& cells, const Real w)
+        {
+            const uint* interior = cells.interior.data();
+            const uint numInterior = cells.interior.size();
+            const uint lineLength = cells.lineLength;
+            const f64* source = cells.source;
+
+            Real maxErr = 0;
+            if (Threads::Threaded)
+            {
+                const uint numChunks = omp_get_max_threads();
+#pragma omp parallel for default(none) shared(src, dst, interior, numInterior, numChunks, lineLength, w, source) reduction(max:maxErr)
+                for (uint chunk = 0; chunk < numChunks; ++chunk)
+                {
+                    const uint* begin = interior + (u64)chunk * numInterior / numChunks;
+                    const uint* end = interior + (u64)(chunk + 1) * numInterior / numChunks;
+                    const Real err = RelaxRange<Rule, Points, Err>(src, dst, begin, end, lineLength, w, source);
+                    if (err > maxErr)
+                        maxErr = err;
+                }
+            }
+            else
+            {
+                maxErr = RelaxRange<Rule, Points, Err>(src, dst, interior, interior + numInterior, lineLength, w,
+                                                       source);
+            }
+
+            return std::max(maxErr, RelaxEdges<Rule, Points, Zip, Err>(src, dst, cells, w));
+        }
+    };
+
+    /// One in place sweep over the cells in the order they are listed,
+    /// i.e. lexicographic Gauss-Seidel for a sorted interior. In
+    /// parallel the bands of rows set by Cells::SplitBands are swept in
+    /// two phases, the even bands and then the odd ones, so no band is
+    /// written while a neighbouring band reads it. Within a band the
+    /// order is kept, so with one band this is exactly the serial
+    /// sweep. Both stencils only reach one row up or down, so a band
+    /// of at least one row keeps the bands of each phase apart. src
+    /// must equal dst
+    template <typename Threads, typename Rule, typename Points, typename Zip, typename Err,
+              typename Real = f64>
+    struct Ordered
+    {
+        static Real
+        Run(const Real* src, Real* dst, const Cells& cells, const Real w)
+        {
+            const uint* interior = cells.interior.data();
+            const uint* bands = cells.bands.data();
+            const uint numBands = cells.bands.empty() ? 1 : cells.bands.size() - 1;
+            const uint lineLength = cells.lineLength;
+            const f64* source = cells.source;
+
+            Real maxErr = 0;
+            if (Threads::Threaded && numBands > 1)
+            {
+                for (uint parity = 0; parity < 2; ++parity)
+                {
+#pragma omp parallel for default(none) shared(src, dst, interior, bands, numBands, lineLength, w, parity, source) reduction(max:maxErr)
+                    for (uint b = parity; b < numBands; b += 2)
+                    {
+                        const Real err = RelaxRange<Rule, Points, Err>(src, dst, interior + bands[b],
+                                                                       interior + bands[b + 1], lineLength, w,
+                                                                       source);
+                        if (err > maxErr)
+                            maxErr = err;
+                    }
+                }
+            }
+            else
+            {
+                maxErr = RelaxRange<Rule, Points, Err>(src, dst, interior, interior + cells.interior.size(),
+                                                       lineLength, w, source);
+            }
+
+            return std::max(maxErr, RelaxEdges<Rule, Points, Zip, Err>(src, dst, cells, w));
+        }
+    };
+
+    /// Table of the instantiations of a sweep for every threading,
+    /// stencil, zip and error tracking policy. Sweep is a template
+    /// over these four (e.g. an alias of Simultaneous with the rule and
+    /// precision bound) with a static Run
+    template <template <typename, typename, typename, typename> class Sweep>
+    struct Dispatch
+    {
+        typedef decltype(&Sweep<Serial, FivePoint, NoZip, NoError>::Run) Fn;
+
+        static Fn
+        Select(const bool parallel, const bool zip, const bool trackErr,
+               const Cfg::StencilType stencil)
+        {
+            return (stencil == Cfg::StencilType::NinePoint)
+                ? SelectFor<NinePoint>(parallel, zip, trackErr)
+                : SelectFor<FivePoint>(parallel, zip, trackErr);
+        }
+
+    private:
+        template <typename Points>
+        static Fn
+        SelectFor(const bool parallel, const bool zip, const bool trackErr)
+        {
+            static const Fn table[2][2][2] =
+            {
+                {
+                    { &Sweep<Serial, Points, NoZip, NoError>::Run, &Sweep<Serial, Points, NoZip, TrackError>::Run },
+                    { &Sweep<Serial, Points, Zip, NoError>::Run, &Sweep<Serial, Points, Zip, TrackError>::Run }
+                },
+                {
+                    { &Sweep<Parallel, Points, NoZip, NoError>::Run, &Sweep<Parallel, Points, NoZip, TrackError>::Run },
+                    { &Sweep<Parallel, Points, Zip, NoError>::Run, &Sweep<Parallel, Points, Zip, TrackError>::Run }
+                }
+            };
+            return table[parallel][zip][trackErr];
+        }
+    };
+
+    /// The non-fixed cells of the graph, i.e. the unknowns of the
+    /// solvers that relax the grid's voltages in place
+    inline std::vector<uint>
+    Unknowns(const Laplacian::CellGraph& graph)
+    {
+        std::vector<uint> unknowns(graph.interior);
+        unknowns.insert(unknowns.end(), graph.edge.begin(), graph.edge.end());
+        return unknowns;
+    }
+
+    /// Anderson accelerator (see Anderson.hpp) over the given unknowns
+    /// of values, started from their current contents. Null unless
+    /// enabled
+    inline std::unique_ptr<Anderson::Accelerator>
+    MakeAccelerator(const bool enabled, const std::vector<uint>& unknowns, std::vector<f64>* values)
+    {
+        if (!enabled)
+            return nullptr;
+
+        LOG("Anderson acceleration, depth %u", Anderson::DefaultDepth);
+        auto accel = make_unique<Anderson::Accelerator>(unknowns);
+        accel->Extrapolate(values);
+        return accel;
+    }
+
+    /// The afterCheck hook for Run that extrapolates values with
+    /// accel, so any solver with a one-sweep kernel can be accelerated
+    /// (as long as it checks the error at a fixed interval). Empty if
+    /// accel is null
+    inline std::function<void()>
+    Accelerate(Anderson::Accelerator* accel, std::vector<f64>* values)
+    {
+        if (!accel)
+            return nullptr;
+
+        return [accel, values] ()
+        {
+            accel->Extrapolate(values);
+        };
+    }
+
+    /// When Run checks the error
+    enum class Checks
+    {
+        /// Every 500 iterations
+        Fixed,
+        /// Every 500 iterations at first, then at the iteration the
+        /// error is predicted to reach zeroTol. This suits Jacobi, whose
+        /// relative change drops roughly as k*i^{-2}
+        Predicted
+    };
+
+    /// Iterates until the stop condition is met. iterate(computeErr)
+    /// performs stride iterations (maxIter is rounded down to a
+    /// multiple of this) and returns the max relative change of the
+    /// last if computeErr is set. voltages() returns the grid's
+    /// voltages up to date with the solution, and is only called for
+    /// the residual convergence criteria. If given, afterCheck is called
+    /// after every error check that doesn't stop the iteration (e.g. to
+    /// extrapolate the iterate). Returns true if the stop condition was
+    /// met within the iteration limit
+    template <typename IterateFn, typename VoltagesFn>
+    bool
+    Run(IterateFn iterate, VoltagesFn voltages, const StopParams& stop,
+        const Checks checks = Checks::Fixed,
+        const std::function<void()>& afterCheck = nullptr, const uint stride = 1)
+    {
+        // NOTE(Chris): We never write to the fixed points, so we don't
+        // need to re-set them (as long as they were set properly in the
+        // incoming grid using AddFixedPoint)
+
+        // Check error every 500 iterations at first
+        uint errorChunk = 500;
+
+        f64 maxErr = 0.0;
+
+        // Main loop - start with 1 so as not to take slow path on first
+        // iter. The error is checked on the call that reaches a
+        // multiple of errorChunk
+        for (u64 i = stride; i <= stop.maxIter; i += stride)
+        {
+            const bool computeErr = (i % errorChunk < stride);
+            const f64 err = iterate(computeErr);
+
+            if (unlikely(computeErr))
+            {
+                maxErr = err;
+                if (stop.monitor.UsesResidual())
+                    maxErr = stop.monitor.Measure(voltages(), maxErr);
+
+                if (maxErr < stop.zeroTol)
+                {
+                    LOG("Performed %u iterations, max error: %e", (unsigned)i, maxErr);
+                    return true;
+                }
+
+                // NOTE(Chris): Report error every 5000 iterations
+                if (i % 5000 < stride)
+                {
+                    LOG("After %u iterations, %s %e", (unsigned)i,
+                        Convergence::CriterionName(Convergence::ActiveCriterion()), maxErr);
+                }
+
+                // If we plot the error per iteration we note that it
+                // remains fixed at 1.0 until all cells have been filled,
+                // after this point it drops roughly as k*i^{-2} =>
+                // err_i * i^2 = err_j * j^2. So when err_j is zeroTol,
+                // and err_i has been calculated we can find an
+                // approximate value for j. This tends to overshoot, so
+                // only go 5% of the way there (we use a modulo anyway
+                // so it will still stop at the prediction)
+                if (checks == Checks::Predicted && maxErr < 1.0)
+                {
+                    // NOTE(Chris): Long double should be at least
+                    // 80-bits and should help avoid underflow in
+                    // these calculations
+                    const long double sqI = (long double)i * i;
+                    const long double tol = stop.zeroTol;
+                    errorChunk = std::max(1u, (uint)(0.05 * std::sqrt(maxErr * sqI / tol)));
+                    LOG("New target index divisor %u", errorChunk);
+                }
+
+                if (afterCheck)
+                    afterCheck();
+            }
+        }
+        LOG("Overran max iteration counter (%u), max error: %e", (unsigned)stop.maxIter, maxErr);
+        return false;
+    }
+}
+#endif
@@ -11,6 +11,7 @@
 #include "GlobalDefines.hpp"
 #include <vector>
 #include <memory>
+#include <unistd.h>
 
 #ifdef GOMP
 #include <omp.h>
@@ -104,6 +105,21 @@ LerpNPointsBetweenVoltages(const f64 v1, const f64 v2, const uint numPoints)
     return result;
 }
 
+/// Returns the size in bytes of the level 1 or 2 data cache, or
+/// fallback if this can't be determined on this platform
+inline
+uint
+DataCacheSize(const uint level, const uint fallback)
+{
+    long size = -1;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    size = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+#else
+    (void)level;
+#endif
+    return (size > 0) ? (uint)size : fallback;
+}
+
 typedef u32 HashedName;
 
 namespace Impl
@@ -125,4 +141,19 @@ constexpr HashedName StringHash(const char* str)
     return Impl::CreateHash(0, str);
 }
 
+/// 64-bit FNV-1a hash of a block of memory. Pass the result of a
+/// previous call as the seed to hash several blocks together
+inline
+u64
+Hash64(const void* data, const size_t len, u64 seed = 14695981039346656037ULL)
+{
+    const u8* bytes = (const u8*)data;
+    for (size_t i = 0; i < len; ++i)
+    {
+        seed ^= bytes[i];
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+
 #endif
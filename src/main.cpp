@@ -10,8 +10,20 @@
 #include "RedBlack.hpp"
 #include "GaussSeidel.hpp"
 #include "MatrixInversion.hpp"
+#include "Multigrid.hpp"
+#include "ConjugateGradient.hpp"
+#include "FastPoisson.hpp"
+#include "AMG.hpp"
+#include "Schwarz.hpp"
+#include "MultiProcess.hpp"
+#include "MixedPrecision.hpp"
+#include "Superposition.hpp"
 #include "AnalyticalGridFunctions.hpp"
 #include "Compare.hpp"
+#include "Convergence.hpp"
+#include "Laplacian.hpp"
+#include "FieldFile.hpp"
+#include "SolutionCache.hpp"
 #include "Grid.hpp"
 #include "GradientGrid.hpp"
 #include "Plot.hpp"
@@ -19,6 +31,7 @@
 #include "OutputStream.hpp"
 #include "Utility.hpp"
 #include <tclap/CmdLine.h>
+#include <cstring>
 #include <iostream>
 
 // NOTE(Chris): It's going to be a bit of work to get tests running
@@ -56,6 +69,10 @@ struct CommandLineFlags
     bool guiMode;
     Cfg::OperationMode mode;
     std::vector<std::string> inputPaths;
+    /// Paths of the fields to start from and save to in single
+    /// simulation mode, empty if not given (these override the config)
+    std::string warmStart;
+    std::string saveField;
 };
 
 static
@@ -78,6 +95,13 @@ ParseArguments(const int argc, const char* argv[])
                             "Read json from stdin, complete objects separated by \"EOF\\n\"",
                             cmd, false);
         SwitchArg gui("g", "gui", "Run in gui mode (output json on stdout)", cmd, false);
+        ValueArg<std::string> warmStart("w", "warmstart",
+                                        "Field file to use as the initial guess (resampled if the resolution differs)",
+                                        false, "", "path", cmd);
+        ValueArg<std::string> saveField("f", "savefield",
+                                        "Field file to save the solution to, for later warm starts "
+                                        "(prefixed with each config's position if several are given)",
+                                        false, "", "path", cmd);
 
 
         // Aguments are in order: '-' flag, "--" flag,
@@ -90,7 +114,11 @@ ParseArguments(const int argc, const char* argv[])
         SwitchArg preprocess1("E", "preprocess",
                               "Preprocesses the image outputting the json to be filled in with required info",
                               false);
-        std::vector<Arg*> cmpArgs({&cmp0, &cmp1, &cmp2, &infoFile, &preprocess1});
+        SwitchArg superposition("s", "superposition",
+                                "Solves one field per electrode of the first input file, then evaluates "
+                                "every input file (same image, different voltages) as their superposition",
+                                false);
+        std::vector<Arg*> cmpArgs({&cmp0, &cmp1, &cmp2, &infoFile, &preprocess1, &superposition});
         cmd.xorAdd(cmpArgs);
 
         // TODO(Chris): Need params for analytical solutions - json?
@@ -119,6 +147,10 @@ ParseArguments(const int argc, const char* argv[])
         {
             ret.mode = Cfg::OperationMode::Preprocess;
         }
+        else if (superposition.getValue())
+        {
+            ret.mode = Cfg::OperationMode::Superposition;
+        }
         else
         {
             ret.mode = Cfg::OperationMode::SingleSimulation;
@@ -147,6 +179,8 @@ ParseArguments(const int argc, const char* argv[])
         }
 
         ret.guiMode = gui.getValue();
+        ret.warmStart = warmStart.getValue();
+        ret.saveField = saveField.getValue();
 
         return ret;
     }
@@ -156,40 +190,258 @@ ParseArguments(const int argc, const char* argv[])
     }
 }
 
+/// The stencil a solve with cfg uses. Only the relaxation solvers and
+/// conjugate gradient support the 9-point stencil, the others fall
+/// back to the 5-point one
 static
-void
-DispatchSolver(Jasnah::Option<Cfg::CalculationMode> mode, Grid* grid, f64 zeroTol, f64 maxIter)
+Cfg::StencilType
+SolveStencil(const Cfg::GridConfigData& cfg)
 {
+    const Cfg::StencilType stencil = cfg.stencil.ValueOr(Cfg::StencilType::FivePoint);
+    if (stencil == Cfg::StencilType::FivePoint || !cfg.mode)
+        return stencil;
 
-    if (!mode)
+    switch (*cfg.mode)
+    {
+    case Cfg::CalculationMode::FiniteDiff:
+    case Cfg::CalculationMode::GaussSeidel:
+    case Cfg::CalculationMode::RedBlack:
+    case Cfg::CalculationMode::SOR:
+    case Cfg::CalculationMode::ConjugateGradient:
+        return stencil;
+
+    default:
+        return Cfg::StencilType::FivePoint;
+    }
+}
+
+/// Solves the grid with the config's calculation mode, returns true
+/// if the solver converged
+static
+bool
+SolveWithMode(const Cfg::GridConfigData& cfg, Grid* grid)
+{
+    const f64 zeroTol = cfg.zeroTol.ValueOr(0.001);
+    const u64 maxIter = cfg.maxIter.ValueOr(20000);
+    Convergence::SelectCriterion(cfg.convergence.ValueOr(Cfg::ConvergenceCriterion::RelativeChange),
+                                 cfg.scaleResidual.ValueOr(false));
+
+    const Cfg::StencilType stencil = SolveStencil(cfg);
+    if (stencil != cfg.stencil.ValueOr(Cfg::StencilType::FivePoint))
+    {
+        LOG("The 9-point stencil isn't supported by this method, using the 5-point stencil");
+    }
+    Laplacian::SelectStencil(stencil);
+
+    if (!cfg.mode)
     {
         LOG("Using FDM");
-        FDM::FDMSolver(grid, zeroTol, maxIter);
-        return;
+        return FDM::FDMSolver(grid, zeroTol, maxIter);
     }
 
-    switch (*mode)
+    bool converged = false;
+    switch (*cfg.mode)
     {
     case Cfg::CalculationMode::FiniteDiff:
     {
-        FDM::FDMSolver(grid, zeroTol, maxIter);
+        converged = FDM::FDMSolver(grid, zeroTol, maxIter, true,
+                                   cfg.temporalBlocking.ValueOr(false),
+                                   cfg.anderson.ValueOr(false));
     } break;
 
     case Cfg::CalculationMode::MatrixInversion:
     {
-        MatrixInversion::MatrixInversionMethod(grid, zeroTol, maxIter);
+        // NOTE(Chris): The factorisation is stored next to the image
+        const std::string cachePath = cfg.imagePath + ".factor";
+        converged = MatrixInversion::MatrixInversionMethod(grid, zeroTol, maxIter,
+                                                           cfg.cacheFactorisation.ValueOr(false)
+                                                           ? cachePath.c_str() : nullptr);
     } break;
 
     case Cfg::CalculationMode::GaussSeidel:
     {
-        GaussSeidel::GaussSeidelSolver(grid, zeroTol, maxIter);
+        converged = GaussSeidel::GaussSeidelSolver(grid, zeroTol, maxIter, true,
+                                                   cfg.anderson.ValueOr(false));
     } break;
 
     case Cfg::CalculationMode::RedBlack:
     {
-        RedBlack::RedBlackSolver(grid, zeroTol, maxIter);
+        // NOTE(Chris): A tile width of 0 is sized from the cache
+        converged = RedBlack::RedBlackSolver(grid, zeroTol, maxIter, true,
+                                             cfg.chebyshev.ValueOr(false),
+                                             cfg.tiledSweep.ValueOr(false),
+                                             cfg.tileWidth.ValueOr(0),
+                                             cfg.anderson.ValueOr(false));
+    } break;
+
+    case Cfg::CalculationMode::Multigrid:
+    {
+        const uint cycleIndex = (cfg.mgCycle.ValueOr(Cfg::MultigridCycle::V) == Cfg::MultigridCycle::W) ? 2 : 1;
+        converged = Multigrid::MultigridSolver(grid, zeroTol, maxIter, true, cycleIndex);
+    } break;
+
+    case Cfg::CalculationMode::ConjugateGradient:
+    {
+        converged = ConjugateGradient::ConjugateGradientSolver(grid, zeroTol, maxIter,
+                                                               cfg.preconditioner.ValueOr(Cfg::Preconditioner::None));
+    } break;
+
+    case Cfg::CalculationMode::SOR:
+    {
+        converged = SOR::SORSolver(grid, zeroTol, maxIter, true, cfg.anderson.ValueOr(false));
+    } break;
+
+    case Cfg::CalculationMode::FastPoisson:
+    {
+        converged = FastPoisson::FastPoissonSolver(grid, zeroTol, maxIter);
+    } break;
+
+    case Cfg::CalculationMode::AlgebraicMultigrid:
+    {
+        converged = AMG::AMGSolver(grid, zeroTol, maxIter);
+    } break;
+
+    case Cfg::CalculationMode::Schwarz:
+    {
+        converged = Schwarz::SchwarzSolver(grid, zeroTol, maxIter);
+    } break;
+
+    case Cfg::CalculationMode::MultiProcess:
+    {
+        // NOTE(Chris): Default to one worker per NUMA node
+        converged = MultiProcess::MultiProcessSolver(grid, zeroTol, maxIter,
+                                                     cfg.numProcesses.ValueOr(MultiProcess::NumNumaNodes()));
+    } break;
+
+    case Cfg::CalculationMode::MixedPrecision:
+    {
+        converged = MixedPrecision::MixedPrecisionSolver(grid, zeroTol, maxIter);
     } break;
     }
+
+    return converged;
+}
+
+/// Solves the problem at ScaleFactor 1, 2, 4, ... below the
+/// requested scale, starting each from the interpolated solution of
+/// the previous one, and leaves the final interpolated solution in
+/// grid as a starting point
+static
+void
+NestedIteration(const Cfg::GridConfigData& cfg, Grid* grid)
+{
+    const uint scaleFactor = cfg.scaleFactor.ValueOr(1);
+    if (scaleFactor <= 1 || !IsPow2(scaleFactor))
+        return;
+
+    Grid coarse(grid->horizZip, grid->verticZip);
+    for (uint scale = 1; scale < scaleFactor; scale *= 2)
+    {
+        Grid level(grid->horizZip, grid->verticZip);
+        if (!level.LoadFromImage(cfg.imagePath.c_str(), cfg.constraints, scale))
+        {
+            LOG("Unable to load image for nested iteration, starting from 0");
+            return;
+        }
+
+        if (scale > 1)
+        {
+            level.ResampleVoltages(coarse.voltages, coarse.lineLength, coarse.numLines);
+        }
+
+        LOG("Nested iteration: solving at scale %u (%u x %u)", scale, level.lineLength, level.numLines);
+        SolveWithMode(cfg, &level);
+        coarse = std::move(level);
+    }
+
+    grid->ResampleVoltages(coarse.voltages, coarse.lineLength, coarse.numLines);
+}
+
+static
+bool
+DispatchSolver(const Cfg::GridConfigData& cfg, Grid* grid)
+{
+    if (cfg.nestedIteration.ValueOr(false))
+    {
+        // NOTE(Chris): The direct solvers don't use a starting point,
+        // and every level would replace the cached factorisation of
+        // the last (it is keyed on the image, not the scale)
+        const Cfg::CalculationMode mode = *cfg.mode;
+        if (mode == Cfg::CalculationMode::MatrixInversion
+            || mode == Cfg::CalculationMode::FastPoisson)
+        {
+            LOG("Nested iteration has no effect on a direct solver, ignoring it");
+        }
+        else
+        {
+            NestedIteration(cfg, grid);
+        }
+    }
+
+    return SolveWithMode(cfg, grid);
+}
+
+/// Runs DispatchSolver, unless the config's CacheDirectory already
+/// holds the solution to an identical input, in which case that is
+/// loaded instead. New solutions are added to the cache, as long as
+/// the solver converged
+static
+void
+CachedDispatchSolver(const Cfg::GridConfigData& cfg, Grid* grid)
+{
+    if (!cfg.cacheDirectory)
+    {
+        DispatchSolver(cfg, grid);
+        return;
+    }
+
+    const auto key = SolutionCache::InputKey(cfg);
+    if (key && SolutionCache::Load(*cfg.cacheDirectory, *key, grid))
+        return;
+
+    const bool converged = DispatchSolver(cfg, grid);
+    if (!key)
+        return;
+
+    if (converged)
+    {
+        SolutionCache::Store(*cfg.cacheDirectory, *key, *grid);
+    }
+    else
+    {
+        LOG("Solution didn't converge, not adding it to the cache");
+    }
+}
+
+/// If CompareStencils is set with the 9-point stencil, solves the
+/// problem again with the 5-point stencil at the same resolution, and
+/// reports how much closer to the analytical solution the 9-point one
+/// is. The 5-point solution goes through the solution cache, so a
+/// CacheDirectory saves repeating it
+static
+void
+ReportStencilGain(const Cfg::GridConfigData& cfg, const Grid& analytic,
+                  const Cmp::DifferenceNorms& norms)
+{
+    if (!cfg.compareStencils.ValueOr(false)
+        || SolveStencil(cfg) != Cfg::StencilType::NinePoint)
+        return;
+
+    Cfg::GridConfigData fivePointCfg(cfg);
+    fivePointCfg.stencil = Cfg::StencilType::FivePoint;
+
+    Grid fivePoint(cfg.horizZip.ValueOr(false), cfg.verticZip.ValueOr(false));
+    if (!fivePoint.LoadFromImage(cfg.imagePath.c_str(), cfg.constraints, cfg.scaleFactor.ValueOr(1)))
+        return;
+
+    LOG("Solving with the 5-point stencil for comparison");
+    CachedDispatchSolver(fivePointCfg, &fivePoint);
+
+    Cmp::DifferenceNorms fivePointNorms;
+    if (Cmp::Difference(fivePoint, analytic, DifferenceType::Absolute, &fivePointNorms))
+    {
+        Cmp::ReportStencilGain(fivePointNorms, norms);
+    }
 }
 
 static
@@ -219,13 +471,13 @@ CompareProblem0(const bool pathsAreJson, const std::vector<std::string>& paths)
         return EXIT_FAILURE;
     }
 
-    JasUnpack((*cfg), imagePath, zeroTol, scaleFactor, pixelsPerMeter, maxIter);
+    JasUnpack((*cfg), imagePath, scaleFactor, pixelsPerMeter);
 
     Grid grid(cfg->horizZip.ValueOr(false), cfg->verticZip.ValueOr(false));
     if (!grid.LoadFromImage(imagePath.c_str(), cfg->constraints, scaleFactor.ValueOr(1)))
         return EXIT_FAILURE;
 
-    DispatchSolver(cfg->mode, &grid, zeroTol.ValueOr(0.001), maxIter.ValueOr(20000));
+    CachedDispatchSolver(*cfg, &grid);
 
     GradientGrid gradGrid;
     const f64 ppm = pixelsPerMeter.ValueOr(100.0);
@@ -239,13 +491,16 @@ CompareProblem0(const bool pathsAreJson, const std::vector<std::string>& paths)
                                              smallRad,
                                              scaleFactor.ValueOr(1) * ppm);
 
-    Jasnah::Option<Grid> diff = Cmp::Difference(grid, analytic.first, DifferenceType::Absolute);
+    Cmp::DifferenceNorms norms;
+    Jasnah::Option<Grid> diff = Cmp::Difference(grid, analytic.first, DifferenceType::Absolute, &norms);
 
     if (!diff)
     {
         return EXIT_FAILURE;
     }
 
+    ReportStencilGain(*cfg, analytic.first, norms);
+
     using namespace Plot;
 
     PlottableGrids grids;
@@ -291,13 +546,13 @@ CompareProblem1(const bool pathsAreJson, const std::vector<std::string>& paths)
         return EXIT_FAILURE;
     }
 
-    JasUnpack((*cfg), imagePath, zeroTol, scaleFactor, pixelsPerMeter, maxIter);
+    JasUnpack((*cfg), imagePath, scaleFactor, pixelsPerMeter);
 
     Grid grid(cfg->horizZip.ValueOr(false), cfg->verticZip.ValueOr(false));
     if (!grid.LoadFromImage(imagePath.c_str(), cfg->constraints, scaleFactor.ValueOr(1)))
         return EXIT_FAILURE;
 
-    DispatchSolver(cfg->mode, &grid, zeroTol.ValueOr(0.001), maxIter.ValueOr(20000));
+    CachedDispatchSolver(*cfg, &grid);
 
     GradientGrid gradGrid;
     const f64 ppm = pixelsPerMeter.ValueOr(100.0);
@@ -310,13 +565,16 @@ CompareProblem1(const bool pathsAreJson, const std::vector<std::string>& paths)
                                              bigRad,
                                              smallRad,
                                              scaleFactor.ValueOr(1) * ppm);
-    Jasnah::Option<Grid> diff = Cmp::Difference(grid, analytic.first);
+    Cmp::DifferenceNorms norms;
+    Jasnah::Option<Grid> diff = Cmp::Difference(grid, analytic.first, DifferenceType::Absolute, &norms);
 
     if (!diff)
     {
         return EXIT_FAILURE;
     }
 
+    ReportStencilGain(*cfg, analytic.first, norms);
+
     using namespace Plot;
 
     PlottableGrids grids;
@@ -370,7 +628,7 @@ CompareTwo(const bool pathsAreJson, const std::vector<std::string>& paths)
     if (!grid1.LoadFromImage(cfg1->imagePath.c_str(), cfg1->constraints, cfg1->scaleFactor.ValueOr(1)))
         return EXIT_FAILURE;
 
-    DispatchSolver(cfg1->mode, &grid1, cfg1->zeroTol.ValueOr(0.001), cfg1->maxIter.ValueOr(20000));
+    CachedDispatchSolver(*cfg1, &grid1);
 
     GradientGrid gradGrid1;
     const f64 ppm = cfg1->pixelsPerMeter.ValueOr(100.0);
@@ -381,7 +639,7 @@ CompareTwo(const bool pathsAreJson, const std::vector<std::string>& paths)
     if (!grid2.LoadFromImage(cfg2->imagePath.c_str(), cfg2->constraints, cfg2->scaleFactor.ValueOr(1)))
         return EXIT_FAILURE;
 
-    DispatchSolver(cfg2->mode, &grid2, cfg2->zeroTol.ValueOr(0.001), cfg2->maxIter.ValueOr(20000));
+    CachedDispatchSolver(*cfg2, &grid2);
 
     GradientGrid gradGrid2;
     const f64 ppm2 = cfg2->pixelsPerMeter.ValueOr(100.0);
@@ -411,9 +669,63 @@ CompareTwo(const bool pathsAreJson, const std::vector<std::string>& paths)
     return EXIT_SUCCESS;
 }
 
+/// Plots the solved grid and its field as for a single simulation,
+/// prefix is prepended to the names of the plot files
 static
 int
-SingleSimulation(const bool pathIsJson, const std::string& path)
+PlotSingleSimulation(const Grid& grid, const f64 pixelsPerMeter, const std::string& prefix)
+{
+    GradientGrid gradGrid;
+    gradGrid.CalculateNegGradient(grid, pixelsPerMeter);
+
+    using namespace Plot;
+    PlottableGrids grids;
+    grids.singleSimGrid = grid;
+    grids.singleSimVector = gradGrid;
+
+    if (!WritePlotFiles(grids, Cfg::OperationMode::SingleSimulation, prefix))
+    {
+        LOG("Unable to plot graphs");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/// The prefix for the output files of entry index of a batch of
+/// batchSize simulations, empty for a single simulation so the names
+/// are unchanged
+static
+std::string
+BatchPrefix(const uint index, const uint batchSize)
+{
+    if (batchSize <= 1)
+        return "";
+
+    return std::to_string(index + 1) + "_";
+}
+
+/// Prepends prefix to the file name of path, leaving the directory
+/// untouched
+static
+std::string
+PrefixFileName(const std::string& path, const std::string& prefix)
+{
+    const auto slash = path.find_last_of('/');
+    const auto nameStart = (slash == std::string::npos) ? 0 : slash + 1;
+    return path.substr(0, nameStart) + prefix + path.substr(nameStart);
+}
+
+/// Solves the problem of one config, starting from warmStartPath (or
+/// the config's WarmStart) and saving the solution to saveFieldPath
+/// (or the config's SaveField) if given. outputPrefix is prepended to
+/// the names of the plots, and of the field saved to saveFieldPath, so
+/// the configs of a batch don't overwrite each other's output
+static
+int
+SingleSimulation(const bool pathIsJson, const std::string& path,
+                 const std::string& warmStartPath, const std::string& saveFieldPath,
+                 const std::string& outputPrefix)
 {
     Jasnah::Option<Cfg::GridConfigData> cfg;
 
@@ -432,30 +744,108 @@ SingleSimulation(const bool pathIsJson, const std::string& path)
         return EXIT_FAILURE;
     }
 
-    JasUnpack((*cfg), imagePath, zeroTol, scaleFactor, pixelsPerMeter, maxIter);
+    JasUnpack((*cfg), imagePath, scaleFactor, pixelsPerMeter);
 
     Grid grid(cfg->horizZip.ValueOr(false), cfg->verticZip.ValueOr(false));
     if (!grid.LoadFromImage(imagePath.c_str(), cfg->constraints, scaleFactor.ValueOr(1)))
         return EXIT_FAILURE;
 
-    DispatchSolver(cfg->mode, &grid, zeroTol.ValueOr(0.001), maxIter.ValueOr(20000));
+    const std::string warmStart = warmStartPath.empty() ? cfg->warmStart.ValueOr("") : warmStartPath;
+    bool warmStarted = false;
+    if (!warmStart.empty())
+    {
+        warmStarted = FieldFile::WarmStart(warmStart.c_str(), &grid);
+        if (!warmStarted)
+            LOG("Unable to warm start, starting from 0");
+    }
+
+    // NOTE(Chris): A warm start should already be a better guess than
+    // nested iteration would give, so skip the coarse solves. The
+    // cache is keyed on the inputs alone, so a warm started solution
+    // is neither looked up nor stored
+    if (warmStarted)
+    {
+        if (cfg->nestedIteration.ValueOr(false))
+            LOG("Warm started, so skipping nested iteration");
+        if (cfg->cacheDirectory)
+            LOG("Warm started, so bypassing the solution cache");
+        SolveWithMode(*cfg, &grid);
+    }
+    else
+    {
+        CachedDispatchSolver(*cfg, &grid);
+    }
     //FDM::SolveGridLaplacianZero(&grid, zeroTol.ValueOr(0.001), maxIter.ValueOr(20000));
 
-    GradientGrid gradGrid;
-    gradGrid.CalculateNegGradient(grid, pixelsPerMeter.ValueOr(100.0));
+    // NOTE(Chris): The command line path is shared by every config of
+    // a batch, so needs the prefix, the config's own path doesn't
+    const std::string saveField = saveFieldPath.empty()
+        ? cfg->saveField.ValueOr("")
+        : PrefixFileName(saveFieldPath, outputPrefix);
+    if (!saveField.empty())
+        FieldFile::WriteField(grid, saveField.c_str());
 
-    using namespace Plot;
-    PlottableGrids grids;
-    grids.singleSimGrid = grid;
-    grids.singleSimVector = gradGrid;
+    return PlotSingleSimulation(grid, pixelsPerMeter.ValueOr(100.0), outputPrefix);
+}
 
-    if (!WritePlotFiles(grids, Cfg::OperationMode::SingleSimulation))
+static
+int
+SuperpositionBatch(const bool pathsAreJson, const std::vector<std::string>& paths)
+{
+    if (paths.empty())
     {
-        LOG("Unable to plot graphs");
+        LOG("Expected at least 1 path");
         return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    std::vector<Cfg::GridConfigData> cfgs;
+    for (const auto& path : paths)
+    {
+        Jasnah::Option<Cfg::GridConfigData> cfg;
+
+        if (pathsAreJson)
+        {
+            cfg = Cfg::LoadGridConfigString(path);
+        }
+        else
+        {
+            cfg = Cfg::LoadGridConfigFile(path.c_str());
+        }
+
+        if (!cfg)
+        {
+            LOG("Cannot understand config file, exiting");
+            return EXIT_FAILURE;
+        }
+        cfgs.push_back(*cfg);
+    }
+
+    // NOTE(Chris): The bases are solved with the first config's
+    // settings, every config is then just a weighted sum of them
+    Superposition::BasisSet bases;
+    if (!Superposition::BuildBases(cfgs.front(), DispatchSolver, &bases))
+        return EXIT_FAILURE;
+
+    int result = EXIT_SUCCESS;
+    const uint batchSize = cfgs.size();
+    for (uint i = 0; i < batchSize; ++i)
+    {
+        const auto& cfg = cfgs[i];
+        auto grid = Superposition::Evaluate(bases, cfg);
+        if (!grid)
+        {
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        if (PlotSingleSimulation(*grid, cfg.pixelsPerMeter.ValueOr(100.0),
+                                 BatchPrefix(i, batchSize)) != EXIT_SUCCESS)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    return result;
 }
 
 static
@@ -515,6 +905,11 @@ namespace Log
 #ifndef CATCH_CONFIG_MAIN
 int main(int argc, const char* argv[])
 {
+    // NOTE(Chris): The multi-process solver starts its workers as
+    // copies of this program, these skip everything else
+    if (argc > 1 && strcmp(argv[1], MultiProcess::WorkerFlag) == 0)
+        return MultiProcess::WorkerMain(argc, argv);
+
     TIME_FUNCTION();
     auto args = ParseArguments(argc, argv);
     if (args.guiMode)
@@ -548,7 +943,19 @@ int main(int argc, const char* argv[])
 
     case Cfg::OperationMode::SingleSimulation:
     {
-        result = SingleSimulation(args.jsonStdin, args.inputPaths.front());
+        // NOTE(Chris): Several configs can be given, these are run as
+        // a batch so that anything cached (e.g. factorisations) is
+        // shared between them. Each one's plots are prefixed with its
+        // position in the batch
+        const uint batchSize = args.inputPaths.size();
+        for (uint i = 0; i < batchSize; ++i)
+        {
+            if (SingleSimulation(args.jsonStdin, args.inputPaths[i], args.warmStart, args.saveField,
+                                 BatchPrefix(i, batchSize)) != EXIT_SUCCESS)
+            {
+                result = EXIT_FAILURE;
+            }
+        }
     } break;
 
     case Cfg::OperationMode::Preprocess:
@@ -556,6 +963,11 @@ int main(int argc, const char* argv[])
         result = Preprocess(args.inputPaths.front());
     } break;
 
+    case Cfg::OperationMode::Superposition:
+    {
+        result = SuperpositionBatch(args.jsonStdin, args.inputPaths);
+    } break;
+
     default:
         LOG("Unknown mode");
 